@@ -0,0 +1,20 @@
+#ifndef VERTEX_COMPRESSION
+#define VERTEX_COMPRESSION
+
+
+// positions are stored as 16 bit unorm relative to the bounds of their mesh
+vec3 decodePosition(vec3 quantized, vec3 boundsMin, vec3 boundsExtent)
+{
+    return boundsMin + quantized * boundsExtent;
+}
+
+// octahedral normal encoding, see "A Survey of Efficient Representations for Independent Unit Vectors"
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+#endif
@@ -1,15 +1,31 @@
 #version 420
+#extension GL_ARB_shading_language_include : require
 
+#include </data/shaders/common/vertex_compression.glsl>
+
+#define COMPACT_VERTICES
+
+#ifdef COMPACT_VERTICES
+layout(location = 0) in vec3 a_vertex;
+layout(location = 1) in vec2 a_normal;
+layout(location = 3) in vec3 a_boundsMin;
+layout(location = 4) in vec3 a_boundsExtent;
+#else
 layout(location = 0) in vec3 a_vertex;
 layout(location = 1) in vec3 a_normal;
+#endif
 
 out vec3 v_normal;
 
 void main()
 {
+#ifdef COMPACT_VERTICES
+    vec4 vertex = vec4(decodePosition(a_vertex, a_boundsMin, a_boundsExtent), 1.0);
+    v_normal = decodeOctahedral(a_normal);
+#else
     vec4 vertex = vec4(a_vertex, 1.0);
-
     v_normal = a_normal;
+#endif
 
     gl_Position = vertex;
 }
@@ -0,0 +1,45 @@
+#ifndef ISM_BIN_UTILS
+#define ISM_BIN_UTILS
+
+// the binned path of ism.comp sorts the splats of the points into square tiles of the atlas, see ism_bin.comp,
+// and resolves them in chunks of at most binChunkSize splats of one tile, see ism_bin_resolve.comp
+const int totalIsmPixelSize = 2048;
+const int binTileSize = 32;
+const int binTilesPerRow = totalIsmPixelSize / binTileSize;
+const int numBinTiles = binTilesPerRow * binTilesPerRow;
+const uint binChunkSize = 1024;
+
+// the work group size of ism_bin.comp, one point per invocation
+const uint binPointGroupSize = 1024;
+
+// the minimum of GL_MAX_COMPUTE_WORK_GROUP_COUNT, ism_bin_resolve.comp loops over the chunks beyond it
+const uint maxChunkGroups = 65535u;
+
+// the indirect point and resolve dispatches, the kept points, the splats before dropping those beyond the capacity
+// and the chunks they were split into. Matches BinCounters in ImperfectShadowmap.cpp
+layout (std430, binding = 7) restrict buffer binCounters_
+{
+    uint pointGroups[3];
+    uint chunkGroups[3];
+    uint numBinnedPoints;
+    uint numSplats;
+    uint numChunks;
+};
+
+// a splat is its atlas texel, x in the lower and y in the upper 16 bits, and the depth value for softrenderBuffer
+uvec2 packSplat(ivec2 texel, uint depthValue)
+{
+    return uvec2(uint(texel.x) | (uint(texel.y) << 16), depthValue);
+}
+
+ivec2 splatTexel(uvec2 splat)
+{
+    return ivec2(splat.x & 0xFFFFu, splat.x >> 16);
+}
+
+int binTile(ivec2 texel)
+{
+    return texel.y / binTileSize * binTilesPerRow + texel.x / binTileSize;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#version 430
+
+#extension GL_ARB_shading_language_include : require
+#include </data/shaders/common/random.glsl>
+#include </data/shaders/common/floatpacking.glsl>
+#include </data/shaders/ism/ism_utils.glsl>
+
+// one of the precomputed scene points (see PointCloud), position and packed normal.
+// Does for it what ism.geom does for a tessellated triangle.
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in uint a_packedNormal;
+
+flat out ivec2 g_centerCoord;
+out float g_normalRadius;
+
+const int totalVplCount = 1024;
+layout (std140, binding = 0) uniform packedVplBuffer_
+{
+    vec4 vplPositionNormalBuffer[totalVplCount];
+};
+
+layout (std430, binding = 0) buffer atomicBuffer_
+{
+	uint[1024] atomicCounter;
+};
+
+layout (r32ui, binding = 0) restrict uniform uimage2D softrenderBuffer;
+layout (rgba32f, binding = 1) restrict writeonly uniform imageBuffer pointBuffer;
+
+uniform ivec2 viewport;
+uniform float zFar;
+uniform float pointRadius;
+
+uniform bool usePushPull = true;
+
+uniform int vplStartIndex = 0;
+uniform int vplEndIndex = totalVplCount;
+uniform bool scaleISMs = false;
+uniform bool pointsOnlyIntoScaledISMs = false;
+// the round-robin update assigns points only to updateCount of the sampled VPLs, starting at updateOffset, zero means all
+uniform int updateOffset = 0;
+uniform int updateCount = 0;
+
+int vplCount = vplEndIndex - vplStartIndex;
+int sampledVplCount = updateCount > 0 ? updateCount : (pointsOnlyIntoScaledISMs ? vplCount : totalVplCount);
+int ismCount = (scaleISMs) ? vplCount : totalVplCount;
+int ismIndices1d = int(pow(2, ceil(log2(ismCount) / 2))); // next even power of two
+int vplIdOffset = (pointsOnlyIntoScaledISMs ? vplStartIndex : 0) + updateOffset;
+
+
+void main()
+{
+    vec3 position = a_position;
+    vec3 normal = unpackUnorm4x8(a_packedNormal).xyz * 2.0 - 1.0;
+
+    // outside of the clip volume unless the point is splatted below
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    gl_PointSize = 1.0;
+    g_centerCoord = ivec2(0);
+    g_normalRadius = 0.0;
+
+    int base = int(floatConstruct(hash(uint(gl_VertexID))) * sampledVplCount);
+
+    if (usePushPull) {
+        // each point represents ismCount other points, see ism.geom
+        float pointWorldRadius = pointRadius * sqrt(ismCount);
+        float normalRadius = pack4UNToFloat(vec4(normal * 0.5 + 0.5, pointWorldRadius / 25.0));
+
+        // the counter keeps counting past the end of the slice, so the dropped points can be reported
+        uint counter = atomicAdd(atomicCounter[base], 1);
+        int sliceSize = imageSize(pointBuffer).x / sampledVplCount;
+        if (counter < uint(sliceSize))
+            imageStore(pointBuffer, base * sliceSize + int(counter), vec4(position, normalRadius));
+        return;
+    }
+
+    int vplID = base + vplIdOffset;
+    vec4 vpl = vplPositionNormalBuffer[vplID];
+    vec3 vplPosition = vpl.xyz;
+    vec3 vplNormal = unpack3SNFromFloat(vpl.w);
+
+    vec3 positionRelativeToCamera = position - vplPosition;
+    if (dot(vplNormal, positionRelativeToCamera) < 0 || dot(normal, -positionRelativeToCamera) < 0)
+        return;
+
+    // paraboloid projection
+    float distToCamera = length(positionRelativeToCamera);
+    vec4 ismRect = ismRects[vplID];
+    if (ismRect.z <= 0.0)
+        return;
+    vec3 v = paraboloid_project(positionRelativeToCamera, distToCamera, vplNormal, zFar, ismRect, true);
+
+    // sized as if the ISM's tile were one of ismIndices1d per axis, see ism.geom
+    float pointSize = (pointRadius * 2.0) / distToCamera / 3.14 * ismRect.w * ismIndices1d; // approximation that breaks especially for near points.
+    float maximumPointSize = 15.0;
+    pointSize = min(pointSize, maximumPointSize);
+
+    g_centerCoord = ivec2(v.xy * viewport);
+
+    // to tex and NDC coords
+    v.xy = v.xy * 2.0 - 1.0;
+    v.z = v.z * 2.0 - 1.0;
+
+    gl_Position = vec4(v, 1.0);
+    gl_PointSize = pointSize;
+}
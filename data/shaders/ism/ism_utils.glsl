@@ -12,7 +12,14 @@ mat3 lookAtRH(vec3 normalizedNormal)
     return transpose(mat3(s, u, -f));
 }
 
-vec3 paraboloid_project(vec3 positionRelativeToCamera, float distToCamera, vec3 vplNormal, float zFar, float ismIndex, int ismIndices1d, bool preserveSign)
+// the ISM of each VPL as origin and size in atlas texture coordinates and size in pixels, see atlas_allocation.comp.
+// VPLs without an ISM have size zero
+layout (std430, binding = 4) restrict readonly buffer ismRects_
+{
+    vec4 ismRects[];
+};
+
+vec3 paraboloid_project(vec3 positionRelativeToCamera, float distToCamera, vec3 vplNormal, float zFar, vec4 ismRect, bool preserveSign)
 {
     mat3 vplView = lookAtRH(vplNormal);
 
@@ -31,11 +38,8 @@ vec3 paraboloid_project(vec3 positionRelativeToCamera, float distToCamera, vec3
     v.xy += 1.0;
     v.xy /= 2.0;
 
-    // offset to respective ISM
-    float y = int(ismIndex / ismIndices1d);
-    ivec2 ismIndex2d = ivec2(int(ismIndex - y * ismIndices1d) , y);
-    v.xy += vec2(ismIndex2d);
-    v.xy /= ismIndices1d;
+    // into the respective ISM
+    v.xy = ismRect.xy + v.xy * ismRect.z;
     return v;
 }
 
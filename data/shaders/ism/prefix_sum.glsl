@@ -0,0 +1,32 @@
+#ifndef PREFIX_SUM
+#define PREFIX_SUM
+
+// exclusive prefix sum over one value per invocation of a work group of prefixSumSize invocations
+const uint prefixSumSize = 1024;
+
+shared uint prefixSums[prefixSumSize];
+
+// returns the sum of the values of the invocations before this one and the sum of all of them in total
+uint exclusivePrefixSum(uint value, out uint total)
+{
+    uint i = gl_LocalInvocationIndex;
+
+    // an earlier call may still be read
+    barrier();
+    prefixSums[i] = value;
+    memoryBarrierShared();
+    barrier();
+
+    for (uint offset = 1; offset < prefixSumSize; offset <<= 1) {
+        uint before = i >= offset ? prefixSums[i - offset] : 0u;
+        barrier();
+        prefixSums[i] += before;
+        memoryBarrierShared();
+        barrier();
+    }
+
+    total = prefixSums[prefixSumSize - 1];
+    return prefixSums[i] - value;
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef PULLPUSH_UTILS
+#define PULLPUSH_UTILS
+
+// shared by pull.comp, push.comp and their fused variants. A pyramid pixel is depth, max depth,
+// radius in pixels of level zero and the displacement to the pulled point, packed into two halfs.
+// Nothing ever crosses the borders of the 64 pixel ISM cells, or of smaller ISM tiles, so each cell can be processed on its own.
+
+const float pullInfinity = 1. / 0.;
+
+// Levels 1 to 6 of the pyramid are stored in two uints per pixel, depth and radius in one,
+// max depth and displacement in the other, see packPyramidPixel. Without COMPACT_PYRAMID defined
+// before the include they are kept as four floats, which is only used to check the compact result
+#ifdef COMPACT_PYRAMID
+    #define PYRAMID_FORMAT rg32ui
+    #define pyramidImage uimage2D
+    #define loadPyramidPixel(image, pixelCoordinate) unpackPyramidPixel(imageLoad(image, pixelCoordinate).xy)
+    #define storePyramidPixel(image, pixelCoordinate, pixel) imageStore(image, pixelCoordinate, uvec4(packPyramidPixel(pixel), 0u, 0u))
+#else
+    #define PYRAMID_FORMAT rgba32f
+    #define pyramidImage image2D
+    #define loadPyramidPixel(image, pixelCoordinate) imageLoad(image, pixelCoordinate)
+    #define storePyramidPixel(image, pixelCoordinate, pixel) imageStore(image, pixelCoordinate, pixel)
+#endif
+
+const float pyramidDepthScale = float(0xFFFFFF); // keeps 1.0, the empty pixel, exact
+const float pyramidRadiusScale = 16.0;
+const float pyramidDisplacementScale = 8.0;
+
+// depth as 24 bit unorm and radius in 1/16 pixels up to the clamped 15 pixels in the first uint.
+// Max depth as half relative to depth and the displacement in 1/8 pixels up to +-16 pixels in the second,
+// pulling and pushing never keep larger displacements than the radius.
+uvec2 packPyramidPixel(vec4 pixel)
+{
+    uint depth = uint(round(clamp(pixel.r, 0.0, 1.0) * pyramidDepthScale));
+    uint radius = uint(clamp(round(pixel.b * pyramidRadiusScale), 0.0, 255.0));
+    uint maxDepthOffset = packHalf2x16(vec2(max(pixel.g - pixel.r, 0.0), 0.0)) & 0xFFFFu;
+    ivec2 displacement = clamp(ivec2(round(unpack2FloatsFromFloat(pixel.a) * pyramidDisplacementScale)), -128, 127);
+    return uvec2(depth << 8 | radius, maxDepthOffset | uint(displacement.x & 0xFF) << 16 | uint(displacement.y & 0xFF) << 24);
+}
+
+vec4 unpackPyramidPixel(uvec2 packedPixel)
+{
+    float depth = float(packedPixel.x >> 8) / pyramidDepthScale;
+    float radius = float(packedPixel.x & 0xFFu) / pyramidRadiusScale;
+    float maxDepth = depth + unpackHalf2x16(packedPixel.y & 0xFFFFu).x;
+    ivec2 displacement = ivec2(bitfieldExtract(int(packedPixel.y), 16, 8), bitfieldExtract(int(packedPixel.y), 24, 8));
+    return vec4(depth, maxDepth, radius, pack2FloatsToFloat(vec2(displacement) / pyramidDisplacementScale));
+}
+
+// the log2 of the size of the ISM tile per 32 pixel cell of the atlas, see atlas_allocation.comp
+layout (binding = 1) uniform usampler2D ismTileLevels;
+
+const int tileLevelCellLog2 = 5;
+
+int tileLevel(ivec2 levelZeroPixel)
+{
+    ivec2 cell = clamp(levelZeroPixel >> tileLevelCellLog2, ivec2(0), textureSize(ismTileLevels, 0) - 1);
+    return int(texelFetch(ismTileLevels, cell, 0).r);
+}
+
+// the level zero pixel of a softrenderBuffer texel
+vec4 pullLevelZeroInput(uint depthRadiusSample, ivec2 pixelCoordinate, float zFar)
+{
+    float depthSample = float(depthRadiusSample >> 8) / (1 << 24);
+    float radius = float(depthRadiusSample & 0xFFu) / 10;
+
+    // the projection is performed here, not in ism.comp,
+    // as the *world* radius, not projected radius, is needed for the maxDepth calculation here.
+
+    float magicFactor = 0.6; // hand-tuned to make things look better
+    // radius * 2 since the next point on the same surface is 2r away.
+    float maxDepth = depthSample + (radius * 2) / zFar * magicFactor;
+
+    // radius is in world units so far, project & convert to pixels
+    float distToCamera = depthSample * zFar;
+    int ismPixelSize = 1 << tileLevel(pixelCoordinate);
+    radius = radius / distToCamera / 3.14 * ismPixelSize; // approximation that breaks especially for near points.
+    // boost radius a bit to make circle area match the point rendering square area
+    radius *= 1.3;
+    // clamp to avoid overly large points ruining everything
+    radius = min(radius, 15);
+
+    return vec4(depthSample, maxDepth, radius, pack2FloatsToFloat(vec2(0.0)));
+}
+
+// outputPixelCoord of level pulled from the four pixels of the finer level at outputPixelCoord * 2 + pullOffsets[i]
+const ivec2[4] pullOffsets = { {0,0}, {0,1}, {1,0}, {1,1} };
+
+vec4 pullPixel(vec4[4] inputs, ivec2 outputPixelCoord, int level)
+{
+    float[4] depthSamples;
+    float[4] maxDepths;
+    float[4] radiuses;
+    vec2[4] displacementVectors;
+    bool[4] valid;
+
+    for (int i = 0; i < 4; i++) {
+        ivec2 inputPixelCoord = outputPixelCoord * 2 + pullOffsets[i];
+        float depthSample = inputs[i].r;
+        float maxDepth = inputs[i].g;
+        float radius = inputs[i].b;
+        vec2 displacementVector = unpack2FloatsFromFloat(inputs[i].a);
+
+        // radius check
+        vec2 newDisplacementVector = (inputPixelCoord + 0.5 + displacementVector) / 2 - (outputPixelCoord + 0.5);
+        float dist = length(newDisplacementVector);
+
+        float scaledRadius = radius * pow(2, -level);
+
+        bool radiusCheckPassed = dist <= scaledRadius;
+
+        depthSamples[i] = depthSample;
+        maxDepths[i] = maxDepth;
+        radiuses[i] = radius;
+        displacementVectors[i] = newDisplacementVector; // TODO blocky results, but are round when displacment vector set to 0
+        valid[i] = depthSample != 1.0;
+        valid[i] = valid[i] && radiusCheckPassed; // TODO unknown whether this helps
+    }
+
+    float minimum = pullInfinity;
+    float maxDepth;
+    for (int i = 0; i < 4; i++) {
+        if (!valid[i])
+            continue;
+        minimum = min(depthSamples[i], minimum);
+        if (minimum == depthSamples[i])
+            maxDepth = maxDepths[i];
+    }
+
+    for(int i = 0; i < 4; i++) {
+        if (depthSamples[i] > maxDepth)
+            valid[i] = false;
+    }
+
+    float depthAcc = 0.0;
+    float radiusAcc = 0.0;
+    vec2 displacementAcc = vec2(0.0);
+    uint numValid = 0;
+    float maxValidMaxDepth = 0.0;
+    for (int i = 0; i < 4; i++) {
+        if (!valid[i])
+            continue;
+
+        depthAcc += depthSamples[i];
+        displacementAcc += displacementVectors[i];
+        radiusAcc += radiuses[i];
+        maxValidMaxDepth = max(maxValidMaxDepth, maxDepths[i]);
+        numValid++;
+    }
+
+    vec4 result;
+    if (numValid > 0) {
+        result.r = depthAcc / numValid;
+        result.g = maxValidMaxDepth;
+        result.b = radiusAcc / numValid;
+        result.a = pack2FloatsToFloat(displacementAcc / numValid);
+    } else {
+        result = vec4(1.0, 0.0, 0.0, 0.0);
+    }
+    return result;
+}
+
+// the four pixels of the coarser level around a pixel start at coarserLowerLeftPixel and follow pushOffsets.
+// A pixel is the outputPixel-th of the four sharing them, at coarserLowerLeftPixel * 2 + 1 + pushOffsets[outputPixel]
+const ivec2[4] pushOffsets = { {0,0}, {0,1}, {1,1}, {1,0} };
+
+ivec2 pushCoarserLowerLeftPixel(ivec2 pixelCoordinate)
+{
+    return (pixelCoordinate + 1) / 2 - 1;
+}
+
+int pushOutputPixel(ivec2 pixelCoordinate)
+{
+    ivec2 offset = pixelCoordinate + 1 - ((pixelCoordinate + 1) / 2) * 2;
+    return offset.x == 0 ? offset.y : 3 - offset.y;
+}
+
+// pixelCoordinate of level, filled from the coarser level where origSample is empty or occluded
+vec4 pushPixel(vec4[4] coarser, ivec2 coarserLowerLeftPixel, ivec2 pixelCoordinate, int outputPixel, vec4 origSample, int level)
+{
+    float[4] depths;
+    float[4] maxDepths;
+    float[4] radiuses;
+    vec2[4] displacementVectorsCoarse;
+    for (int i = 0 ; i < 4; i++) {
+        depths[i] = coarser[i].r;
+        maxDepths[i] = coarser[i].g;
+        radiuses[i] = coarser[i].b;
+        displacementVectorsCoarse[i] = unpack2FloatsFromFloat(coarser[i].a);
+    }
+
+    // compute weights
+    int[4] weightsX = { 9, 3, 1, 3};
+    int[4] weights;
+    for(int i = 0; i < 4; i++) {
+        weights[i] = weightsX[(i - outputPixel + 4) % 4];
+    }
+
+    // don't go over ISM borders
+    // the pyramid is split into cells of 64px, or of the ISM tile if it is smaller
+    int cellLog2 = min(tileLevel(pixelCoordinate << level), 6);
+    ivec2 origTexCoord = pixelCoordinate / 2;
+    for (int i = 0 ; i < 4; i++) {
+        ivec2 inputPixelCoords = coarserLowerLeftPixel + pushOffsets[i];
+        // we ignore cellLog2 bits of texture coordinates when reading from lowest level
+        // we do read from level+1, whose pixels cover more than a cell beyond cellLog2
+        if (level + 1 > cellLog2 || origTexCoord >> (cellLog2-(level+1)) != inputPixelCoords >> (cellLog2-(level+1))) {
+            weights[i] = 0;
+        }
+    }
+
+    // ignore pixels with invalid depth
+    for (int i = 0 ; i < 4; i++) {
+        bool invalid = depths[i] == 1.0;
+        if (invalid)
+            weights[i] = 0;
+    }
+
+    // radius check
+    vec2[4] displacementVectors;
+    for (int i = 0; i < 4; i++) {
+        vec2 coarserTexCoord = (coarserLowerLeftPixel + pushOffsets[i] + 0.5) * 2;
+        vec2 thisTexCoord = pixelCoordinate + 0.5;
+
+        displacementVectors[i] = coarserTexCoord - thisTexCoord + displacementVectorsCoarse[i]*2;
+
+        float dist = length(displacementVectors[i]);
+
+        float radius = radiuses[i];
+        radius *= pow(2, -level); // scale with miplevel
+
+        if (dist > radius)
+            weights[i] = 0;
+    }
+
+    // depth range check
+    float minimum = 9001;
+    float maxDepth;
+    for (int i = 0; i < 4; i++) {
+        if (weights[i] == 0)
+            continue;
+        minimum = min(depths[i], minimum);
+        if (minimum == depths[i])
+            maxDepth = maxDepths[i];
+    }
+
+    for(int i = 0; i < 4; i++) {
+        if (depths[i] > maxDepth)
+            weights[i] = 0;
+    }
+
+
+    float depthAcc = 0.0;
+    float radiusAcc = 0.0;
+    vec2 displacementAcc = vec2(0.0);
+    int weightAcc = 0;
+    float maxDepthAcc = 0.0;
+
+    for (int i = 0; i < 4; i++) {
+        depthAcc += depths[i] * weights[i];
+        maxDepthAcc += maxDepths[i] * weights[i];
+        radiusAcc += radiuses[i] * weights[i];
+        displacementAcc += displacementVectors[i] * weights[i];
+        weightAcc += weights[i];
+    }
+
+    vec4 result = vec4(0.0);
+    result.r = depthAcc / weightAcc;
+    result.g = maxDepthAcc / weightAcc;
+    result.b = radiusAcc / weightAcc;
+    result.a = pack2FloatsToFloat(displacementAcc / weightAcc);
+
+
+    bool invalid = origSample.r == 1.0;
+
+    bool occluded = false;
+    for (int i = 0; i < 4; i++) {
+        occluded = occluded || (weights[i] > 0 && origSample.r > maxDepths[i]);
+    }
+
+    bool allSamplesInvalid = weightAcc <= 0;
+    if (allSamplesInvalid || !invalid && !occluded) {
+        result = origSample;
+    }
+
+    return result;
+}
+
+#endif
@@ -1,6 +1,12 @@
-#version 330
+#version 430
 #extension GL_ARB_shading_language_include : require
 
+#define BINDLESS_TEXTURES
+
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
+
 #include </data/shaders/common/shadowmapping.glsl>
 #include </data/shaders/common/random.glsl>
 
@@ -10,6 +16,7 @@ in vec3 v_normal;
 in vec3 v_worldCoord;
 in vec3 v_uv;
 in vec4 v_s;
+flat in uint v_materialIndex;
 
 layout(location = 0) out vec3 outDiffuse;
 layout(location = 1) out vec3 outSpecular;
@@ -23,18 +30,50 @@ layout(location = 4) out vec2 outVSM;
 uniform sampler2D shadowmap;
 uniform sampler2D masksTexture;
 
-uniform sampler2D diffuseTexture;
-uniform bool useDiffuseTexture;
-uniform sampler2D specularTexture;
-uniform bool useSpecularTexture;
-uniform sampler2D emissiveTexture;
-uniform bool useEmissiveTexture;
-uniform sampler2D opacityTexture;
-uniform bool useOpacityTexture;
-uniform sampler2D bumpTexture;
 uniform int bumpType;
 
-uniform float shininess;
+// indices into MaterialEntry.textures, in TextureType order
+#define DIFFUSE 0
+#define SPECULAR 1
+#define EMISSIVE 2
+#define BUMP 3
+#define OPACITY 4
+
+#define TEXTURE_DIFFUSE 1u
+#define TEXTURE_SPECULAR 2u
+#define TEXTURE_EMISSIVE 4u
+#define TEXTURE_BUMP 8u
+#define TEXTURE_OPACITY 16u
+
+// matches MaterialEntry in MaterialTable.cpp, textures are bindless handles or array layers in x
+struct MaterialEntry
+{
+    uvec2 textures[5];
+    float shininess;
+    uint textureFlags;
+};
+
+layout(std430, binding = 0) readonly buffer MaterialTable
+{
+    MaterialEntry materials[];
+};
+
+// MATERIAL_TEXTURE and MATERIAL_UV are passed to the texture functions together
+#ifdef BINDLESS_TEXTURES
+    #define MATERIAL_TEXTURE(type, arraySampler) sampler2D(materials[v_materialIndex].textures[type])
+    #define MATERIAL_UV(type, uv) (uv)
+#else
+    // the arrays of the current draw group, all materials of a group share them
+    uniform sampler2DArray diffuseTexture;
+    uniform sampler2DArray specularTexture;
+    uniform sampler2DArray emissiveTexture;
+    uniform sampler2DArray opacityTexture;
+    uniform sampler2DArray bumpTexture;
+
+    #define MATERIAL_TEXTURE(type, arraySampler) arraySampler
+    #define MATERIAL_UV(type, uv) vec3(uv, float(materials[v_materialIndex].textures[type].x))
+#endif
+
 uniform float masksOffset;
 uniform vec3 cameraEye;
 
@@ -66,16 +105,22 @@ void main()
 {
     vec2 uv = v_uv.xy;
 
+    uint textureFlags = materials[v_materialIndex].textureFlags;
+    bool useDiffuseTexture = (textureFlags & TEXTURE_DIFFUSE) != 0u;
+    bool useSpecularTexture = (textureFlags & TEXTURE_SPECULAR) != 0u;
+    bool useOpacityTexture = (textureFlags & TEXTURE_OPACITY) != 0u;
+    int materialBumpType = (textureFlags & TEXTURE_BUMP) != 0u ? bumpType : BUMP_NONE;
+
     if (useOpacityTexture)
     {
-        float curAlpha = texture(opacityTexture, uv).r;
+        float curAlpha = texture(MATERIAL_TEXTURE(OPACITY, opacityTexture), MATERIAL_UV(OPACITY, uv)).r;
         if (curAlpha < 0.5)
             discard;
     }
 
     if (useDiffuseTexture)
     {
-        vec4 diffuseRead = texture(diffuseTexture, uv).rgba;
+        vec4 diffuseRead = texture(MATERIAL_TEXTURE(DIFFUSE, diffuseTexture), MATERIAL_UV(DIFFUSE, uv)).rgba;
         if (diffuseRead.a < 0.5)
             discard;
 
@@ -84,7 +129,7 @@ void main()
         // passing the average color as uniform would be better
         // but does not speed this up, not bottlenecked by tex lookups
         #ifdef RENDER_RSM
-        diffuseRead = textureLod(diffuseTexture, uv, 32).rgba;
+        diffuseRead = textureLod(MATERIAL_TEXTURE(DIFFUSE, diffuseTexture), MATERIAL_UV(DIFFUSE, uv), 32).rgba;
         #endif
         outDiffuse = diffuseRead.rgb;
     }
@@ -93,23 +138,26 @@ void main()
     outFaceNormal = N * 0.5 + 0.5;
 
     #ifndef RENDER_RSM
-        if (bumpType != BUMP_NONE)
+        if (materialBumpType != BUMP_NONE)
         {
             mat3 tbn = cotangent_frame(N, v_worldCoord, uv);
-            if (bumpType == BUMP_HEIGHT)
+            if (materialBumpType == BUMP_HEIGHT)
             {
-                float A = textureOffset(bumpTexture, uv, ivec2( 1, 0)).x;
-                float B = textureOffset(bumpTexture, uv, ivec2(-1, 0)).x;
-                float C = textureOffset(bumpTexture, uv, ivec2( 0, 1)).x;
-                float D = textureOffset(bumpTexture, uv, ivec2( 0,-1)).x;
+                float A = textureOffset(MATERIAL_TEXTURE(BUMP, bumpTexture), MATERIAL_UV(BUMP, uv), ivec2( 1, 0)).x;
+                float B = textureOffset(MATERIAL_TEXTURE(BUMP, bumpTexture), MATERIAL_UV(BUMP, uv), ivec2(-1, 0)).x;
+                float C = textureOffset(MATERIAL_TEXTURE(BUMP, bumpTexture), MATERIAL_UV(BUMP, uv), ivec2( 0, 1)).x;
+                float D = textureOffset(MATERIAL_TEXTURE(BUMP, bumpTexture), MATERIAL_UV(BUMP, uv), ivec2( 0,-1)).x;
 
                 vec3 normalBump = vec3(B-A, D-C, 0.1);
                 normalBump = tbn * normalBump;
                 N = normalize(normalBump);
             }
-            else if (bumpType == BUMP_NORMAL)
+            else if (materialBumpType == BUMP_NORMAL)
             {
-                vec3 normalSample = texture(bumpTexture, uv).rgb * 2.0 - 1.0;
+                // z is reconstructed, block compressed normal maps only store x and y
+                vec3 normalSample;
+                normalSample.xy = texture(MATERIAL_TEXTURE(BUMP, bumpTexture), MATERIAL_UV(BUMP, uv)).rg * 2.0 - 1.0;
+                normalSample.z = sqrt(max(0.0, 1.0 - dot(normalSample.xy, normalSample.xy)));
                 N = normalize(tbn * normalSample);
             }
         }
@@ -119,7 +167,7 @@ void main()
 
     if (useSpecularTexture)
     {
-        outSpecular = texture(specularTexture, uv).rgb;
+        outSpecular = texture(MATERIAL_TEXTURE(SPECULAR, specularTexture), MATERIAL_UV(SPECULAR, uv)).rgb;
     }
 
     #ifdef RENDER_RSM
@@ -1,14 +1,28 @@
 #version 330
 #extension GL_ARB_shading_language_include : require
 
+#include </data/shaders/common/vertex_compression.glsl>
+
+#define COMPACT_VERTICES
+
+#ifdef COMPACT_VERTICES
+layout(location = 0) in vec3 a_vertex;
+layout(location = 1) in vec2 a_normal;
+layout(location = 2) in vec2 a_uv;
+layout(location = 3) in vec3 a_boundsMin;
+layout(location = 4) in vec3 a_boundsExtent;
+#else
 layout(location = 0) in vec3 a_vertex;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec3 a_uv;
+#endif
+layout(location = 5) in uint a_materialIndex;
 
 out vec3 v_normal;
 out vec3 v_worldCoord;
 out vec3 v_uv;
 out vec4 v_s;
+flat out uint v_materialIndex;
 
 uniform mat4 modelView;
 uniform mat4 projection;
@@ -21,11 +35,21 @@ uniform mat4 biasedShadowTransform;
 
 void main()
 {
-    vec4 vertex = vec4(a_vertex, 1.0);
-
-    v_worldCoord = a_vertex;
+#ifdef COMPACT_VERTICES
+    vec3 position = decodePosition(a_vertex, a_boundsMin, a_boundsExtent);
+    v_normal = decodeOctahedral(a_normal);
+    v_uv = vec3(a_uv, 0.0);
+#else
+    vec3 position = a_vertex;
     v_normal = a_normal;
     v_uv = a_uv;
+#endif
+
+    v_materialIndex = a_materialIndex;
+
+    vec4 vertex = vec4(position, 1.0);
+
+    v_worldCoord = position;
     gl_Position = projection * modelView * vertex;
 
     vec4 v_s_tmp = biasedShadowTransform * vertex;
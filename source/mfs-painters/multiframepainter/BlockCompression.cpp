@@ -0,0 +1,300 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "RawImage.h"
+
+namespace
+{
+    // a 4x4 block of rgba texels, row by row
+    using Block = unsigned char[16][4];
+
+    void fetchBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, Block& block)
+    {
+        // blocks reaching over the image border repeat the last row/column
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                auto px = std::min(blockX * 4 + x, width - 1);
+                auto py = std::min(blockY * 4 + y, height - 1);
+                std::memcpy(block[y * 4 + x], pixels + (static_cast<size_t>(py) * width + px) * 4, 4);
+            }
+        }
+    }
+
+    uint16_t packRGB565(const float color[3])
+    {
+        auto r = static_cast<uint16_t>(std::round(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f));
+        auto g = static_cast<uint16_t>(std::round(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f));
+        auto b = static_cast<uint16_t>(std::round(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRGB565(uint16_t packed, int color[3])
+    {
+        auto r = (packed >> 11) & 31;
+        auto g = (packed >> 5) & 63;
+        auto b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // endpoints along the principal axis of the block colors, indices by nearest palette entry (4 color mode)
+    void encodeColorBlock(const Block& block, unsigned char* output)
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                mean[c] += block[i][c] / 16.0f;
+
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+        {
+            float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+            covariance[0] += d[0] * d[0];
+            covariance[1] += d[0] * d[1];
+            covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1];
+            covariance[4] += d[1] * d[2];
+            covariance[5] += d[2] * d[2];
+        }
+
+        // power iteration for the dominant eigenvector
+        float axis[3] = { 0.9f, 1.0f, 0.7f };
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+            };
+            auto length = std::max(std::max(std::abs(next[0]), std::abs(next[1])), std::abs(next[2]));
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; ++c)
+                axis[c] = next[c] / length;
+        }
+
+        float minProjection = 0.0f;
+        float maxProjection = 0.0f;
+        int minIndex = 0;
+        int maxIndex = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            auto projection = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+            if (i == 0 || projection < minProjection) { minProjection = projection; minIndex = i; }
+            if (i == 0 || projection > maxProjection) { maxProjection = projection; maxIndex = i; }
+        }
+
+        float maxColor[3] = { float(block[maxIndex][0]), float(block[maxIndex][1]), float(block[maxIndex][2]) };
+        float minColor[3] = { float(block[minIndex][0]), float(block[minIndex][1]), float(block[minIndex][2]) };
+
+        auto color0 = packRGB565(maxColor);
+        auto color1 = packRGB565(minColor);
+        uint32_t indices = 0;
+
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestDistance = 0;
+                for (int p = 0; p < 4; ++p)
+                {
+                    int distance = 0;
+                    for (int c = 0; c < 3; ++c)
+                        distance += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                    if (p == 0 || distance < bestDistance)
+                    {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (2 * i);
+            }
+        }
+
+        output[0] = color0 & 0xFF;
+        output[1] = color0 >> 8;
+        output[2] = color1 & 0xFF;
+        output[3] = color1 >> 8;
+        for (int i = 0; i < 4; ++i)
+            output[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // single channel block with min/max endpoints in the 8 value mode
+    void encodeChannelBlock(const Block& block, int channel, unsigned char* output)
+    {
+        int minValue = 255;
+        int maxValue = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            minValue = std::min(minValue, int(block[i][channel]));
+            maxValue = std::max(maxValue, int(block[i][channel]));
+        }
+
+        output[0] = static_cast<unsigned char>(maxValue);
+        output[1] = static_cast<unsigned char>(minValue);
+
+        uint64_t indices = 0;
+        if (maxValue != minValue)
+        {
+            // palette entry i (1..6) lies at ((7 - i) * max + i * min) / 7 and has code i + 1
+            for (int i = 0; i < 16; ++i)
+            {
+                auto t = float(maxValue - block[i][channel]) / float(maxValue - minValue);
+                auto step = static_cast<int>(std::round(t * 7.0f));
+                int code = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+                indices |= static_cast<uint64_t>(code) << (3 * i);
+            }
+        }
+
+        for (int i = 0; i < 6; ++i)
+            output[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    void encodeBlock(const Block& block, BlockFormat format, unsigned char* output)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1:
+            encodeColorBlock(block, output);
+            break;
+        case BlockFormat::BC3:
+            encodeChannelBlock(block, 3, output);
+            encodeColorBlock(block, output + 8);
+            break;
+        case BlockFormat::BC4:
+            encodeChannelBlock(block, 0, output);
+            break;
+        case BlockFormat::BC5:
+            encodeChannelBlock(block, 0, output);
+            encodeChannelBlock(block, 1, output + 8);
+            break;
+        default:
+            assert(false && "unknown block format");
+            break;
+        }
+    }
+
+    std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, int width, int height, int newWidth, int newHeight)
+    {
+        std::vector<unsigned char> result(static_cast<size_t>(newWidth) * newHeight * 4);
+        for (int y = 0; y < newHeight; ++y)
+        {
+            for (int x = 0; x < newWidth; ++x)
+            {
+                auto x0 = std::min(2 * x, width - 1);
+                auto x1 = std::min(2 * x + 1, width - 1);
+                auto y0 = std::min(2 * y, height - 1);
+                auto y1 = std::min(2 * y + 1, height - 1);
+                for (int c = 0; c < 4; ++c)
+                {
+                    auto sum = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c]
+                        + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                        + pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c]
+                        + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                    result[(static_cast<size_t>(y) * newWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        return result;
+    }
+}
+
+namespace BlockCompression
+{
+
+size_t blockSize(BlockFormat format)
+{
+    return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+}
+
+CompressedImage compress(const RawImage& image, BlockFormat format)
+{
+    CompressedImage result;
+    result.format = format;
+    result.grayscale = false;
+
+    auto pixels = image.data;
+    auto width = image.width;
+    auto height = image.height;
+
+    while (true)
+    {
+        auto blocksX = (width + 3) / 4;
+        auto blocksY = (height + 3) / 4;
+
+        CompressedImage::Level level;
+        level.width = width;
+        level.height = height;
+        level.offset = result.data.size();
+        level.size = static_cast<size_t>(blocksX) * blocksY * blockSize(format);
+        result.levels.push_back(level);
+        result.data.resize(level.offset + level.size);
+
+        auto output = result.data.data() + level.offset;
+        Block block;
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                fetchBlock(pixels.data(), width, height, bx, by, block);
+                encodeBlock(block, format, output);
+                output += blockSize(format);
+            }
+        }
+
+        if (width == 1 && height == 1)
+            break;
+
+        auto newWidth = std::max(1, width / 2);
+        auto newHeight = std::max(1, height / 2);
+        pixels = downsample(pixels, width, height, newWidth, newHeight);
+        width = newWidth;
+        height = newHeight;
+    }
+
+    return result;
+}
+
+bool hasAlpha(const RawImage& image)
+{
+    for (size_t i = 3; i < image.data.size(); i += 4)
+    {
+        if (image.data[i] != 255)
+            return true;
+    }
+    return false;
+}
+
+bool isGrayscale(const RawImage& image)
+{
+    const int tolerance = 2;
+    for (size_t i = 0; i + 2 < image.data.size(); i += 4)
+    {
+        if (std::abs(image.data[i] - image.data[i + 1]) > tolerance || std::abs(image.data[i] - image.data[i + 2]) > tolerance)
+            return false;
+    }
+    return true;
+}
+
+}
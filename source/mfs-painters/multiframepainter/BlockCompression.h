@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RawImage;
+
+
+enum class BlockFormat : uint32_t
+{
+    BC1, // rgb, 4 bits per texel
+    BC3, // rgba, 8 bits per texel
+    BC4, // r, 4 bits per texel
+    BC5  // rg, 8 bits per texel
+};
+
+// block compressed image with its full mip chain, levels are stored consecutively in data
+struct CompressedImage
+{
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    BlockFormat format;
+    bool grayscale; // BC4 holding an rgb image with equal channels, sample with a red swizzle
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+};
+
+namespace BlockCompression
+{
+    size_t blockSize(BlockFormat format);
+
+    // encodes the image and a box filtered mip chain down to 1x1
+    // BC1/BC3 use rgb(a), BC4 the red channel, BC5 red and green
+    CompressedImage compress(const RawImage& image, BlockFormat format);
+
+    bool hasAlpha(const RawImage& image);
+    bool isGrayscale(const RawImage& image);
+}
@@ -17,6 +17,7 @@
 
 #include <gloperate/primitives/ScreenAlignedQuad.h>
 
+#include "MemoryRegistry.h"
 #include "VPLProcessor.h"
 #include "PerfCounter.h"
 
@@ -60,11 +61,19 @@ ClusteredShading::ClusteredShading()
 
     clusterCorners = globjects::Texture::createDefault(GL_TEXTURE_2D);
     clusterCorners->setName("clusterCorners");
+
+    vplReferences = new globjects::Buffer();
+    vplReferences->setName("VPL references");
+    vplReferences->setData(sizeof(gl::GLuint) * maxVPLCount, nullptr, GL_DYNAMIC_COPY);
+    // read before the first light lists are built
+    gl::GLuint zero = 0;
+    vplReferences->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    MemoryRegistry::registerBuffer("Clustered Shading", vplReferences, sizeof(gl::GLuint) * maxVPLCount);
 }
 
 ClusteredShading::~ClusteredShading()
 {
-
+    MemoryRegistry::unregister(vplReferences.get());
 }
 
 void ClusteredShading::process(
@@ -75,7 +84,7 @@ void ClusteredShading::process(
     float zFar,
     int vplStartIndex,
     int vplEndIndex,
-    globjects::ref_ptr<globjects::Texture> depthBuffer,
+    globjects::ref_ptr<globjects::Texture> hiZBuffer,
     const globjects::ref_ptr<globjects::Buffer> vplBuffer)
 {
     {
@@ -83,23 +92,26 @@ void ClusteredShading::process(
         gl::GLuint zero = 0;
         m_atomicCounter->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
 
-        depthBuffer->bindActive(0);
+        hiZBuffer->bindActive(0);
         compactUsedClusterIDs->bindImageTexture(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
         lightListIds->bindImageTexture(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16UI);
         m_atomicCounter->bindBase(GL_SHADER_STORAGE_BUFFER, 0);
-        m_clusterIDProgram->setUniform("depthSampler", 0);
+        m_clusterIDProgram->setUniform("hiZSampler", 0);
         m_clusterIDProgram->setUniform("projectionMatrix", projection);
         m_clusterIDProgram->setUniform("zFar", zFar);
         m_clusterIDProgram->dispatchCompute(m_numClustersX, m_numClustersY, 1);
     }
     {
         AutoGLPerfCounter c("Light Lists");
+        gl::GLuint zero = 0;
         gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
         compactUsedClusterIDs->bindImageTexture(0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
         lightLists->bindImageTexture(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16UI);
         vplProcessor.packedVplBuffer->bindBase(GL_UNIFORM_BUFFER, 0);
         clusterCorners->bindImageTexture(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
         m_atomicCounter->bindBase(GL_SHADER_STORAGE_BUFFER, 0);
+        vplReferences->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        vplReferences->bindBase(GL_SHADER_STORAGE_BUFFER, 1);
         m_lightListsProgram->setUniform("viewport", viewport);
         m_lightListsProgram->setUniform("projectionMatrix", projection);
         m_lightListsProgram->setUniform("viewProjectionInverseMatrix", glm::inverse(projection * view));
@@ -123,5 +135,10 @@ void ClusteredShading::resizeTexture(int width, int height)
     // TODO memory usage. m_numClusters is theoretical worst case.
     lightLists->image2D(0, GL_R16UI, m_numClusters, maxVPLCount, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
     clusterCorners->image2D(0, GL_RGBA32F, m_numClusters, 8, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+    MemoryRegistry::registerTexture("Clustered Shading", compactUsedClusterIDs, GL_R32UI, m_numClusters, 1);
+    MemoryRegistry::registerTexture("Clustered Shading", lightListIds, GL_R16UI, m_numClustersX, m_numClustersY, numDepthSlices);
+    MemoryRegistry::registerTexture("Clustered Shading", lightLists, GL_R16UI, m_numClusters, maxVPLCount);
+    MemoryRegistry::registerTexture("Clustered Shading", clusterCorners, GL_RGBA32F, m_numClusters, 8);
     //lightListsBuffer->setData(m_numClusters * maxVPLCount * sizeof(short), nullptr, GL_STATIC_DRAW);
 }
@@ -35,7 +35,7 @@ public:
         float zFar,
         int vplStartIndex,
         int vplEndIndex,
-        globjects::ref_ptr<globjects::Texture> depthBuffer,
+        globjects::ref_ptr<globjects::Texture> hiZBuffer,
         const globjects::ref_ptr<globjects::Buffer> vplBuffer);
     void resizeTexture(int width, int height);
 
@@ -45,6 +45,8 @@ public:
     globjects::ref_ptr<globjects::Buffer> lightListsBuffer;
     globjects::ref_ptr<globjects::Texture> lightLists;
     globjects::ref_ptr<globjects::Texture> clusterCorners;
+    // per VPL the number of clusters whose light list contains it
+    globjects::ref_ptr<globjects::Buffer> vplReferences;
 
 private:
     int m_numClustersX;
@@ -18,6 +18,7 @@
 #include <reflectionzeug/property/PropertyGroup.h>
 
 #include "KernelGenerationStage.h"
+#include "MemoryRegistry.h"
 #include "ModelLoadingStage.h"
 #include "MultiFramePainter.h"
 #include "PerfCounter.h"
@@ -133,5 +134,6 @@ void DeferredShadingStage::process()
 void DeferredShadingStage::resizeTexture(int width, int height)
 {
     shadedFrame->image2D(0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+    MemoryRegistry::registerTexture("Deferred Shading", shadedFrame, GL_RGB32F, width, height);
     m_fbo->printStatus(true);
 }
@@ -20,12 +20,14 @@
 
 #include <reflectionzeug/property/extensions/GlmProperties.h>
 
+#include "MemoryRegistry.h"
 #include "ModelLoadingStage.h"
 #include "MultiFramePainter.h"
 #include "PerfCounter.h"
 #include "ImperfectShadowmap.h"
 #include "ClusteredShading.h"
 #include "VPLProcessor.h"
+#include "SceneGeometry.h"
 
 using namespace gl;
 
@@ -156,12 +158,123 @@ void GIStage::initProperties(MultiFramePainter& painter)
         { "precision", 3u },
     });
 
+    painter.addProperty<bool>("AutoTessLevelFactor",
+        [this]() { return autoTessLevelFactor; },
+        [this](const bool & value) {
+            autoTessLevelFactor = value;
+    });
+
+    painter.addProperty<int>("ISMPointBudget",
+        [this]() { return static_cast<int>(ismPointBudget); },
+        [this](const int & value) {
+            ismPointBudget = static_cast<unsigned int>(value);
+        }
+    )->setOptions({
+        { "minimum", 256 },
+        { "maximum", 32768 }
+    });
+
+    painter.addProperty<int>("RSMLodLevel",
+        [this]() { return static_cast<int>(rsmRenderer->lodLevel); },
+        [this](const int & value) {
+            rsmRenderer->lodLevel = static_cast<unsigned int>(value);
+        }
+    )->setOptions({
+        { "minimum", 0 },
+        { "maximum", static_cast<int>(MeshCache::maxLods) - 1 }
+    });
+
+    painter.addProperty<bool>("RSMFrustumCulling",
+        [this]() { return rsmRenderer->useFrustumCulling; },
+        [this](const bool & value) {
+            rsmRenderer->useFrustumCulling = value;
+    });
+
+    painter.addProperty<int>("ISMLodLevel",
+        [this]() { return static_cast<int>(ismLodLevel); },
+        [this](const int & value) {
+            ismLodLevel = static_cast<unsigned int>(value);
+        }
+    )->setOptions({
+        { "minimum", 0 },
+        { "maximum", static_cast<int>(MeshCache::maxLods) - 1 }
+    });
+
+    painter.addProperty<bool>("ISMMeshletCulling",
+        [this]() { return ismMeshletCulling; },
+        [this](const bool & value) {
+            ismMeshletCulling = value;
+    });
+
+    painter.addProperty<bool>("ISMPointCloud",
+        [this]() { return ismPointCloud; },
+        [this](const bool & value) {
+            ismPointCloud = value;
+    });
+
+    painter.addProperty<int>("ISMUpdateRotation",
+        [this]() { return ismUpdateRotation; },
+        [this](const int & value) {
+            ismUpdateRotation = value;
+        }
+    )->setOptions({
+        { "minimum", 1 },
+        { "maximum", 64 }
+    });
+
+    painter.addProperty<float>("ISMInvalidationThreshold",
+        [this]() { return ismInvalidationThreshold; },
+        [this](const float & value) {
+            ismInvalidationThreshold = value;
+        }
+    )->setOptions({
+        { "minimum", 0.0f },
+        { "step", 0.0005f },
+        { "precision", 4u },
+    });
+
     painter.addProperty<bool>("UsePushPull",
         [this]() { return usePushPull; },
         [this](const bool & value) {
         usePushPull = value;
     });
 
+    painter.addProperty<bool>("VariableISMSizes",
+        [this]() { return variableIsmSizes; },
+        [this](const bool & value) {
+            variableIsmSizes = value;
+    });
+
+    painter.addProperty<bool>("FusedPullPush",
+        [this]() { return fusedPullPush; },
+        [this](const bool & value) {
+            fusedPullPush = value;
+    });
+
+    painter.addProperty<bool>("CheckCompactPullPush",
+        [this]() { return checkCompactPullPush; },
+        [this](const bool & value) {
+            checkCompactPullPush = value;
+    });
+
+    painter.addProperty<bool>("ComputeISMSplatting",
+        [this]() { return computeIsmSplatting; },
+        [this](const bool & value) {
+            computeIsmSplatting = value;
+    });
+
+    painter.addProperty<bool>("CheckISMSplatting",
+        [this]() { return checkIsmSplatting; },
+        [this](const bool & value) {
+            checkIsmSplatting = value;
+    });
+
+    painter.addProperty<bool>("BinnedISMSplatting",
+        [this]() { return binnedIsmSplatting; },
+        [this](const bool & value) {
+            binnedIsmSplatting = value;
+    });
+
     painter.addProperty<bool>("GIShadowing",
         [this]() { return enableShadowing; },
         [this](const bool & value) {
@@ -210,8 +323,6 @@ void GIStage::initialize()
     m_blurFinalFbo = new globjects::Framebuffer();
     m_blurFinalFbo->attachTexture(GL_COLOR_ATTACHMENT0, giBlurFinalBuffer);
 
-    m_lightCamera->setEye(modelLoadingStage.getCurrentPresetInformation().lightPosition);
-    m_lightCamera->setCenter(modelLoadingStage.getCurrentPresetInformation().lightCenter);
     lightIntensity = 5.0f;
 
     giIntensityFactor = 3000.0f;
@@ -221,7 +332,19 @@ void GIStage::initialize()
     scaleISMs = false;
     pointsOnlyIntoScaledISMs = false;
     tessLevelFactor = 2.0f;
+    autoTessLevelFactor = false;
+    ismPointBudget = 8192;
+    ismMeshletCulling = true;
+    ismPointCloud = true;
+    ismUpdateRotation = 1;
+    ismInvalidationThreshold = 0.001f;
     usePushPull = true;
+    fusedPullPush = true;
+    variableIsmSizes = false;
+    checkCompactPullPush = false;
+    computeIsmSplatting = false;
+    checkIsmSplatting = false;
+    binnedIsmSplatting = false;
     enableShadowing = true;
     showVPLPositions = false;
     moveLight = false;
@@ -237,14 +360,13 @@ void GIStage::initialize()
     rsmRenderer->viewport = m_lightViewport.get();
     m_lightProjection->setHeight(5);
 
-    m_lightProjection->setZFar(projection->zFar());
-    m_lightProjection->setZNear(projection->zNear());
+    loadPreset(modelLoadingStage.getCurrentPresetInformation());
 
     rsmRenderer->projection = m_lightProjection.get();
 
     rsmRenderer->initialize();
 
-    ism = std::make_unique<ImperfectShadowmap>();
+    ism = std::make_unique<ImperfectShadowmap>(modelLoadingStage.getSceneGeometry().compactVertices());
     vplProcessor = std::make_unique<VPLProcessor>();
     clusteredShading = std::make_unique<ClusteredShading>();
 
@@ -276,6 +398,7 @@ void GIStage::compute_final_gathering()
 
 
     vplProcessor->vplBuffer->bindBase(GL_UNIFORM_BUFFER, 0);
+    ism->ismRects->bindBase(GL_SHADER_STORAGE_BUFFER, 4);
 
     m_fgProgram->setUniform("faceNormalSampler", 0);
     m_fgProgram->setUniform("depthSampler", 1);
@@ -343,6 +466,18 @@ void GIStage::blur()
     m_blurFinalFbo->unbind();
 }
 
+void GIStage::loadPreset(const PresetInformation& preset)
+{
+    m_lightCamera->setEye(preset.lightPosition);
+    m_lightCamera->setCenter(preset.lightCenter);
+
+    m_lightProjection->setZFar(preset.nearFar.y);
+    m_lightProjection->setZNear(preset.nearFar.x);
+
+    rsmRenderer->lodLevel = preset.rsmLodLevel;
+    ismLodLevel = preset.ismLodLevel;
+}
+
 void GIStage::process()
 {
     if (viewport->hasChanged())
@@ -376,16 +511,34 @@ void GIStage::process()
     }
 
     {
-        ism->process(
-            modelLoadingStage.getDrawablesMap(),
-            *vplProcessor.get(),
-            vplStartIndex,
-            vplEndIndex,
-            scaleISMs,
-            pointsOnlyIntoScaledISMs,
-            tessLevelFactor,
-            usePushPull,
-            m_lightProjection->zFar());
+        ImperfectShadowmap::Settings settings;
+        settings.vplStartIndex = vplStartIndex;
+        settings.vplEndIndex = vplEndIndex;
+        settings.scaleISMs = scaleISMs;
+        settings.pointsOnlyIntoScaledISMs = pointsOnlyIntoScaledISMs;
+        settings.tessLevelFactor = tessLevelFactor;
+        settings.autoTessLevelFactor = autoTessLevelFactor;
+        settings.usePushPull = usePushPull;
+        settings.fusedPullPush = fusedPullPush;
+        settings.checkCompactPullPush = checkCompactPullPush;
+        settings.zFar = m_lightProjection->zFar();
+        settings.lod = ismLodLevel;
+        settings.useMeshletCulling = ismMeshletCulling;
+        settings.usePointCloud = ismPointCloud;
+        settings.pointsPerVpl = ismPointBudget;
+        settings.updateRotation = ismUpdateRotation;
+        settings.lightPosition = m_lightCamera->eye();
+        settings.lightDirection = m_lightCamera->center() - m_lightCamera->eye();
+        settings.invalidationDistance == ismInvalidationThreshold * m_lightProjection->zFar();
+        settings.variableIsmSizes = variableIsmSizes;
+        settings.computeSplatting = computeIsmSplatting;
+        settings.checkSplatting = checkIsmSplatting;
+        settings.binnedSplatting = binnedIsmSplatting;
+        ism->process(modelLoadingStage.getSceneGeometry(), *vplProcessor.get(), *clusteredShading->vplReferences, settings);
+
+        // shows the chosen factor in the property
+        if (autoTessLevelFactor)
+            tessLevelFactor = ism->usedTessLevelFactor();
     }
 
 
@@ -398,7 +551,7 @@ void GIStage::process()
             projection->zFar(),
             vplStartIndex,
             vplEndIndex,
-            depthBuffer,
+            hiZBuffer,
             vplProcessor->vplBuffer);
     }
 
@@ -427,7 +580,6 @@ void GIStage::rebuildFGShader()
     globjects::Shader::globalReplace("#define SHOW_VPL_POSITIONS false", std::string("#define SHOW_VPL_POSITIONS ") + boolToString(showVPLPositions));
     globjects::Shader::globalReplace("#define ENABLE_SHADOWING true", std::string("#define ENABLE_SHADOWING ") + boolToString(enableShadowing));
     globjects::Shader::globalReplace("#define USE_INTERLEAVING true", std::string("#define USE_INTERLEAVING ") + boolToString(useInterleaving));
-    globjects::Shader::globalReplace("#define SCALE_ISMS false", std::string("#define SCALE_ISMS ") + boolToString(scaleISMs));
 
 
     auto shader = globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/gi/final_gathering.comp");
@@ -470,6 +622,11 @@ void GIStage::resizeTexture(int width, int height)
     giBuffer->image2D(0, GL_R11F_G11F_B10F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
     giBlurTempBuffer->image2D(0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
     giBlurFinalBuffer->image2D(0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+
+    MemoryRegistry::registerTexture("GI", giBuffer, GL_R11F_G11F_B10F, width, height);
+    MemoryRegistry::registerTexture("GI", giBlurTempBuffer, GL_R11F_G11F_B10F, width, height);
+    MemoryRegistry::registerTexture("GI", giBlurFinalBuffer, GL_R11F_G11F_B10F, width, height);
+
     m_fbo->printStatus(true);
     clusteredShading->resizeTexture(width, height);
 }
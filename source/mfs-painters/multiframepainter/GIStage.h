@@ -37,10 +37,12 @@ public:
 
     void initProperties(MultiFramePainter& painter);
     void initialize();
+    void loadPreset(const PresetInformation& preset);
     void process();
 
     globjects::ref_ptr<globjects::Texture> faceNormalBuffer;
     globjects::ref_ptr<globjects::Texture> depthBuffer;
+    globjects::ref_ptr<globjects::Texture> hiZBuffer;
 
     globjects::ref_ptr<globjects::Texture> giBuffer;
     globjects::ref_ptr<globjects::Texture> giBlurTempBuffer;
@@ -89,7 +91,36 @@ protected:
     bool scaleISMs;
     bool pointsOnlyIntoScaledISMs;
     float tessLevelFactor;
+    // picks tessLevelFactor so the points fill most of the budget
+    bool autoTessLevelFactor;
+    // point buffer slots per VPL, points beyond them are dropped and reported
+    unsigned int ismPointBudget;
+    unsigned int ismLodLevel;
+    // draws only the meshlets some VPL may see into the ISMs, compare "ISM render" with it off for the time saved
+    bool ismMeshletCulling;
+    // splats the scene points generated at load time instead of tessellating the scene every frame
+    bool ismPointCloud;
+    // renders the ISMs of one in ismUpdateRotation VPLs per frame and keeps the others, all of them are rendered
+    // again when the configuration changes or the light moved or turned so far since a kept ISM was rendered that
+    // its VPL may have moved farther than ismInvalidationThreshold times the light's far plane
+    int ismUpdateRotation;
+    float ismInvalidationThreshold;
     bool usePushPull;
+    // pulls and pushes three levels per dispatch, compare "PL1-3" and friends with PL1 to PS0 with it off
+    bool fusedPullPush;
+    // also runs the pull-push with a full precision pyramid and reports how many texels of the result differ
+    bool checkCompactPullPush;
+    // samples and splats the tessellated scene in one compute pass instead of tessellating into the point buffer and
+    // splatting that with ism.comp, compare "ISM compute splat" with "ISM render" and "ISM CS"
+    bool computeIsmSplatting;
+    // also splats with the other path and reports how many texels of the pull-push result differ between the two
+    bool checkIsmSplatting;
+    // splats the point buffer in equal chunks of points binned into atlas tiles instead of one work group per VPL,
+    // compare "ISM CS" with it off
+    bool binnedIsmSplatting;
+    // gives the brightest VPLs referenced by the most clusters larger ISMs and the least important ones smaller ISMs
+    // in the same atlas, renders all ISMs every frame
+    bool variableIsmSizes;
     bool enableShadowing;
 
     float sunCyclePosition;
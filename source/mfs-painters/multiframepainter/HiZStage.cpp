@@ -0,0 +1,129 @@
+#include "HiZStage.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <glm/vec2.hpp>
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/boolean.h>
+#include <glbinding/gl/functions.h>
+#include <glbinding/gl/bitfield.h>
+
+#include <globjects/Program.h>
+#include <globjects/Shader.h>
+#include <globjects/Texture.h>
+
+#include <gloperate/painter/AbstractViewportCapability.h>
+
+#include "MemoryRegistry.h"
+
+
+using namespace gl;
+
+namespace
+{
+    // every dispatch of hiz.comp writes this many levels, one workgroup per tile of the first
+    const int levelsPerDispatch = 7;
+    const int tileSize = 1 << (levelsPerDispatch - 1);
+
+    int nextPowerOfTwo(int value)
+    {
+        int result = 1;
+        while (result < value)
+            result *= 2;
+        return result;
+    }
+}
+
+
+HiZStage::HiZStage(const std::string& name)
+: m_viewportWidth(0)
+, m_viewportHeight(0)
+, m_width(0)
+, m_height(0)
+, m_numLevels(0)
+, m_name(name)
+{
+}
+
+HiZStage::~HiZStage()
+{
+    MemoryRegistry::unregister(hiZBuffer.get());
+}
+
+void HiZStage::initialize()
+{
+    m_program = new globjects::Program();
+    m_program->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/hiz/hiz.comp"));
+
+    globjects::Shader::globalReplace("#define LEVEL_ZERO", "#undef LEVEL_ZERO");
+    m_tailProgram = new globjects::Program();
+    m_tailProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/hiz/hiz.comp"));
+    globjects::Shader::clearGlobalReplacements();
+
+    hiZBuffer = globjects::Texture::createDefault(GL_TEXTURE_2D);
+    hiZBuffer->setName(m_name);
+    hiZBuffer->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    hiZBuffer->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void HiZStage::process()
+{
+    // compared instead of asking the viewport, stages may skip building the pyramid for a while
+    if (viewport->width() != m_viewportWidth || viewport->height() != m_viewportHeight)
+        resizeTexture(viewport->width(), viewport->height());
+
+    depthBuffer->bindActive(0);
+    m_program->setUniform("depthSampler", 0);
+    m_program->setUniform("sourceSize", glm::ivec2(viewport->width(), viewport->height()));
+    dispatch(m_program, 0, (m_width + tileSize - 1) / tileSize, (m_height + tileSize - 1) / tileSize);
+
+    // the last level of the first dispatch fits into one tile
+    if (m_numLevels > levelsPerDispatch)
+    {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        auto sourceLevel = levelsPerDispatch - 1;
+        hiZBuffer->bindImageTexture(0, sourceLevel, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        m_tailProgram->setUniform("sourceSize", glm::ivec2(std::max(m_width >> sourceLevel, 1), std::max(m_height >> sourceLevel, 1)));
+        dispatch(m_tailProgram, levelsPerDispatch, 1, 1);
+    }
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+int HiZStage::numLevels() const
+{
+    return m_numLevels;
+}
+
+void HiZStage::resizeTexture(int width, int height)
+{
+    m_viewportWidth = width;
+    m_viewportHeight = height;
+    m_width = nextPowerOfTwo((width + 1) / 2);
+    m_height = nextPowerOfTwo((height + 1) / 2);
+    m_numLevels = 1;
+    while ((std::max(m_width, m_height) >> m_numLevels) > 0)
+        ++m_numLevels;
+
+    // the tail dispatch covers a single tile
+    assert(m_numLevels <= 2 * levelsPerDispatch);
+
+    for (int level = 0; level < m_numLevels; ++level)
+        hiZBuffer->image2D(level, GL_RG32F, std::max(m_width >> level, 1), std::max(m_height >> level, 1), 0, GL_RG, GL_FLOAT, nullptr);
+    hiZBuffer->setParameter(GL_TEXTURE_MAX_LEVEL, m_numLevels - 1);
+
+    MemoryRegistry::registerTexture(m_name, hiZBuffer, GL_RG32F, m_width, m_height, 1, m_numLevels);
+}
+
+void HiZStage::dispatch(globjects::Program* program, int firstLevel, int groupsX, int groupsY)
+{
+    auto numLevels = std::min(levelsPerDispatch, m_numLevels - firstLevel);
+    for (int i = 0; i < numLevels; ++i)
+        hiZBuffer->bindImageTexture(1 + i, firstLevel + i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+    program->setUniform("numLevels", numLevels);
+    program->dispatchCompute(groupsX, groupsY, 1);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include <globjects/base/ref_ptr.h>
+
+namespace globjects
+{
+    class Program;
+    class Texture;
+}
+
+namespace gloperate
+{
+    class AbstractViewportCapability;
+}
+
+
+// Builds a hierarchical depth pyramid from depthBuffer for stages that need conservative depth bounds of screen regions.
+// Level 0 holds the nearest (red) and farthest (green) depth of 2x2 pixels, every further level reduces 2x2 texels of the
+// one before, so texel t of level l covers the pixels [t, t + 1) * 2^(l + 1). The sizes are rounded up to powers of two,
+// texels outside the viewport hold 1 and 0 so they never change a minimum or maximum.
+class HiZStage
+{
+public:
+    HiZStage(const std::string& name);
+    ~HiZStage();
+
+    void initialize();
+    void process();
+
+    int numLevels() const;
+
+    gloperate::AbstractViewportCapability * viewport;
+    globjects::ref_ptr<globjects::Texture> depthBuffer;
+
+    globjects::ref_ptr<globjects::Texture> hiZBuffer;
+
+protected:
+    void resizeTexture(int width, int height);
+    void dispatch(globjects::Program* program, int firstLevel, int groupsX, int groupsY);
+
+    globjects::ref_ptr<globjects::Program> m_program;
+    globjects::ref_ptr<globjects::Program> m_tailProgram;
+
+    int m_viewportWidth;
+    int m_viewportHeight;
+    int m_width; // of level 0
+    int m_height;
+    int m_numLevels;
+
+    std::string m_name;
+};
@@ -1,11 +1,16 @@
 #include "ImperfectShadowmap.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <iostream>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/geometric.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -19,12 +24,14 @@
 #include <globjects/Framebuffer.h>
 #include <globjects/Buffer.h>
 
+#include <gloperate/base/make_unique.hpp>
 #include <gloperate/primitives/VertexDrawable.h>
-#include <gloperate/primitives/PolygonalDrawable.h>
 #include <gloperate/painter/AbstractProjectionCapability.h>
 #include <gloperate/painter/AbstractCameraCapability.h>
 
+#include "MemoryRegistry.h"
 #include "VPLProcessor.h"
+#include "SceneGeometry.h"
 #include "PerfCounter.h"
 
 using namespace gl;
@@ -33,10 +40,109 @@ namespace
 {
     const int totalIsmPixelSize = 2048;
     const int maxIsmCount = 1024;
+
+    // the point buffer slices all VPLs share, 128 MB
+    const unsigned int defaultPointsPerVpl = 8192;
+
+    // the automatic tessellation factor aims below the budget, as points go to random VPLs
+    const float autoBudgetFill = 0.75f;
+    const float minAutoTessLevelFactor = 0.01f;
+    const float maxAutoTessLevelFactor = 64.0f;
+
+    const int meshletCullingGroupSize = 64;
+
+    // the pull-push pyramid holds levels 1 to 6, level 0 is softrenderBuffer and pushPullResultBuffer
+    const int pyramidLevels = 6;
+    const int pyramidSize = totalIsmPixelSize / 2;
+
+    // the mip level of the pyramid texture that holds a pull-push level
+    int pyramidMip(int level)
+    {
+        return level - 1;
+    }
+
+    const int differenceGroupSize = 8;
+
+    // pixels of the first level pull_fused.comp writes and of the last one push_fused.comp writes per work group
+    const int pullFusedBlockSize = 32;
+    const int pushFusedBlockSize = 64;
+
+    // bindings of meshlet_culling.comp, the VPLs are uniform buffer 0
+    const GLuint meshletsBinding = 1;
+    const GLuint meshletCommandsBinding = 2;
+    const GLuint meshletCountersBinding = 3;
+
+    // bindings of atlas_allocation.comp, the VPLs are uniform buffer 0 and the tile levels image 0.
+    // The ISM shaders and final gathering read the rects from the same binding
+    const GLuint vplReferencesBinding = 1;
+    const GLuint ismRectsBinding = 4;
+
+    // bindings of ism_sample.comp besides those of ism.comp, the meshlets are at meshletsBinding
+    const GLuint sampleVerticesBinding = 2;
+    const GLuint sampleIndicesBinding = 3;
+    const GLuint sampleMeshBoundsBinding = 5;
+    const GLuint sampleCommandsBinding = 6;
+    // the minimum of GL_MAX_COMPUTE_WORK_GROUP_COUNT
+    const size_t maxSampleGroups = 65535;
+
+    // the binned path of ism.comp, see ism_bin_utils.glsl
+    const int binTileSize = 32;
+    const int numBinTiles = (totalIsmPixelSize / binTileSize) * (totalIsmPixelSize / binTileSize);
+    const unsigned int binChunkSize = 1024;
+    // the splat buffer starts at minBinSplats and grows to a quarter more than a frame binned, up to maxBinSplats
+    const unsigned int minBinSplats = 1u << 20;
+    const unsigned int maxBinSplats = 1u << 23;
+
+    // bindings of the binned path, the point counters are at 0 and the ISM rects at ismRectsBinding
+    const GLuint sliceOffsetsBinding = 1;
+    const GLuint tileCountsBinding = 2;
+    const GLuint tileOffsetsBinding = 3;
+    const GLuint splatsBinding = 5;
+    const GLuint chunksBinding = 6;
+    const GLuint binCountersBinding = 7;
+
+    // matches binCounters_ in ism_bin_utils.glsl
+    struct BinCounters
+    {
+        GLuint pointGroups[3];
+        GLuint chunkGroups[3];
+        GLuint numBinnedPoints;
+        GLuint numSplats;
+        GLuint numChunks;
+    };
+
+    void dispatchComputeIndirect(globjects::Program* program, GLintptr offset)
+    {
+        program->use();
+        glDispatchComputeIndirect(offset);
+        program->release();
+    }
+
+    // one texel of ismTileLevels per cell of the atlas
+    const int tileLevelCellSize = 32;
+
+    // with variable sizes, one in largeIsmRatio ISMs gets a tile of twice the size, one in smallIsmRatio half of it
+    const int largeIsmRatio = 16;
+    const int smallIsmRatio = 4;
 }
 
-ImperfectShadowmap::ImperfectShadowmap()
+ImperfectShadowmap::ImperfectShadowmap(bool compactVertices)
+: m_pointsPerVpl(0)
+, m_pointFrames()
+, m_tessLevelFactor(0.0f)
+, m_autoSurfaceArea(0.0f)
+, m_frame(0)
+, m_updateConfig()
+, m_updateConfigValid(false)
+, m_nextChunk(0)
+, m_differenceCounted()
+, m_splatDifferenceCounted()
+, m_binCounted()
+, m_splatCapacity(0)
+, m_binnedSplats(0)
 {
+    if (!compactVertices)
+        globjects::Shader::globalReplace("#define COMPACT_VERTICES", "#undef COMPACT_VERTICES");
     m_shadowmapProgram = new globjects::Program();
     m_shadowmapProgram->attach(
         globjects::Shader::fromFile(GL_VERTEX_SHADER, "data/shaders/ism/ism.vert"),
@@ -45,6 +151,13 @@ ImperfectShadowmap::ImperfectShadowmap()
         globjects::Shader::fromFile(GL_GEOMETRY_SHADER, "data/shaders/ism/ism.geom"),
         globjects::Shader::fromFile(GL_FRAGMENT_SHADER, "data/shaders/ism/ism.frag")
     );
+    globjects::Shader::clearGlobalReplacements();
+
+    m_pointShadowmapProgram = new globjects::Program();
+    m_pointShadowmapProgram->attach(
+        globjects::Shader::fromFile(GL_VERTEX_SHADER, "data/shaders/ism/ism_points.vert"),
+        globjects::Shader::fromFile(GL_FRAGMENT_SHADER, "data/shaders/ism/ism.frag")
+    );
 
     m_pullLevelZeroProgram = new globjects::Program();
     m_pullLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/pull.comp"));
@@ -62,9 +175,103 @@ ImperfectShadowmap::ImperfectShadowmap()
     m_pushLevelZeroProgram = new globjects::Program();
     m_pushLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/push.comp"));
 
+    m_pullFusedLevelZeroProgram = new globjects::Program();
+    m_pullFusedLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/pull_fused.comp"));
+
+    globjects::Shader::globalReplace("#define LEVEL_ZERO", "#undef LEVEL_ZERO");
+    m_pullFusedProgram = new globjects::Program();
+    m_pullFusedProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/pull_fused.comp"));
+    globjects::Shader::clearGlobalReplacements();
+
+    globjects::Shader::globalReplace("#define LEVEL_ZERO", "#undef LEVEL_ZERO");
+    m_pushFusedProgram = new globjects::Program();
+    m_pushFusedProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/push_fused.comp"));
+    globjects::Shader::clearGlobalReplacements();
+
+    m_pushFusedLevelZeroProgram = new globjects::Program();
+    m_pushFusedLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/push_fused.comp"));
+
+    globjects::Shader::globalReplace("#define COMPACT_PYRAMID", "#undef COMPACT_PYRAMID");
+    m_pullReferenceLevelZeroProgram = new globjects::Program();
+    m_pullReferenceLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/pull.comp"));
+    m_pushReferenceLevelZeroProgram = new globjects::Program();
+    m_pushReferenceLevelZeroProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/push.comp"));
+    globjects::Shader::globalReplace("#define LEVEL_ZERO", "#undef LEVEL_ZERO");
+    m_pullReferenceProgram = new globjects::Program();
+    m_pullReferenceProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/pull.comp"));
+    m_pushReferenceProgram = new globjects::Program();
+    m_pushReferenceProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/push.comp"));
+    globjects::Shader::clearGlobalReplacements();
+
+    m_differenceProgram = new globjects::Program();
+    m_differenceProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/image_difference.comp"));
+    for (auto& counters : m_differenceCounters)
+    {
+        GLuint zero[2] = { 0, 0 };
+        counters = new globjects::Buffer();
+        counters->setName("ISM Pull-Push Difference Counters");
+        counters->setData(sizeof(zero), zero, GL_STREAM_READ);
+        MemoryRegistry::registerBuffer("ISM", counters, sizeof(zero));
+    }
+    for (auto& counters : m_splatDifferenceCounters)
+    {
+        GLuint zero[2] = { 0, 0 };
+        counters = new globjects::Buffer();
+        counters->setName("ISM Splat Difference Counters");
+        counters->setData(sizeof(zero), zero, GL_STREAM_READ);
+        MemoryRegistry::registerBuffer("ISM", counters, sizeof(zero));
+    }
+
     m_pointSoftRenderProgram = new globjects::Program();
     m_pointSoftRenderProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism.comp"));
 
+    if (!compactVertices)
+        globjects::Shader::globalReplace("#define COMPACT_VERTICES", "#undef COMPACT_VERTICES");
+    m_sampleProgram = new globjects::Program();
+    m_sampleProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_sample.comp"));
+    globjects::Shader::clearGlobalReplacements();
+
+    m_binSlicesProgram = new globjects::Program();
+    m_binSlicesProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_bin_slices.comp"));
+    m_binCountProgram = new globjects::Program();
+    m_binCountProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_bin.comp"));
+    globjects::Shader::globalReplace("#define COUNT_SPLATS", "#undef COUNT_SPLATS");
+    m_binScatterProgram = new globjects::Program();
+    m_binScatterProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_bin.comp"));
+    globjects::Shader::clearGlobalReplacements();
+    m_binTilesProgram = new globjects::Program();
+    m_binTilesProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_bin_tiles.comp"));
+    m_binResolveProgram = new globjects::Program();
+    m_binResolveProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/ism_bin_resolve.comp"));
+
+    m_meshletCullingProgram = new globjects::Program();
+    m_meshletCullingProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/meshlet_culling.comp"));
+
+    m_atlasAllocationProgram = new globjects::Program();
+    m_atlasAllocationProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/ism/atlas_allocation.comp"));
+
+    ismRects = new globjects::Buffer();
+    ismRects->setName("ISM Rects");
+    ismRects->setData(sizeof(glm::vec4) * maxIsmCount, nullptr, GL_DYNAMIC_COPY);
+    MemoryRegistry::registerBuffer("ISM", ismRects, sizeof(glm::vec4) * maxIsmCount);
+
+    ismTileLevels = globjects::Texture::createDefault(GL_TEXTURE_2D);
+    ismTileLevels->setParameter(gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST);
+    ismTileLevels->setParameter(gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
+    ismTileLevels->setName("ISM Tile Levels");
+    ismTileLevels->storage2D(1, GL_R8UI, totalIsmPixelSize / tileLevelCellSize, totalIsmPixelSize / tileLevelCellSize);
+    MemoryRegistry::registerTexture("ISM", ismTileLevels, GL_R8UI, totalIsmPixelSize / tileLevelCellSize, totalIsmPixelSize / tileLevelCellSize);
+
+    m_meshletSelection = gloperate::make_unique<DrawSelection>("ISM Meshlets");
+    for (auto& counters : m_meshletCounters)
+    {
+        GLuint zero[2] = { 0, 0 };
+        counters = new globjects::Buffer();
+        counters->setName("ISM Meshlet Counters");
+        counters->setData(sizeof(zero), zero, GL_STREAM_READ);
+        MemoryRegistry::registerBuffer("ISM", counters, sizeof(zero));
+    }
+
     m_fbo = new globjects::Framebuffer();
     depthBuffer = globjects::Texture::createDefault();
     depthBuffer->setParameter(gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST);
@@ -82,21 +289,26 @@ ImperfectShadowmap::ImperfectShadowmap()
     m_fbo->printStatus(true);
 
 
-    pullBuffer = new globjects::Texture(GL_TEXTURE_2D);
-    pullBuffer->setName("Pull Buffer");
-    pullBuffer->storage2D(10, GL_RGBA32F, totalIsmPixelSize, totalIsmPixelSize);
-
-    pushBuffer = new globjects::Texture(GL_TEXTURE_2D);
-    pushBuffer->setName("Push Buffer");
-    pushBuffer->storage2D(10, GL_RGBA32F, totalIsmPixelSize, totalIsmPixelSize);
-    pushBuffer->setParameter(gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST_MIPMAP_NEAREST);
-    pushBuffer->setParameter(gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
+    // two uints per pixel, see pullpush_utils.glsl
+    pullPushPyramid = new globjects::Texture(GL_TEXTURE_2D);
+    pullPushPyramid->setName("Pull-Push Pyramid");
+    pullPushPyramid->storage2D(pyramidLevels, GL_RG32UI, pyramidSize, pyramidSize);
+    pullPushPyramid->setParameter(gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST_MIPMAP_NEAREST);
+    pullPushPyramid->setParameter(gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
 
-    auto b = new globjects::Buffer();
-    b->setData(sizeof(glm::vec4) * (1 << 23) , nullptr, GL_STATIC_DRAW);
+    m_pointBufferStorage = new globjects::Buffer();
+    m_pointBufferStorage->setName("Point Buffer Storage");
     pointBuffer = new globjects::Texture(GL_TEXTURE_BUFFER);
     pointBuffer->setName("Point Buffer");
-    pointBuffer->texBuffer(GL_RGBA32F, b);
+    resizePointBuffer(defaultPointsPerVpl);
+
+    for (auto& counters : m_pointCounters)
+    {
+        counters = new globjects::Buffer();
+        counters->setName("ISM Point Counters");
+        counters->setData(sizeof(gl::GLuint) * maxIsmCount, nullptr, GL_STREAM_READ);
+        MemoryRegistry::registerBuffer("ISM", counters, sizeof(gl::GLuint) * maxIsmCount);
+    }
 
 
     pushPullResultBuffer = new globjects::Texture(GL_TEXTURE_2D);
@@ -108,6 +320,12 @@ ImperfectShadowmap::ImperfectShadowmap()
     m_atomicCounter = new globjects::Buffer();
     m_atomicCounter->setName("atomic counter");
     m_atomicCounter->setData(sizeof(gl::GLuint)*1024 * 4, nullptr, GL_STATIC_DRAW);
+
+    MemoryRegistry::registerTexture("ISM", depthBuffer, GL_DEPTH_COMPONENT16, totalIsmPixelSize, totalIsmPixelSize);
+    MemoryRegistry::registerTexture("ISM", softrenderBuffer, GL_R32UI, totalIsmPixelSize, totalIsmPixelSize);
+    MemoryRegistry::registerTexture("ISM", pullPushPyramid, GL_RG32UI, pyramidSize, pyramidSize, 1, pyramidLevels);
+    MemoryRegistry::registerTexture("ISM", pushPullResultBuffer, GL_R16, totalIsmPixelSize, totalIsmPixelSize);
+    MemoryRegistry::registerBuffer("ISM", m_atomicCounter, sizeof(gl::GLuint) * 1024 * 4);
     m_atomicCounterTexture = new globjects::Texture(GL_TEXTURE_BUFFER);
     m_atomicCounterTexture->setName("pointCounterTexture");
     //m_atomicCounterTexture->texBuffer(GL_R32UI, b);
@@ -115,84 +333,624 @@ ImperfectShadowmap::ImperfectShadowmap()
 
 ImperfectShadowmap::~ImperfectShadowmap()
 {
+    for (auto& counters : m_meshletCounters)
+        MemoryRegistry::unregister(counters.get());
+    for (auto& counters : m_pointCounters)
+        MemoryRegistry::unregister(counters.get());
+    MemoryRegistry::unregister(m_pointBufferStorage.get());
+    MemoryRegistry::unregister(ismRects.get());
+    for (auto& counters : m_differenceCounters)
+        MemoryRegistry::unregister(counters.get());
+    for (auto& counters : m_splatDifferenceCounters)
+        MemoryRegistry::unregister(counters.get());
+    if (m_referencePyramid)
+    {
+        MemoryRegistry::unregister(m_referencePyramid.get());
+        MemoryRegistry::unregister(m_referenceResult.get());
+    }
+    if (m_splats)
+    {
+        MemoryRegistry::unregister(m_sliceOffsets.get());
+        MemoryRegistry::unregister(m_tileCounts.get());
+        MemoryRegistry::unregister(m_tileOffsets.get());
+        MemoryRegistry::unregister(m_binCounters.get());
+        for (auto& counters : m_binCounterReadback)
+            MemoryRegistry::unregister(counters.get());
+        MemoryRegistry::unregister(m_splats.get());
+        MemoryRegistry::unregister(m_chunks.get());
+    }
+}
+
+bool ImperfectShadowmap::UpdateConfig::operator==(const UpdateConfig& other) const
+{
+    return vplStartIndex == other.vplStartIndex
+        && vplEndIndex == other.vplEndIndex
+        && scaleISMs == other.scaleISMs
+        && pointsOnlyIntoScaledISMs == other.pointsOnlyIntoScaledISMs
+        && usePushPull == other.usePushPull
+        && usePointCloud == other.usePointCloud
+        && zFar == other.zFar
+        && lod == other.lod
+        && updateRotation == other.updateRotation
+        && numPoints == other.numPoints
+        && surfaceArea == other.surfaceArea
+        && variableIsmSizes == other.variableIsmSizes
+        && computeSplatting == other.computeSplatting;
+}
+
+float ImperfectShadowmap::usedTessLevelFactor() const
+{
+    return m_tessLevelFactor;
+}
+
+void ImperfectShadowmap::resizePointBuffer(unsigned int pointsPerVpl)
+{
+    if (pointsPerVpl == m_pointsPerVpl)
+        return;
+
+    m_pointsPerVpl = pointsPerVpl;
+    auto size = sizeof(glm::vec4) * pointsPerVpl * maxIsmCount;
+    m_pointBufferStorage->setData(static_cast<GLsizeiptr>(size), nullptr, GL_STATIC_DRAW);
+    pointBuffer->texBuffer(GL_RGBA32F, m_pointBufferStorage);
+    MemoryRegistry::registerBuffer("ISM", m_pointBufferStorage, size);
+}
 
+void ImperfectShadowmap::evaluatePointCounts(const SceneGeometry& sceneGeometry, int numSlices, int sliceSize, float tessLevelFactor, bool autoTessLevelFactor)
+{
+    // the counters of the previous frame are done by now, the ones of the frame before are reused
+    const auto& frame = m_pointFrames[(m_frame + 1) % 2];
+    // atomicBuffer_ is std430 in the ISM shaders, so the counters are tightly packed
+    GLuint counts[maxIsmCount];
+    m_pointCounters[(m_frame + 1) % 2]->getSubData(0, sizeof(counts), counts);
+
+    uint64_t numPoints = 0;
+    uint64_t numDropped = 0;
+    GLuint maxCount = 0;
+    unsigned int numOverflowing = 0;
+    for (int i = 0; i < frame.numSlices; ++i)
+    {
+        numPoints += counts[i];
+        maxCount = std::max(maxCount, counts[i]);
+        if (counts[i] > static_cast<GLuint>(frame.sliceSize))
+        {
+            numDropped += counts[i] - frame.sliceSize;
+            numOverflowing++;
+        }
+    }
+    PerfCounter::setCount("ISM points", numPoints);
+    PerfCounter::setCount("ISM points dropped", numDropped);
+    PerfCounter::setCount("ISM overflowing VPLs", numOverflowing);
+    PerfCounter::setCount("ISM max points per VPL", maxCount);
+
+    if (!autoTessLevelFactor)
+    {
+        m_tessLevelFactor = tessLevelFactor;
+        m_autoSurfaceArea = 0.0f;
+        return;
+    }
+
+    auto targetPoints = autoBudgetFill * sliceSize * numSlices;
+    auto area = sceneGeometry.surfaceArea();
+    if (area != m_autoSurfaceArea)
+    {
+        // tessellating a triangle with edge length l and area sqrt(3) / 4 * l^2 at level l * factor
+        // gives about 1.5 * (l * factor)^2 triangles of one point each
+        m_autoSurfaceArea = area;
+        m_tessLevelFactor = area > 0.0f ? std::sqrt(targetPoints / (2.0f * std::sqrt(3.0f) * area)) : tessLevelFactor;
+    }
+    else if (frame.tessellated && numPoints > 0)
+    {
+        // the count grows with the square of the factor, moving halfway keeps the integer tessellation levels from oscillating.
+        // A rotated update tessellated for one in updateRotation of the VPLs
+        auto fullPoints = static_cast<float>(numPoints) * std::max(frame.updateRotation, 1);
+        m_tessLevelFactor = frame.tessLevelFactor * std::pow(targetPoints / fullPoints, 0.25f);
+    }
+    m_tessLevelFactor = std::min(std::max(m_tessLevelFactor, minAutoTessLevelFactor), maxAutoTessLevelFactor);
 }
 
-void ImperfectShadowmap::pullpush(int ismPixelSize, float zFar) const
+void ImperfectShadowmap::pullpush(float zFar, int firstRow, int numRows, bool reference) const
 {
-    AutoGLDebugGroup c("ISM pushpull");
+    AutoGLDebugGroup c(reference ? "ISM pushpull reference" : "ISM pushpull");
+
+    auto pyramid = reference ? m_referencePyramid : pullPushPyramid;
+    auto pyramidFormat = reference ? GL_RGBA32F : GL_RG32UI;
+    auto resultBuffer = reference ? m_referenceResult : pushPullResultBuffer;
+    // the reference is timed as a whole by its caller
+    auto timed = !reference;
 
     softrenderBuffer->bindActive(0);
+    ismTileLevels->bindActive(1);
 
     // i indicates to which level is written
     for (int i = 1; i <= 6; i++) {
-        if (i <= 3)
+        if (timed && i <= 3)
             PerfCounter::beginGL("PL" + std::to_string(i));
-        if (i == 4)
+        if (timed && i == 4)
             PerfCounter::beginGL("PLO"); // PLO = pull, other
 
         gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        pullBuffer->bindImageTexture(0, i - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-        pullBuffer->bindImageTexture(1, i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        // level zero is read from softrenderBuffer
+        if (i > 1)
+            pyramid->bindImageTexture(0, pyramidMip(i - 1), GL_FALSE, 0, GL_READ_ONLY, pyramidFormat);
+        pyramid->bindImageTexture(1, pyramidMip(i), GL_FALSE, 0, GL_WRITE_ONLY, pyramidFormat);
 
-        auto program = (i == 1) ? m_pullLevelZeroProgram : m_pullProgram;
+        auto program = reference
+            ? ((i == 1) ? m_pullReferenceLevelZeroProgram : m_pullReferenceProgram)
+            : ((i == 1) ? m_pullLevelZeroProgram : m_pullProgram);
         program->setUniform("level", i);
-        program->setUniform("ismPixelSize", ismPixelSize);
         program->setUniform("zFar", zFar);
+        program->setUniform("invocationOffset", glm::ivec2(0, firstRow >> i));
+        program->setUniform("rowEnd", (firstRow + numRows) >> i);
 
         int workGroupSize = 8;
         int numGroups = totalIsmPixelSize / int(std::pow(2, i)) / workGroupSize;
-        program->dispatchCompute(numGroups, numGroups, 1);
+        int numRowGroups = ((numRows >> i) + workGroupSize - 1) / workGroupSize;
+        program->dispatchCompute(numGroups, numRowGroups, 1);
 
-        if (i <= 3)
+        if (timed && i <= 3)
             PerfCounter::endGL("PL" + std::to_string(i));
     }
-    PerfCounter::endGL("PLO");
+    if (timed)
+        PerfCounter::endGL("PLO");
 
-    pushPullResultBuffer->bindImageTexture(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16);
+    resultBuffer->bindImageTexture(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16);
 
-    PerfCounter::beginGL("PSO");
+    if (timed)
+        PerfCounter::beginGL("PSO");
     for (int i = 5; i >= 0; i--) {
-        if (i <= 2)
+        if (timed && i <= 2)
             PerfCounter::beginGL("PS" + std::to_string(i));
 
         gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        pullBuffer->bindImageTexture(0, i, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-        // in the first step, read directly from pullBuffer as there is no pushBuffer yet
-        auto readTexture = (i == 5) ? pullBuffer : pushBuffer;
-        readTexture->bindImageTexture(1, i+1, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-        pushBuffer->bindImageTexture(2, i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-        auto currResultBuffer = (i == 0) ? pushPullResultBuffer : pushBuffer;
-
-        auto program = (i == 0) ? m_pushLevelZeroProgram : m_pushProgram;
+        // pushed in place, level 6 is only pulled. Level zero is read from softrenderBuffer and written to the result
+        if (i > 0)
+            pyramid->bindImageTexture(0, pyramidMip(i), GL_FALSE, 0, GL_READ_WRITE, pyramidFormat);
+        pyramid->bindImageTexture(1, pyramidMip(i + 1), GL_FALSE, 0, GL_READ_ONLY, pyramidFormat);
+
+        auto program = reference
+            ? ((i == 0) ? m_pushReferenceLevelZeroProgram : m_pushReferenceProgram)
+            : ((i == 0) ? m_pushLevelZeroProgram : m_pushProgram);
         program->setUniform("level", i);
+        program->setUniform("invocationOffset", glm::ivec2(0, firstRow >> (i + 1)));
 
         int workGroupSize = 8;
         // divide by two since each invocation processes four output pixels.
         // plus one since invocation (0,0) processes pixels ([-1,0],[-1,0]),
         // therefore we would miss the last row/column of pixels to the right/top.
+        // The pixels written next to the rows are recomputed from the same inputs, as no ISM border is crossed,
+        // and pushing a pixel that was pushed already leaves it as it is.
         int numGroups = totalIsmPixelSize / int(std::pow(2, i)) / workGroupSize / 2 + 1;
-        program->dispatchCompute(numGroups, numGroups, 1);
+        int numRowGroups = (numRows >> i) / workGroupSize / 2 + 1;
+        program->dispatchCompute(numGroups, numRowGroups, 1);
 
-        if (i <= 2)
+        if (timed && i <= 2)
             PerfCounter::endGL("PS" + std::to_string(i));
-        if (i == 3)
+        if (timed && i == 3)
             PerfCounter::endGL("PSO");
     }
 }
 
-void ImperfectShadowmap::process(const IdDrawablesMap& drawablesMap, const VPLProcessor& vplProcessor, int vplStartIndex, int vplEndIndex, bool scaleISMs, bool pointsOnlyIntoScaledISMs, float tessLevelFactor, bool usePushPull, float zFar) const
+void ImperfectShadowmap::pullpushFused(float zFar, int firstRow, int numRows) const
 {
-    render(drawablesMap, vplProcessor, vplStartIndex, vplEndIndex, scaleISMs, pointsOnlyIntoScaledISMs, tessLevelFactor, usePushPull, zFar);
-    int vplCount = vplEndIndex - vplStartIndex;
-    int ismCount = (scaleISMs) ? vplCount : maxIsmCount;
+    AutoGLDebugGroup c("ISM pushpull fused");
+
+    softrenderBuffer->bindActive(0);
+    ismTileLevels->bindActive(1);
+
+    // levels 1 to 3 from level 0, then 4 to 6 from 3
+    for (int i = 1; i <= 4; i += 3) {
+        auto counterName = "PL" + std::to_string(i) + "-" + std::to_string(i + 2);
+        PerfCounter::beginGL(counterName);
+
+        gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        // level zero is read from softrenderBuffer
+        if (i > 1)
+            pullPushPyramid->bindImageTexture(0, pyramidMip(i - 1), GL_FALSE, 0, GL_READ_ONLY, GL_RG32UI);
+        pullPushPyramid->bindImageTexture(1, pyramidMip(i), GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32UI);
+        pullPushPyramid->bindImageTexture(2, pyramidMip(i + 1), GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32UI);
+        pullPushPyramid->bindImageTexture(3, pyramidMip(i + 2), GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32UI);
+
+        auto program = (i == 1) ? m_pullFusedLevelZeroProgram : m_pullFusedProgram;
+        program->setUniform("level", i);
+        program->setUniform("zFar", zFar);
+        program->setUniform("blockOffset", glm::ivec2(0, firstRow >> i));
+        program->setUniform("rowEnd", (firstRow + numRows) >> i);
+
+        int numGroups = (totalIsmPixelSize >> i) / pullFusedBlockSize;
+        int numRowGroups = ((numRows >> i) + pullFusedBlockSize - 1) / pullFusedBlockSize;
+        program->dispatchCompute(numGroups, numRowGroups, 1);
+
+        PerfCounter::endGL(counterName);
+    }
+
+    // levels 5 to 3 from the pulled level 6, then 2 to 0 from the pushed level 3
+    for (int i = 3; i >= 0; i -= 3) {
+        auto counterName = "PS" + std::to_string(i + 2) + "-" + std::to_string(i);
+        PerfCounter::beginGL(counterName);
+
+        gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        pullPushPyramid->bindImageTexture(0, pyramidMip(i + 3), GL_FALSE, 0, GL_READ_ONLY, GL_RG32UI);
+        pullPushPyramid->bindImageTexture(1, pyramidMip(i + 2), GL_FALSE, 0, GL_READ_ONLY, GL_RG32UI);
+        pullPushPyramid->bindImageTexture(2, pyramidMip(i + 1), GL_FALSE, 0, GL_READ_ONLY, GL_RG32UI);
+        // only the last level is written, in place
+        if (i == 0)
+            pushPullResultBuffer->bindImageTexture(4, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16);
+        else
+            pullPushPyramid->bindImageTexture(3, pyramidMip(i), GL_FALSE, 0, GL_READ_WRITE, GL_RG32UI);
+
+        auto program = (i == 0) ? m_pushFusedLevelZeroProgram : m_pushFusedProgram;
+        program->setUniform("level", i);
+        program->setUniform("blockOffset", glm::ivec2(0, firstRow >> i));
+
+        // the blocks are aligned to the rows, which start at ISM borders
+        int numGroups = (totalIsmPixelSize >> i) / pushFusedBlockSize;
+        int numRowGroups = ((numRows >> i) + pushFusedBlockSize - 1) / pushFusedBlockSize;
+        program->dispatchCompute(numGroups, numRowGroups, 1);
+
+        PerfCounter::endGL(counterName);
+    }
+}
+
+void ImperfectShadowmap::allocateReferencePullPush()
+{
+    if (m_referencePyramid)
+        return;
+
+    m_referencePyramid = new globjects::Texture(GL_TEXTURE_2D);
+    m_referencePyramid->setName("Pull-Push Reference Pyramid");
+    m_referencePyramid->storage2D(pyramidLevels, GL_RGBA32F, pyramidSize, pyramidSize);
+    MemoryRegistry::registerTexture("ISM", m_referencePyramid, GL_RGBA32F, pyramidSize, pyramidSize, 1, pyramidLevels);
+
+    m_referenceResult = globjects::Texture::createDefault(GL_TEXTURE_2D);
+    m_referenceResult->setParameter(gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST);
+    m_referenceResult->setParameter(gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
+    m_referenceResult->setName("Pull-Push Reference Result");
+    m_referenceResult->storage2D(1, GL_R16, totalIsmPixelSize, totalIsmPixelSize);
+    MemoryRegistry::registerTexture("ISM", m_referenceResult, GL_R16, totalIsmPixelSize, totalIsmPixelSize);
+}
+
+void ImperfectShadowmap::countDifferences(globjects::Buffer* counters, int firstRow, int numRows)
+{
+    GLuint zero = 0;
+    counters->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    gl::glMemoryBarrier(gl::GL_TEXTURE_FETCH_BARRIER_BIT);
+    pushPullResultBuffer->bindActive(0);
+    m_referenceResult->bindActive(1);
+    counters->bindBase(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // only the updated rows, the reference keeps nothing of earlier frames
+    m_differenceProgram->setUniform("invocationOffset", glm::ivec2(0, firstRow));
+    m_differenceProgram->setUniform("rowEnd", firstRow + numRows);
+    m_differenceProgram->dispatchCompute(totalIsmPixelSize / differenceGroupSize, (numRows + differenceGroupSize - 1) / differenceGroupSize, 1);
+
+    gl::glMemoryBarrier(gl::GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void ImperfectShadowmap::checkCompactPullPush(float zFar, int firstRow, int numRows)
+{
+    // render() moved on to the next frame's counters already, the ones of the previous frame are done by now
+    auto current = (m_frame + 1) % 2;
+    auto previous = m_frame % 2;
+    GLuint counters[2] = { 0, 0 };
+    if (m_differenceCounted[previous])
+        m_differenceCounters[previous]->getSubData(0, sizeof(counters), counters);
+    PerfCounter::setCount("ISM pull-push differing texels", counters[0]);
+    PerfCounter::setCount("ISM pull-push max difference", counters[1]);
+
+    allocateReferencePullPush();
+
+    {
+        AutoGLPerfCounter c("ISM pushpull reference");
+        pullpush(zFar, firstRow, numRows, true);
+    }
+
+    m_differenceCounted[current] = true;
+    countDifferences(m_differenceCounters[current], firstRow, numRows);
+}
+
+void ImperfectShadowmap::checkSplatting(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, const Settings& settings, int ismIndices1d, const Update& update)
+{
+    // render() moved on to the next frame's counters already, the ones of the previous frame are done by now
+    auto current = (m_frame + 1) % 2;
+    auto previous = m_frame % 2;
+    GLuint counters[2] = { 0, 0 };
+    if (m_splatDifferenceCounted[previous])
+        m_splatDifferenceCounters[previous]->getSubData(0, sizeof(counters), counters);
+    PerfCounter::setCount("ISM splat differing texels", counters[0]);
+    PerfCounter::setCount("ISM splat max difference", counters[1]);
+
+    allocateReferencePullPush();
+
+    // the other path splats the same update into the cleared rows, the pull-push of the one this frame uses is done
+    // with them. Its reference pull-push keeps full precision, so the differences include those the compact pyramid makes
+    auto updateTessLevelFactor = m_tessLevelFactor / std::sqrt(static_cast<float>(update.rotation));
+    {
+        AutoGLPerfCounter c(settings.computeSplatting ? "ISM tessellated splat check" : "ISM compute splat check");
+        clearUpdatedISMs(update, ismIndices1d, true);
+        prepareSplatting(vplProcessor);
+        if (settings.computeSplatting)
+        {
+            // the tessellated points are only splatted with push-pull
+            auto tessellated = settings;
+            tessellated.usePushPull = true;
+            tessellated.usePointCloud = false;
+            renderPoints(sceneGeometry, tessellated, updateTessLevelFactor, update, false);
+        }
+        else
+        {
+            sampleAndSplat(sceneGeometry, settings, updateTessLevelFactor, update);
+        }
+
+        gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        pullpush(settings.zFar, update.firstRow, update.numRows, true);
+    }
+
+    m_splatDifferenceCounted[current] = true;
+    countDifferences(m_splatDifferenceCounters[current], update.firstRow, update.numRows);
+}
+
+void ImperfectShadowmap::process(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, const globjects::Buffer& vplReferences, const Settings& settings)
+{
+    // points only go to the VPLs of the scaled ISMs or to any of them, see ism.geom
+    int firstSampledVpl = settings.pointsOnlyIntoScaledISMs ? settings.vplStartIndex : 0;
+    int numSampledVpls = settings.pointsOnlyIntoScaledISMs ? settings.vplEndIndex - settings.vplStartIndex : maxIsmCount;
+
+    int vplCount = settings.vplEndIndex - settings.vplStartIndex;
+    int ismCount = (settings.scaleISMs) ? vplCount : maxIsmCount;
+    int ismIndices1d = int(pow(2, ceil(log2(ismCount) / 2))); // next even power of two
+    {
+        AutoGLPerfCounter c("ISM atlas allocation");
+        allocateAtlas(vplProcessor, vplReferences, settings.scaleISMs ? settings.vplStartIndex : 0, ismCount, ismIndices1d, settings.variableIsmSizes);
+    }
+
+    // the tiles move between frames with variable sizes, so all ISMs are rendered every frame
+    auto updateRotation = settings.variableIsmSizes ? 1 : settings.updateRotation;
+
+    UpdateConfig config;
+    config.vplStartIndex = settings.vplStartIndex;
+    config.vplEndIndex = settings.vplEndIndex;
+    config.scaleISMs = settings.scaleISMs;
+    config.pointsOnlyIntoScaledISMs = settings.pointsOnlyIntoScaledISMs;
+    config.usePushPull = settings.usePushPull;
+    config.usePointCloud = settings.usePointCloud && sceneGeometry.numPoints() > 0;
+    config.zFar = settings.zFar;
+    config.lod = settings.lod;
+    config.updateRotation = updateRotation;
+    config.numPoints = sceneGeometry.numPoints();
+    config.surfaceArea = sceneGeometry.surfaceArea();
+    config.variableIsmSizes = settings.variableIsmSizes;
+    config.computeSplatting = settings.computeSplatting;
+    LightPose light;
+    light.position = settings.lightPosition;
+    light.direction = glm::normalize(settings.lightDirection);
+    auto update = selectUpdate(config, light, settings.invalidationDistance, firstSampledVpl, numSampledVpls, updateRotation);
+    render(sceneGeometry, vplProcessor, settings, update);
+    if (update.numRows > 0 && settings.fusedPullPush)
+        pullpushFused(settings.zFar, update.firstRow, update.numRows);
+    else if (update.numRows > 0)
+        pullpush(settings.zFar, update.firstRow, update.numRows, false);
+
+    // render() moved on to the next frame's counters already
+    if (settings.checkCompactPullPush && update.numRows > 0)
+        checkCompactPullPush(settings.zFar, update.firstRow, update.numRows);
+    else
+        m_differenceCounted[(m_frame + 1) % 2] = false;
+
+    // both paths splat only with push-pull and tessellation
+    auto splattable = settings.usePushPull && !(settings.usePointCloud && sceneGeometry.numPoints() > 0);
+    if (settings.checkSplatting && splattable && update.numRows > 0)
+        checkSplatting(sceneGeometry, vplProcessor, settings, ismIndices1d, update);
+    else
+        m_splatDifferenceCounted[(m_frame + 1) % 2] = false;
+}
+
+void ImperfectShadowmap::allocateAtlas(const VPLProcessor& vplProcessor, const globjects::Buffer& vplReferences, int ismOffset, int numIsms, int ismIndices1d, bool variableIsmSizes)
+{
+    // the tiles keep the atlas area of the uniform layout, four small ones per large one
+    int numLarge = variableIsmSizes ? numIsms / largeIsmRatio : 0;
+    int numSmall = variableIsmSizes ? numIsms / smallIsmRatio : 0;
+    PerfCounter::setCount("ISM large tiles", numLarge);
+    PerfCounter::setCount("ISM small tiles", numSmall);
+
+    ismTileLevels->clearImage(0, GL_RED_INTEGER, GL_UNSIGNED_INT, glm::uvec4(0));
+
+    vplProcessor.vplBuffer->bindBase(GL_UNIFORM_BUFFER, 0);
+    vplReferences.bindBase(GL_SHADER_STORAGE_BUFFER, vplReferencesBinding);
+    ismRects->bindBase(GL_SHADER_STORAGE_BUFFER, ismRectsBinding);
+    ismTileLevels->bindImageTexture(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+
+    m_atlasAllocationProgram->setUniform("ismOffset", ismOffset);
+    m_atlasAllocationProgram->setUniform("numIsms", numIsms);
+    m_atlasAllocationProgram->setUniform("baseSize", totalIsmPixelSize / ismIndices1d);
+    m_atlasAllocationProgram->setUniform("numLarge", numLarge);
+    m_atlasAllocationProgram->setUniform("numSmall", numSmall);
+    m_atlasAllocationProgram->setUniform("variable", variableIsmSizes);
+    // a single work group sorts all VPLs by importance
+    m_atlasAllocationProgram->dispatchCompute(1, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+ImperfectShadowmap::Update ImperfectShadowmap::selectUpdate(const UpdateConfig& config, const LightPose& light, float invalidationDistance, int firstSampledVpl, int numSampledVpls, int updateRotation)
+{
+    auto rotation = std::max(1, std::min(updateRotation, numSampledVpls));
+    auto full = !m_updateConfigValid || !(config == m_updateConfig) || m_chunkLights.size() != static_cast<size_t>(rotation);
+    m_updateConfig = config;
+    m_updateConfigValid = true;
+
+    // the VPLs are the RSM texels the light sees, so a VPL moves by at most about the distance the light moved
+    // plus the angle it turned times the distance to the VPL, which is within zFar. Rendering the ISMs of one
+    // chunk does not refresh the others, so each kept chunk is compared with the light it was rendered from.
+    GLuint invalidatedVpls = 0;
+    if (!full)
+    {
+        auto nextChunk = m_nextChunk % rotation;
+        for (int chunk = 0; chunk < rotation; ++chunk)
+        {
+            if (chunk == nextChunk)
+                continue;
+
+            const auto& reference = m_chunkLights[chunk];
+            auto cosine = std::max(-1.0f, std::min(glm::dot(light.direction, reference.direction), 1.0f));
+            auto shift = glm::distance(light.position, reference.position) + std::acos(cosine) * config.zFar;
+            if (shift > invalidationDistance)
+                invalidatedVpls += numSampledVpls * (chunk + 1) / rotation - numSampledVpls * chunk / rotation;
+        }
+        full = invalidatedVpls > 0;
+    }
+    PerfCounter::setCount("ISM invalidated VPLs", invalidatedVpls);
+
+    Update update;
+    update.rotation = full ? 1 : rotation;
+    update.chunk = full ? 0 : m_nextChunk % update.rotation;
+    m_nextChunk = full ? 0 : update.chunk + 1;
+
+    if (full)
+        m_chunkLights.assign(rotation, light);
+    else
+        m_chunkLights[update.chunk] = light;
+
+    // rounded so the chunks cover all sampled VPLs
+    auto begin = numSampledVpls * update.chunk / update.rotation;
+    auto end = numSampledVpls * (update.chunk + 1) / update.rotation;
+    update.firstVpl = firstSampledVpl + begin;
+    update.numVpls = end - begin;
+
+    int vplCount = config.vplEndIndex - config.vplStartIndex;
+    int ismCount = (config.scaleISMs) ? vplCount : maxIsmCount;
     int ismIndices1d = int(pow(2, ceil(log2(ismCount) / 2))); // next even power of two
     int ismPixelSize = totalIsmPixelSize / ismIndices1d;
-    pullpush(ismPixelSize, zFar);
+    int numAtlasIsms = ismIndices1d * ismIndices1d;
+    if (update.rotation == 1)
+    {
+        update.firstIsm = 0;
+        update.numIsms = numAtlasIsms;
+        update.firstRow = 0;
+        update.numRows = totalIsmPixelSize;
+    }
+    else
+    {
+        // the ISM index of a VPL as in ism.geom, VPLs outside of the atlas have none
+        int ismOffset = config.scaleISMs ? config.vplStartIndex : 0;
+        int firstIsm = std::min(std::max(update.firstVpl - ismOffset, 0), numAtlasIsms);
+        int endIsm = std::min(std::max(update.firstVpl + update.numVpls - ismOffset, 0), numAtlasIsms);
+        update.firstIsm = firstIsm;
+        update.numIsms = endIsm - firstIsm;
+
+        // the ISMs are laid out row by row, see ism_utils.glsl
+        int firstIsmRow = firstIsm / ismIndices1d;
+        int endIsmRow = update.numIsms > 0 ? (endIsm - 1) / ismIndices1d + 1 : firstIsmRow;
+        update.firstRow = firstIsmRow * ismPixelSize;
+        update.numRows = (endIsmRow - firstIsmRow) * ismPixelSize;
+    }
+
+    PerfCounter::setCount("ISM updated VPLs", update.numVpls);
+    return update;
 }
 
-void ImperfectShadowmap::render(const IdDrawablesMap& drawablesMap, const VPLProcessor& vplProcessor, int vplStartIndex, int vplEndIndex, bool scaleISMs, bool pointsOnlyIntoScaledISMs, float tessLevelFactor, bool usePushPull, float zFar) const
+void ImperfectShadowmap::clearUpdatedISMs(const Update& update, int ismIndices1d, bool usePushPull)
 {
+    if (update.rotation == 1)
+    {
+        m_fbo->clearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+        m_fbo->clearBuffer(GL_COLOR, 0, glm::vec4(0.0f));
+        softrenderBuffer->clearImage(0, GL_RED_INTEGER, GL_UNSIGNED_INT, glm::uvec4(0xFFFFFFFF));
+        return;
+    }
+
+    // one rectangle per atlas row the ISMs cover, the ISMs next to them are kept
+    int ismPixelSize = totalIsmPixelSize / ismIndices1d;
+    int endIsm = update.firstIsm + update.numIsms;
+    GLuint clearValue = 0xFFFFFFFF;
+    glEnable(GL_SCISSOR_TEST);
+    for (int ism = update.firstIsm; ism < endIsm;)
+    {
+        int row = ism / ismIndices1d;
+        int column = ism % ismIndices1d;
+        int numColumns = std::min(ismIndices1d - column, endIsm - ism);
+        int x = column * ismPixelSize;
+        int y = row * ismPixelSize;
+        int width = numColumns * ismPixelSize;
+        if (usePushPull)
+        {
+            glClearTexSubImage(softrenderBuffer->id(), 0, x, y, 0, width, ismPixelSize, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &clearValue);
+        }
+        else
+        {
+            glScissor(x, y, width, ismPixelSize);
+            m_fbo->clearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+            m_fbo->clearBuffer(GL_COLOR, 0, glm::vec4(0.0f));
+        }
+        ism += numColumns;
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void ImperfectShadowmap::cullMeshlets(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, int firstVpl, int numVpls, float zFar, unsigned int lod)
+{
+    // the counters of the previous frame are done by now, the ones of the frame before are reused
+    GLuint counters[2];
+    m_meshletCounters[(m_frame + 1) % 2]->getSubData(0, sizeof(counters), counters);
+    auto numMeshlets = sceneGeometry.numMeshlets(lod);
+    auto visible = std::min(static_cast<size_t>(counters[0]), numMeshlets);
+    PerfCounter::setCount("ISM meshlets visible", visible);
+    PerfCounter::setCount("ISM meshlets culled", numMeshlets - visible);
+    PerfCounter::setCount("ISM triangles culled", counters[1]);
+
+    auto& currentCounters = m_meshletCounters[m_frame % 2];
+    GLuint zero = 0;
+    currentCounters->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    m_meshletSelection->reserve(numMeshlets);
+    if (numMeshlets == 0)
+        return;
+
+    vplProcessor.packedVplBuffer->bindBase(GL_UNIFORM_BUFFER, 0);
+    sceneGeometry.meshlets()->bindBase(GL_SHADER_STORAGE_BUFFER, meshletsBinding);
+    m_meshletSelection->commands()->bindBase(GL_SHADER_STORAGE_BUFFER, meshletCommandsBinding);
+    currentCounters->bindBase(GL_SHADER_STORAGE_BUFFER, meshletCountersBinding);
+
+    m_meshletCullingProgram->setUniform("firstMeshlet", static_cast<GLuint>(sceneGeometry.firstMeshlet(lod)));
+    m_meshletCullingProgram->setUniform("numMeshlets", static_cast<GLuint>(numMeshlets));
+    m_meshletCullingProgram->setUniform("firstVpl", firstVpl);
+    m_meshletCullingProgram->setUniform("numVpls", numVpls);
+    m_meshletCullingProgram->setUniform("zFar", zFar);
+    m_meshletCullingProgram->dispatchCompute(static_cast<GLuint>((numMeshlets + meshletCullingGroupSize - 1) / meshletCullingGroupSize), 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ImperfectShadowmap::render(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, Settings settings, const Update& update)
+{
+    // the points replace tessellating the meshes once they are loaded
+    settings.usePointCloud = settings.usePointCloud && sceneGeometry.numPoints() > 0;
+    settings.useMeshletCulling = settings.useMeshletCulling && !settings.usePointCloud;
+    // the compute path samples the triangles in place of the tessellation, only for the push-pull
+    settings.computeSplatting = settings.computeSplatting && settings.usePushPull && !settings.usePointCloud;
+    // the binned path replaces ism.comp, which only the push-pull runs after the points are written
+    settings.binnedSplatting = settings.binnedSplatting && settings.usePushPull && !settings.computeSplatting;
+
+    // every VPL that can receive points gets an equal slice of the point buffer, see ism.geom
+    resizePointBuffer(settings.pointsPerVpl);
+    auto numSlices = settings.pointsOnlyIntoScaledISMs ? settings.vplEndIndex - settings.vplStartIndex : maxIsmCount;
+    auto sliceSize = static_cast<int>(m_pointsPerVpl * maxIsmCount / numSlices);
+    evaluatePointCounts(sceneGeometry, numSlices, sliceSize, settings.tessLevelFactor, settings.autoTessLevelFactor);
+    if (settings.binnedSplatting)
+        evaluateSplatCounts();
+
+    // the VPLs of a rotated update share the whole buffer and get as many points each as in a full one, from a
+    // tessellation coarser by sqrt(rotation) per edge or from one of rotation ranges of the shuffled points
+    auto updateSliceSize = static_cast<int>(m_pointsPerVpl * maxIsmCount / update.numVpls);
+    auto updateTessLevelFactor = m_tessLevelFactor / std::sqrt(static_cast<float>(update.rotation));
+
+    if (settings.useMeshletCulling)
+    {
+        // points only go to the VPLs of this update, see ism.geom
+        AutoGLPerfCounter c("ISM meshlet culling");
+        cullMeshlets(sceneGeometry, vplProcessor, update.firstVpl, update.numVpls, settings.zFar, settings.lod);
+    }
+
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
 
@@ -200,62 +958,291 @@ void ImperfectShadowmap::render(const IdDrawablesMap& drawablesMap, const VPLPro
 
     m_fbo->bind();
 
-    m_fbo->clearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+    int vplCount = settings.vplEndIndex - settings.vplStartIndex;
+    int ismCount = (settings.scaleISMs) ? vplCount : maxIsmCount;
+    int ismIndices1d = int(pow(2, ceil(log2(ismCount) / 2))); // next even power of two
+    clearUpdatedISMs(update, ismIndices1d, settings.usePushPull);
 
-    m_fbo->clearBuffer(GL_COLOR, 0, glm::vec4(0.0f));
+    prepareSplatting(vplProcessor);
 
+    if (settings.computeSplatting)
+    {
+        AutoGLPerfCounter c("ISM compute splat");
+        sampleAndSplat(sceneGeometry, settings, updateTessLevelFactor, update);
+    }
+    else
+    {
+        renderPoints(sceneGeometry, settings, updateTessLevelFactor, update, true);
+    }
+
+    // only the push-pull paths count points, the compute path keeps none, so it drops none
+    auto& frame = m_pointFrames[m_frame % 2];
+    frame.tessLevelFactor = m_tessLevelFactor;
+    frame.numSlices = settings.usePushPull ? update.numVpls : 0;
+    frame.sliceSize = settings.computeSplatting ? std::numeric_limits<int>::max() : updateSliceSize;
+    frame.tessellated = !settings.usePointCloud;
+    frame.updateRotation = update.rotation;
+    gl::glMemoryBarrier(gl::GL_BUFFER_UPDATE_BARRIER_BIT);
+    m_atomicCounter->copySubData(m_pointCounters[m_frame % 2], 0, 0, sizeof(gl::GLuint) * maxIsmCount);
+    m_binCounted[m_frame % 2] = settings.binnedSplatting;
+    if (settings.binnedSplatting)
+        m_binCounters->copySubData(m_binCounterReadback[m_frame % 2], 0, 0, sizeof(BinCounters));
+
+    ++m_frame;
+
+
+}
+
+void ImperfectShadowmap::prepareSplatting(const VPLProcessor& vplProcessor)
+{
     vplProcessor.packedVplBuffer->bindBase(GL_UNIFORM_BUFFER, 0);
+    ismRects->bindBase(GL_SHADER_STORAGE_BUFFER, ismRectsBinding);
     gl::GLuint zero = 0;
     m_atomicCounter->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
     m_atomicCounter->bindBase(GL_SHADER_STORAGE_BUFFER, 0);
 
-    softrenderBuffer->clearImage(0, GL_RED_INTEGER, GL_UNSIGNED_INT, glm::uvec4(0xFFFFFFFF));
     softrenderBuffer->bindImageTexture(0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
     pointBuffer->bindImageTexture(1, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+}
 
-    m_shadowmapProgram->setUniform("viewport", glm::ivec2(totalIsmPixelSize, totalIsmPixelSize));
-    m_shadowmapProgram->setUniform("zFar", zFar);
-    m_shadowmapProgram->setUniform("vplStartIndex", vplStartIndex);
-    m_shadowmapProgram->setUniform("vplEndIndex", vplEndIndex);
-    m_shadowmapProgram->setUniform("scaleISMs", scaleISMs);
-    m_shadowmapProgram->setUniform("pointsOnlyIntoScaledISMs", pointsOnlyIntoScaledISMs);
-    m_shadowmapProgram->setUniform("usePushPull", usePushPull);
-    m_shadowmapProgram->setUniform("tessLevelFactor", tessLevelFactor);
+void ImperfectShadowmap::renderPoints(const SceneGeometry& sceneGeometry, const Settings& settings, float tessLevelFactor, const Update& update, bool timed)
+{
+    auto firstSampledVpl = settings.pointsOnlyIntoScaledISMs ? settings.vplStartIndex : 0;
+    auto firstPoint = sceneGeometry.numPoints() * update.chunk / update.rotation;
+    auto endPoint = sceneGeometry.numPoints() * (update.chunk + 1) / update.rotation;
+
+    auto program = settings.usePointCloud ? m_pointShadowmapProgram : m_shadowmapProgram;
+    program->setUniform("viewport", glm::ivec2(totalIsmPixelSize, totalIsmPixelSize));
+    program->setUniform("zFar", settings.zFar);
+    program->setUniform("vplStartIndex", settings.vplStartIndex);
+    program->setUniform("vplEndIndex", settings.vplEndIndex);
+    program->setUniform("scaleISMs", settings.scaleISMs);
+    program->setUniform("pointsOnlyIntoScaledISMs", settings.pointsOnlyIntoScaledISMs);
+    program->setUniform("usePushPull", settings.usePushPull);
+    program->setUniform("updateOffset", update.firstVpl - firstSampledVpl);
+    program->setUniform("updateCount", update.numVpls);
+    if (settings.usePointCloud)
+    {
+        program->setUniform("pointRadius", sceneGeometry.pointRadius());
+    }
+    else
+    {
+        program->setUniform("tessLevelFactor", tessLevelFactor);
+        program->setUniform("updateRotation", update.rotation);
+    }
 
-    m_shadowmapProgram->use();
+    program->use();
 
     glEnable(GL_PROGRAM_POINT_SIZE);
     glPatchParameteri(GL_PATCH_VERTICES, 3);
 
     {
-        AutoGLPerfCounter c("ISM render");
-        for (const auto& pair : drawablesMap)
+        if (timed)
+            PerfCounter::beginGL("ISM render");
+        if (settings.usePointCloud)
+        {
+            // with push-pull the points only go into the point buffer
+            if (settings.usePushPull)
+                glEnable(GL_RASTERIZER_DISCARD);
+            sceneGeometry.drawPoints(firstPoint, endPoint - firstPoint);
+            if (settings.usePushPull)
+                glDisable(GL_RASTERIZER_DISCARD);
+        }
+        else if (settings.useMeshletCulling)
         {
-            auto& drawables = pair.second;
-            for (auto& drawable : drawables)
-            {
-                drawable->draw(GL_PATCHES);
-            }
+            sceneGeometry.drawMeshlets(*m_meshletSelection, settings.lod, GL_PATCHES);
         }
+        else
+        {
+            sceneGeometry.drawAll(GL_PATCHES, settings.lod);
+        }
+        if (timed)
+            PerfCounter::endGL("ISM render");
     }
 
-    m_shadowmapProgram->release();
+    program->release();
 
-    if (usePushPull) {
-        AutoGLPerfCounter c("ISM CS");
+    if (settings.usePushPull) {
+        if (timed)
+            PerfCounter::beginGL("ISM CS");
         gl::glMemoryBarrier(gl::GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
         gl::glMemoryBarrier(gl::GL_SHADER_STORAGE_BARRIER_BIT);
 
+        if (settings.binnedSplatting)
+        {
+            splatBinned(settings, update);
+            if (timed)
+                PerfCounter::endGL("ISM CS");
+            return;
+        }
+
         m_pointSoftRenderProgram->setUniform("viewport", glm::ivec2(totalIsmPixelSize, totalIsmPixelSize));
-        m_pointSoftRenderProgram->setUniform("zFar", zFar);
-        m_pointSoftRenderProgram->setUniform("vplStartIndex", vplStartIndex);
-        m_pointSoftRenderProgram->setUniform("vplEndIndex", vplEndIndex);
-        m_pointSoftRenderProgram->setUniform("scaleISMs", scaleISMs);
-        m_pointSoftRenderProgram->setUniform("pointsOnlyIntoScaledISMs", pointsOnlyIntoScaledISMs);
-        m_pointSoftRenderProgram->setUniform("usePushPull", usePushPull);
+        m_pointSoftRenderProgram->setUniform("zFar", settings.zFar);
+        m_pointSoftRenderProgram->setUniform("vplStartIndex", settings.vplStartIndex);
+        m_pointSoftRenderProgram->setUniform("vplEndIndex", settings.vplEndIndex);
+        m_pointSoftRenderProgram->setUniform("scaleISMs", settings.scaleISMs);
+        m_pointSoftRenderProgram->setUniform("pointsOnlyIntoScaledISMs", settings.pointsOnlyIntoScaledISMs);
+        m_pointSoftRenderProgram->setUniform("usePushPull", settings.usePushPull);
+        m_pointSoftRenderProgram->setUniform("updateOffset", update.firstVpl - firstSampledVpl);
+        m_pointSoftRenderProgram->setUniform("updateCount", update.numVpls);
         m_pointSoftRenderProgram->setUniform("tessLevelFactor", tessLevelFactor);
-        m_pointSoftRenderProgram->dispatchCompute(1024, 1, 1);
+        // one work group per slice
+        m_pointSoftRenderProgram->dispatchCompute(update.numVpls, 1, 1);
+        if (timed)
+            PerfCounter::endGL("ISM CS");
+    }
+}
+
+void ImperfectShadowmap::sampleAndSplat(const SceneGeometry& sceneGeometry, const Settings& settings, float tessLevelFactor, const Update& update)
+{
+    auto numMeshlets = sceneGeometry.numMeshlets(settings.lod);
+    if (numMeshlets == 0)
+        return;
+
+    auto firstSampledVpl = settings.pointsOnlyIntoScaledISMs ? settings.vplStartIndex : 0;
+
+    sceneGeometry.meshlets()->bindBase(GL_SHADER_STORAGE_BUFFER, meshletsBinding);
+    sceneGeometry.vertices()->bindBase(GL_SHADER_STORAGE_BUFFER, sampleVerticesBinding);
+    sceneGeometry.indices()->bindBase(GL_SHADER_STORAGE_BUFFER, sampleIndicesBinding);
+    if (sceneGeometry.compactVertices())
+        sceneGeometry.meshBounds()->bindBase(GL_SHADER_STORAGE_BUFFER, sampleMeshBoundsBinding);
+    // the meshlets culled for this update's VPLs, see cullMeshlets
+    if (settings.useMeshletCulling)
+        m_meshletSelection->commands()->bindBase(GL_SHADER_STORAGE_BUFFER, sampleCommandsBinding);
+
+    m_sampleProgram->setUniform("zFar", settings.zFar);
+    m_sampleProgram->setUniform("firstMeshlet", static_cast<GLuint>(sceneGeometry.firstMeshlet(settings.lod)));
+    m_sampleProgram->setUniform("numMeshlets", static_cast<GLuint>(numMeshlets));
+    m_sampleProgram->setUniform("culled", settings.useMeshletCulling);
+    m_sampleProgram->setUniform("tessLevelFactor", tessLevelFactor);
+    m_sampleProgram->setUniform("vplStartIndex", settings.vplStartIndex);
+    m_sampleProgram->setUniform("vplEndIndex", settings.vplEndIndex);
+    m_sampleProgram->setUniform("scaleISMs", settings.scaleISMs);
+    m_sampleProgram->setUniform("pointsOnlyIntoScaledISMs", settings.pointsOnlyIntoScaledISMs);
+    m_sampleProgram->setUniform("updateOffset", update.firstVpl - firstSampledVpl);
+    m_sampleProgram->setUniform("updateCount", update.numVpls);
+    m_sampleProgram->setUniform("updateRotation", update.rotation);
+    // one work group per meshlet, the groups take turns beyond the dispatch limit
+    m_sampleProgram->dispatchCompute(static_cast<GLuint>(std::min(numMeshlets, maxSampleGroups)), 1, 1);
+}
+
+void ImperfectShadowmap::resizeSplatBuffer()
+{
+    if (!m_splats)
+    {
+        m_sliceOffsets = new globjects::Buffer();
+        m_sliceOffsets->setName("ISM Bin Slice Offsets");
+        m_sliceOffsets->setData(sizeof(GLuint) * (maxIsmCount + 1), nullptr, GL_DYNAMIC_COPY);
+        MemoryRegistry::registerBuffer("ISM", m_sliceOffsets, sizeof(GLuint) * (maxIsmCount + 1));
+
+        m_tileCounts = new globjects::Buffer();
+        m_tileCounts->setName("ISM Bin Tile Counts");
+        m_tileCounts->setData(sizeof(GLuint) * numBinTiles, nullptr, GL_DYNAMIC_COPY);
+        MemoryRegistry::registerBuffer("ISM", m_tileCounts, sizeof(GLuint) * numBinTiles);
+
+        m_tileOffsets = new globjects::Buffer();
+        m_tileOffsets->setName("ISM Bin Tile Offsets");
+        m_tileOffsets->setData(sizeof(GLuint) * numBinTiles, nullptr, GL_DYNAMIC_COPY);
+        MemoryRegistry::registerBuffer("ISM", m_tileOffsets, sizeof(GLuint) * numBinTiles);
+
+        m_binCounters = new globjects::Buffer();
+        m_binCounters->setName("ISM Bin Counters");
+        m_binCounters->setData(sizeof(BinCounters), nullptr, GL_DYNAMIC_COPY);
+        MemoryRegistry::registerBuffer("ISM", m_binCounters, sizeof(BinCounters));
+
+        for (auto& counters : m_binCounterReadback)
+        {
+            counters = new globjects::Buffer();
+            counters->setName("ISM Bin Counter Readback");
+            counters->setData(sizeof(BinCounters), nullptr, GL_STREAM_READ);
+            MemoryRegistry::registerBuffer("ISM", counters, sizeof(BinCounters));
+        }
+
+        m_splats = new globjects::Buffer();
+        m_splats->setName("ISM Binned Splats");
+        m_chunks = new globjects::Buffer();
+        m_chunks->setName("ISM Bin Chunks");
     }
 
+    // only grows, the splats of a frame that outgrew it are dropped and the next frame has room for them
+    auto capacity = std::max(m_splatCapacity, minBinSplats);
+    while (capacity < maxBinSplats && capacity < m_binnedSplats + m_binnedSplats / 4)
+        capacity *= 2;
+    capacity = std::min(capacity, maxBinSplats);
+    if (capacity == m_splatCapacity)
+        return;
+
+    // every tile may end in a partial chunk
+    m_splatCapacity = capacity;
+    auto numChunks = capacity / binChunkSize + numBinTiles;
+    m_splats->setData(static_cast<GLsizeiptr>(sizeof(glm::uvec2) * capacity), nullptr, GL_DYNAMIC_COPY);
+    m_chunks->setData(static_cast<GLsizeiptr>(sizeof(glm::uvec4) * numChunks), nullptr, GL_DYNAMIC_COPY);
+    MemoryRegistry::registerBuffer("ISM", m_splats, sizeof(glm::uvec2) * capacity);
+    MemoryRegistry::registerBuffer("ISM", m_chunks, sizeof(glm::uvec4) * numChunks);
+}
+
+void ImperfectShadowmap::evaluateSplatCounts()
+{
+    // the counters of the previous frame are done by now
+    auto previous = (m_frame + 1) % 2;
+    BinCounters counters = {};
+    if (m_binCounted[previous])
+        m_binCounterReadback[previous]->getSubData(0, sizeof(counters), &counters);
+    PerfCounter::setCount("ISM binned points", counters.numBinnedPoints);
+    PerfCounter::setCount("ISM binned splats", counters.numSplats);
+    PerfCounter::setCount("ISM binned splats dropped", counters.numSplats > m_splatCapacity ? counters.numSplats - m_splatCapacity : 0);
+    m_binnedSplats = counters.numSplats;
+}
+
+void ImperfectShadowmap::splatBinned(const Settings& settings, const Update& update)
+{
+    resizeSplatBuffer();
+
+    auto firstSampledVpl = settings.pointsOnlyIntoScaledISMs ? settings.vplStartIndex : 0;
+    auto sliceSize = static_cast<GLuint>(m_pointsPerVpl * maxIsmCount / update.numVpls);
+
+    // the point counters are bound at 0, softrenderBuffer and the point buffer at images 0 and 1
+    m_sliceOffsets->bindBase(GL_SHADER_STORAGE_BUFFER, sliceOffsetsBinding);
+    m_tileCounts->bindBase(GL_SHADER_STORAGE_BUFFER, tileCountsBinding);
+    m_tileOffsets->bindBase(GL_SHADER_STORAGE_BUFFER, tileOffsetsBinding);
+    m_splats->bindBase(GL_SHADER_STORAGE_BUFFER, splatsBinding);
+    m_chunks->bindBase(GL_SHADER_STORAGE_BUFFER, chunksBinding);
+    m_binCounters->bindBase(GL_SHADER_STORAGE_BUFFER, binCountersBinding);
+    m_binCounters->bind(GL_DISPATCH_INDIRECT_BUFFER);
+
+    GLuint zero = 0;
+    m_tileCounts->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    // the kept points of all slices one after the other, in work groups of equal size
+    m_binSlicesProgram->setUniform("numSlices", update.numVpls);
+    m_binSlicesProgram->setUniform("sliceSize", sliceSize);
+    m_binSlicesProgram->dispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // counted, given their ranges per tile and then written into them
+    for (auto program : { m_binCountProgram.get(), m_binScatterProgram.get() })
+    {
+        program->setUniform("zFar", settings.zFar);
+        program->setUniform("vplStartIndex", settings.vplStartIndex);
+        program->setUniform("vplEndIndex", settings.vplEndIndex);
+        program->setUniform("pointsOnlyIntoScaledISMs", settings.pointsOnlyIntoScaledISMs);
+        program->setUniform("updateOffset", update.firstVpl - firstSampledVpl);
+        program->setUniform("updateCount", update.numVpls);
+    }
+
+    dispatchComputeIndirect(m_binCountProgram, offsetof(BinCounters, pointGroups));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    m_binTilesProgram->setUniform("splatCapacity", m_splatCapacity);
+    m_binTilesProgram->dispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    m_binScatterProgram->setUniform("splatCapacity", m_splatCapacity);
+    dispatchComputeIndirect(m_binScatterProgram, offsetof(BinCounters, pointGroups));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // one work group per chunk of a tile's splats, the groups take turns beyond the dispatch limit
+    dispatchComputeIndirect(m_binResolveProgram, offsetof(BinCounters, chunkGroups));
 
+    globjects::Buffer::unbind(GL_DISPATCH_INDIRECT_BUFFER);
 }
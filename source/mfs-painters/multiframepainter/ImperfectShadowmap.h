@@ -1,6 +1,10 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <glm/fwd.hpp>
+#include <glm/vec3.hpp>
 
 #include <globjects/base/ref_ptr.h>
 
@@ -8,6 +12,7 @@
 
 namespace globjects
 {
+    class Buffer;
     class Program;
     class Framebuffer;
     class Texture;
@@ -19,55 +24,226 @@ namespace gloperate
 }
 
 class VPLProcessor;
+class DrawSelection;
+class SceneGeometry;
 
 
 class ImperfectShadowmap
 {
 public:
-    ImperfectShadowmap();
+    // what GIStage fills from its properties every frame
+    struct Settings
+    {
+        int vplStartIndex;
+        int vplEndIndex;
+        bool scaleISMs;
+        bool pointsOnlyIntoScaledISMs;
+        float tessLevelFactor;
+        bool autoTessLevelFactor; // picks the factor from pointsPerVpl instead
+        bool usePushPull;
+        bool fusedPullPush;
+        bool checkCompactPullPush;
+        float zFar;
+        unsigned int lod;
+        bool useMeshletCulling;
+        bool usePointCloud;
+        unsigned int pointsPerVpl;
+        int updateRotation;
+        glm::vec3 lightPosition; // the light the VPLs are generated from
+        glm::vec3 lightDirection;
+        float invalidationDistance;
+        bool variableIsmSizes;
+        bool computeSplatting;
+        bool checkSplatting;
+        bool binnedSplatting;
+    };
+
+    ImperfectShadowmap(bool compactVertices);
     ~ImperfectShadowmap();
 
-    void process(
-        const IdDrawablesMap& drawablesMap,
-        const VPLProcessor& vplProcessor,
-        int vplStartIndex,
-        int vplEndIndex,
-        bool scaleISMs,
-        bool pointsOnlyIntoScaledISMs,
-        float tessLevelFactor,
-        bool usePushPull,
-        float zFar) const;
+    void process(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, const globjects::Buffer& vplReferences, const Settings& settings);
 
     globjects::ref_ptr<globjects::Texture> depthBuffer;
     globjects::ref_ptr<globjects::Texture> softrenderBuffer;
-    globjects::ref_ptr<globjects::Texture> pullBuffer;
-    globjects::ref_ptr<globjects::Texture> pushBuffer;
+    // levels 1 to 6 of the pull-push, pushed in place, as mip levels 0 to 5
+    globjects::ref_ptr<globjects::Texture> pullPushPyramid;
     globjects::ref_ptr<globjects::Texture> pointBuffer;
     globjects::ref_ptr<globjects::Texture> pushPullResultBuffer;
+    // the ISM tile of each VPL, see ism_utils.glsl, and the log2 of the tile size per 32 pixel cell of the atlas
+    globjects::ref_ptr<globjects::Buffer> ismRects;
+    globjects::ref_ptr<globjects::Texture> ismTileLevels;
+
+    // the factor the last frame tessellated with, chosen from the point budget if autoTessLevelFactor is set
+    float usedTessLevelFactor() const;
 
 protected:
-    void render(
-        const IdDrawablesMap& drawablesMap,
-        const VPLProcessor& vplProcessor,
-        int vplStartIndex,
-        int vplEndIndex,
-        bool scaleISMs,
-        bool pointsOnlyIntoScaledISMs,
-        float tessLevelFactor,
-        bool usePushPull,
-        float zFar) const;
-    void pullpush(int ismPixelSize, float zFar) const;
+    // what a frame's point counters are read back with
+    struct PointFrame
+    {
+        float tessLevelFactor;
+        int numSlices;
+        int sliceSize;
+        bool tessellated;
+        int updateRotation;
+    };
+
+    // the VPLs whose ISMs a frame renders, the others keep what an earlier frame rendered
+    struct Update
+    {
+        int firstVpl;
+        int numVpls;
+        int rotation; // one if all ISMs are rendered
+        int chunk;
+        // their ISMs and the atlas rows in pixels that hold them
+        int firstIsm;
+        int numIsms;
+        int firstRow;
+        int numRows;
+    };
+
+    // what the kept ISMs were rendered with, they are all rendered again when any of it changes
+    struct UpdateConfig
+    {
+        int vplStartIndex;
+        int vplEndIndex;
+        bool scaleISMs;
+        bool pointsOnlyIntoScaledISMs;
+        bool usePushPull;
+        bool usePointCloud;
+        float zFar;
+        unsigned int lod;
+        int updateRotation;
+        size_t numPoints;
+        float surfaceArea;
+        bool variableIsmSizes;
+        bool computeSplatting;
+
+        bool operator==(const UpdateConfig& other) const;
+    };
+
+    // the light an ISM chunk was rendered from, the VPLs are derived from it
+    struct LightPose
+    {
+        glm::vec3 position;
+        glm::vec3 direction; // normalized
+    };
+
+    void resizePointBuffer(unsigned int pointsPerVpl);
+    // assigns the VPLs from ismOffset to ismOffset + numIsms their ISM tiles, of equal size row by row or, with
+    // variableIsmSizes, larger ones for the brighter VPLs referenced by more clusters and smaller ones for the others
+    void allocateAtlas(const VPLProcessor& vplProcessor, const globjects::Buffer& vplReferences, int ismOffset, int numIsms, int ismIndices1d, bool variableIsmSizes);
+    // reports the point counts of the previous frame and adapts the tessellation factor to them
+    void evaluatePointCounts(const SceneGeometry& sceneGeometry, int numSlices, int sliceSize, float tessLevelFactor, bool autoTessLevelFactor);
+    // writes a command per meshlet of lod into m_meshletSelection that draws it if any VPL the pass assigns points to
+    // may see one of its triangles, i.e. if it is in front of the VPL, within zFar and its normal cone faces the VPL
+    void cullMeshlets(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, int firstVpl, int numVpls, float zFar, unsigned int lod);
+    // picks the part of the sampled VPLs whose ISMs this frame renders, all of them if the configuration changed
+    // or the light moved so far since a kept chunk was rendered that its VPLs may have moved more than invalidationDistance
+    Update selectUpdate(const UpdateConfig& config, const LightPose& light, float invalidationDistance, int firstSampledVpl, int numSampledVpls, int updateRotation);
+    // resets the ISMs of update's VPLs, the whole atlas for a full update
+    void clearUpdatedISMs(const Update& update, int ismIndices1d, bool usePushPull);
+    // drops the options that do not apply to the scene or the other options from settings before rendering
+    void render(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, Settings settings, const Update& update);
+    // binds the VPLs, ISM rects, point counters, softrenderBuffer and the point buffer and resets the counters
+    void prepareSplatting(const VPLProcessor& vplProcessor);
+    // draws the point cloud or the tessellated meshes, into the ISMs or, with push-pull, into the point buffer that
+    // ism.comp or, with binnedSplatting, splatBinned then splats into softrenderBuffer
+    void renderPoints(const SceneGeometry& sceneGeometry, const Settings& settings, float tessLevelFactor, const Update& update, bool timed);
+    // splats the points of the point buffer slices like ism.comp, but in work groups of equal numbers of points: the
+    // splats are sorted into square tiles of the atlas by prefix sums over the slices and tiles, and one work group per
+    // chunk of a tile's splats keeps the nearest per texel in shared memory before writing the texel once
+    void splatBinned(const Settings& settings, const Update& update);
+    // allocates the buffers of splatBinned on first use and grows the splat buffer to what the previous frame binned
+    void resizeSplatBuffer();
+    // reports the binned points and splats of the previous frame and how many splats did not fit, and keeps the
+    // splat count for resizeSplatBuffer
+    void evaluateSplatCounts();
+    // samples the triangles of lod's meshlets in a single compute pass and splats the samples into softrenderBuffer right away
+    void sampleAndSplat(const SceneGeometry& sceneGeometry, const Settings& settings, float tessLevelFactor, const Update& update);
+    // only the rows from firstRow to firstRow + numRows are updated, pull-push never crosses ISM borders.
+    // The reference pull-push keeps the pyramid in full precision and writes m_referenceResult
+    void pullpush(float zFar, int firstRow, int numRows, bool reference) const;
+    // the same in four dispatches that pull or push three levels each, keeping the levels in between in shared memory
+    void pullpushFused(float zFar, int firstRow, int numRows) const;
+    // runs the reference pull-push on the updated rows and counts the texels of pushPullResultBuffer that differ
+    // from it, read back a frame later
+    void checkCompactPullPush(float zFar, int firstRow, int numRows);
+    // splats the updated ISMs again with the path not chosen by computeSplatting, pulls and pushes them with the reference
+    // and counts the texels of pushPullResultBuffer that differ, read back a frame later
+    void checkSplatting(const SceneGeometry& sceneGeometry, const VPLProcessor& vplProcessor, const Settings& settings, int ismIndices1d, const Update& update);
+    void allocateReferencePullPush();
+    // of pushPullResultBuffer and m_referenceResult in the given rows
+    void countDifferences(globjects::Buffer* counters, int firstRow, int numRows);
 
     int m_blurSize;
 
     globjects::ref_ptr<globjects::Framebuffer> m_fbo;
 
     globjects::ref_ptr<globjects::Program> m_shadowmapProgram;
+    globjects::ref_ptr<globjects::Program> m_pointShadowmapProgram;
     globjects::ref_ptr<globjects::Program> m_pullProgram;
     globjects::ref_ptr<globjects::Program> m_pullLevelZeroProgram;
     globjects::ref_ptr<globjects::Program> m_pushProgram;
     globjects::ref_ptr<globjects::Program> m_pushLevelZeroProgram;
+    globjects::ref_ptr<globjects::Program> m_pullFusedProgram;
+    globjects::ref_ptr<globjects::Program> m_pullFusedLevelZeroProgram;
+    globjects::ref_ptr<globjects::Program> m_pushFusedProgram;
+    globjects::ref_ptr<globjects::Program> m_pushFusedLevelZeroProgram;
+    globjects::ref_ptr<globjects::Program> m_pullReferenceProgram;
+    globjects::ref_ptr<globjects::Program> m_pullReferenceLevelZeroProgram;
+    globjects::ref_ptr<globjects::Program> m_pushReferenceProgram;
+    globjects::ref_ptr<globjects::Program> m_pushReferenceLevelZeroProgram;
+    globjects::ref_ptr<globjects::Program> m_differenceProgram;
     globjects::ref_ptr<globjects::Program> m_pointSoftRenderProgram;
+    globjects::ref_ptr<globjects::Program> m_sampleProgram;
+    globjects::ref_ptr<globjects::Program> m_binSlicesProgram;
+    globjects::ref_ptr<globjects::Program> m_binCountProgram;
+    globjects::ref_ptr<globjects::Program> m_binTilesProgram;
+    globjects::ref_ptr<globjects::Program> m_binScatterProgram;
+    globjects::ref_ptr<globjects::Program> m_binResolveProgram;
+    globjects::ref_ptr<globjects::Program> m_meshletCullingProgram;
+    globjects::ref_ptr<globjects::Program> m_atlasAllocationProgram;
     globjects::ref_ptr<globjects::Buffer> m_atomicCounter;
     globjects::ref_ptr<globjects::Texture> m_atomicCounterTexture;
+    globjects::ref_ptr<globjects::Buffer> m_pointBufferStorage;
+    unsigned int m_pointsPerVpl;
+    // per VPL slice counts of the point buffer, read back a frame later
+    globjects::ref_ptr<globjects::Buffer> m_pointCounters[2];
+    PointFrame m_pointFrames[2];
+    float m_tessLevelFactor;
+    float m_autoSurfaceArea; // the area the automatic factor was estimated for
+
+    std::unique_ptr<DrawSelection> m_meshletSelection;
+    // visible meshlets and culled triangles, read back a frame later
+    globjects::ref_ptr<globjects::Buffer> m_meshletCounters[2];
+    unsigned int m_frame; // selects the current counters
+
+    // per chunk of the rotation, the light its ISMs were last rendered from
+    std::vector<LightPose> m_chunkLights;
+    UpdateConfig m_updateConfig;
+    bool m_updateConfigValid;
+    int m_nextChunk;
+
+    // allocated once the compact pull-push or the splatting is checked
+    globjects::ref_ptr<globjects::Texture> m_referencePyramid;
+    globjects::ref_ptr<globjects::Texture> m_referenceResult;
+    // differing texels and the largest difference, read back a frame later
+    globjects::ref_ptr<globjects::Buffer> m_differenceCounters[2];
+    bool m_differenceCounted[2];
+    // the same for the splatting paths
+    globjects::ref_ptr<globjects::Buffer> m_splatDifferenceCounters[2];
+    bool m_splatDifferenceCounted[2];
+
+    // allocated once the splats are binned, see splatBinned
+    globjects::ref_ptr<globjects::Buffer> m_sliceOffsets;
+    globjects::ref_ptr<globjects::Buffer> m_tileCounts;
+    globjects::ref_ptr<globjects::Buffer> m_tileOffsets;
+    globjects::ref_ptr<globjects::Buffer> m_splats;
+    globjects::ref_ptr<globjects::Buffer> m_chunks;
+    // the indirect dispatches and the binned points and splats, the latter read back a frame later
+    globjects::ref_ptr<globjects::Buffer> m_binCounters;
+    globjects::ref_ptr<globjects::Buffer> m_binCounterReadback[2];
+    bool m_binCounted[2];
+    unsigned int m_splatCapacity;
+    unsigned int m_binnedSplats; // by the previous frame, including the dropped ones
 };
@@ -0,0 +1,386 @@
+#include "IndexOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+    // resolution of the software rasterizer estimating overdraw
+    const int overdrawGridSize = 128;
+
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t numVertices)
+        : m_timestamps(numVertices, 0)
+        , m_time(IndexOptimizer::cacheSize + 1)
+        {}
+
+        // returns true on a miss
+        bool access(unsigned int vertex)
+        {
+            if (m_time - m_timestamps[vertex] <= IndexOptimizer::cacheSize)
+                return false;
+            m_timestamps[vertex] = m_time++;
+            return true;
+        }
+
+        void flush()
+        {
+            m_time += IndexOptimizer::cacheSize + 1;
+        }
+
+    protected:
+        std::vector<unsigned int> m_timestamps;
+        unsigned int m_time;
+    };
+
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+    };
+
+    Adjacency buildAdjacency(const unsigned int* indices, size_t numIndices, size_t numVertices)
+    {
+        Adjacency adjacency;
+        adjacency.offsets.assign(numVertices + 1, 0);
+        for (size_t i = 0; i < numIndices; ++i)
+            adjacency.offsets[indices[i] + 1]++;
+        std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+        auto fill = adjacency.offsets;
+        adjacency.triangles.resize(numIndices);
+        for (size_t i = 0; i < numIndices; ++i)
+            adjacency.triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+        return adjacency;
+    }
+
+    // renders the triangles in order with a depth test, counting fragments that pass it
+    void rasterize(const unsigned int* indices, size_t numIndices, const glm::vec3* vertices, int axis, bool flip,
+        const glm::vec3& boundsMin, const glm::vec3& boundsExtent, size_t& shaded, size_t& covered)
+    {
+        auto u = (axis + 1) % 3;
+        auto v = (axis + 2) % 3;
+        auto extent = std::max(boundsExtent[u], boundsExtent[v]);
+        if (extent <= 0.0f)
+            return;
+
+        auto scale = (overdrawGridSize - 1) / extent;
+        std::vector<float> depth(overdrawGridSize * overdrawGridSize, std::numeric_limits<float>::max());
+
+        auto project = [&](unsigned int index)
+        {
+            const auto& p = vertices[index];
+            auto z = (p[axis] - boundsMin[axis]) * (flip ? -1.0f : 1.0f);
+            return glm::vec3((p[u] - boundsMin[u]) * scale, (p[v] - boundsMin[v]) * scale, z);
+        };
+
+        for (size_t t = 0; t + 2 < numIndices; t += 3)
+        {
+            auto a = project(indices[t]);
+            auto b = project(indices[t + 1]);
+            auto c = project(indices[t + 2]);
+
+            // back faces are culled like in the g-buffer pass; looking along +axis, front faces
+            // (counter clockwise in world space) are clockwise on the grid
+            auto signedArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (flip ? signedArea <= 0.0f : signedArea >= 0.0f)
+                continue;
+
+            auto minX = std::max(0, static_cast<int>(std::floor(std::min(std::min(a.x, b.x), c.x))));
+            auto maxX = std::min(overdrawGridSize - 1, static_cast<int>(std::ceil(std::max(std::max(a.x, b.x), c.x))));
+            auto minY = std::max(0, static_cast<int>(std::floor(std::min(std::min(a.y, b.y), c.y))));
+            auto maxY = std::min(overdrawGridSize - 1, static_cast<int>(std::ceil(std::max(std::max(a.y, b.y), c.y))));
+
+            for (int y = minY; y <= maxY; ++y)
+            {
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    auto px = x + 0.5f;
+                    auto py = y + 0.5f;
+                    auto w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / signedArea;
+                    auto w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / signedArea;
+                    auto w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+
+                    auto z = w0 * a.z + w1 * b.z + w2 * c.z;
+                    auto& stored = depth[y * overdrawGridSize + x];
+                    if (z < stored)
+                    {
+                        if (stored == std::numeric_limits<float>::max())
+                            covered++;
+                        stored = z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace IndexOptimizer
+{
+
+void optimizeVertexCache(unsigned int* indices, size_t numIndices, size_t numVertices, std::vector<size_t>& hardBoundaries)
+{
+    hardBoundaries.clear();
+    auto numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return;
+
+    auto adjacency = buildAdjacency(indices, numTriangles * 3, numVertices);
+
+    std::vector<unsigned int> liveTriangles(numVertices);
+    for (size_t v = 0; v < numVertices; ++v)
+        liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    std::vector<unsigned int> timestamps(numVertices, 0);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(numTriangles * 3);
+
+    unsigned int time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // the first vertex that still has triangles left
+    auto nextLiveVertex = [&]() -> long long
+    {
+        while (cursor < numVertices && liveTriangles[cursor] == 0)
+            ++cursor;
+        return cursor < numVertices ? static_cast<long long>(cursor) : -1;
+    };
+
+    long long fanningVertex = nextLiveVertex();
+    hardBoundaries.push_back(0);
+
+    while (fanningVertex >= 0)
+    {
+        candidates.clear();
+
+        auto begin = adjacency.offsets[fanningVertex];
+        auto end = adjacency.offsets[fanningVertex + 1];
+        for (auto i = begin; i < end; ++i)
+        {
+            auto triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                auto vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (time - timestamps[vertex] > cacheSize)
+                    timestamps[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // prefer the candidate that stays in the cache the longest while its remaining fan is emitted
+        long long next = -1;
+        long long bestPriority = -1;
+        for (auto vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+
+            long long priority = 0;
+            if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - timestamps[vertex];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        if (next < 0)
+        {
+            while (!deadEnd.empty() && next < 0)
+            {
+                auto vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[vertex] > 0)
+                    next = vertex;
+            }
+        }
+
+        if (next < 0)
+        {
+            // nothing recent is left, the next cluster starts cold
+            next = nextLiveVertex();
+            if (next >= 0)
+                hardBoundaries.push_back(result.size() / 3);
+        }
+
+        fanningVertex = next;
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t numIndices, const glm::vec3* vertices, const std::vector<size_t>& hardBoundaries, float threshold)
+{
+    auto numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return;
+
+    size_t numVertices = 0;
+    for (size_t i = 0; i < numTriangles * 3; ++i)
+        numVertices = std::max(numVertices, static_cast<size_t>(indices[i]) + 1);
+
+    // soft boundaries split the hard clusters wherever the cache has warmed up enough
+    FifoCache meshCache(numVertices);
+    size_t meshMisses = 0;
+    for (size_t i = 0; i < numTriangles * 3; ++i)
+        meshMisses += meshCache.access(indices[i]);
+    auto meshAcmr = static_cast<float>(meshMisses) / numTriangles;
+
+    std::vector<size_t> clusters;
+    FifoCache cache(numVertices);
+    for (size_t b = 0; b < hardBoundaries.size(); ++b)
+    {
+        auto clusterEnd = b + 1 < hardBoundaries.size() ? hardBoundaries[b + 1] : numTriangles;
+        auto start = hardBoundaries[b];
+        cache.flush();
+        size_t misses = 0;
+        clusters.push_back(start);
+
+        for (auto t = start; t < clusterEnd; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+                misses += cache.access(indices[t * 3 + k]);
+
+            auto clusterTriangles = t + 1 - clusters.back();
+            if (t + 1 < clusterEnd && static_cast<float>(misses) / clusterTriangles <= threshold * meshAcmr)
+            {
+                clusters.push_back(t + 1);
+                misses = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    // area weighted centroid and normal of the mesh and of every cluster
+    struct Cluster
+    {
+        size_t begin;
+        size_t end;
+        float sortKey;
+    };
+
+    auto triangleData = [&](size_t t, glm::vec3& centroid, glm::vec3& normal)
+    {
+        const auto& a = vertices[indices[t * 3]];
+        const auto& b = vertices[indices[t * 3 + 1]];
+        const auto& c = vertices[indices[t * 3 + 2]];
+        normal = glm::cross(b - a, c - a); // length is twice the area
+        centroid = (a + b + c) / 3.0f;
+    };
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < numTriangles; ++t)
+    {
+        glm::vec3 centroid, normal;
+        triangleData(t, centroid, normal);
+        auto area = glm::length(normal);
+        meshCentroid += centroid * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<Cluster> sorted;
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        Cluster cluster;
+        cluster.begin = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+
+        glm::vec3 clusterCentroid(0.0f);
+        glm::vec3 clusterNormal(0.0f);
+        float clusterArea = 0.0f;
+        for (auto t = cluster.begin; t < cluster.end; ++t)
+        {
+            glm::vec3 centroid, normal;
+            triangleData(t, centroid, normal);
+            auto area = glm::length(normal);
+            clusterCentroid += centroid * area;
+            clusterNormal += normal;
+            clusterArea += area;
+        }
+        if (clusterArea > 0.0f)
+            clusterCentroid /= clusterArea;
+
+        // clusters far out along their own normal occlude the rest of the mesh from most directions
+        auto normalLength = glm::length(clusterNormal);
+        cluster.sortKey = normalLength > 0.0f ? glm::dot(clusterCentroid - meshCentroid, clusterNormal / normalLength) : 0.0f;
+        sorted.push_back(cluster);
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(numTriangles * 3);
+    for (const auto& cluster : sorted)
+        result.insert(result.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+Statistics analyze(const unsigned int* indices, size_t numIndices, const glm::vec3* vertices, size_t numVertices)
+{
+    Statistics statistics = { 0.0f, 0.0f, 0.0f };
+    auto numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return statistics;
+
+    FifoCache cache(numVertices);
+    std::vector<bool> referenced(numVertices, false);
+    size_t misses = 0;
+    size_t numReferenced = 0;
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+
+    for (size_t i = 0; i < numTriangles * 3; ++i)
+    {
+        auto vertex = indices[i];
+        misses += cache.access(vertex);
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            numReferenced++;
+            boundsMin = glm::min(boundsMin, vertices[vertex]);
+            boundsMax = glm::max(boundsMax, vertices[vertex]);
+        }
+    }
+
+    statistics.acmr = static_cast<float>(misses) / numTriangles;
+    statistics.atvr = static_cast<float>(misses) / numReferenced;
+
+    size_t shaded = 0;
+    size_t covered = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (auto flip : { false, true })
+            rasterize(indices, numTriangles * 3, vertices, axis, flip, boundsMin, boundsMax - boundsMin, shaded, covered);
+    }
+    statistics.overdraw = covered > 0 ? static_cast<float>(shaded) / covered : 1.0f;
+
+    return statistics;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+
+// Triangle reordering for the post-transform vertex cache and for overdraw,
+// after Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Tipsify).
+namespace IndexOptimizer
+{
+    // size of the simulated FIFO cache, the ordering is not very sensitive to the exact value
+    const unsigned int cacheSize = 16;
+
+    struct Statistics
+    {
+        float acmr;     // cache misses per triangle
+        float atvr;     // cache misses per referenced vertex, 1 is optimal
+        float overdraw; // shaded fragments per covered pixel, averaged over the six axis directions
+    };
+
+    // reorders the triangles in place, hardBoundaries receives the first triangle of every
+    // cluster that starts with an empty cache
+    void optimizeVertexCache(unsigned int* indices, size_t numIndices, size_t numVertices, std::vector<size_t>& hardBoundaries);
+
+    // sorts clusters of the vertex cache order so that outward facing clusters come first,
+    // threshold trades vertex cache efficiency (1.0) for finer clusters (above 1.0)
+    void optimizeOverdraw(unsigned int* indices, size_t numIndices, const glm::vec3* vertices, const std::vector<size_t>& hardBoundaries, float threshold = 1.05f);
+
+    Statistics analyze(const unsigned int* indices, size_t numIndices, const glm::vec3* vertices, size_t numVertices);
+}
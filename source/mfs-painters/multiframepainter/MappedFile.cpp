@@ -0,0 +1,137 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+MappedFile::MappedFile()
+: m_data(nullptr)
+, m_size(0)
+#ifdef _WIN32
+, m_fileHandle(INVALID_HANDLE_VALUE)
+, m_mappingHandle(nullptr)
+#else
+, m_fileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    m_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mappingHandle)
+    {
+        close();
+        return false;
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mappingHandle = nullptr;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    m_fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (m_fileDescriptor < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    m_data = static_cast<const char*>(mapping);
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        munmap(const_cast<char*>(m_data), m_size);
+    if (m_fileDescriptor >= 0)
+        ::close(m_fileDescriptor);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_fileDescriptor = -1;
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+const char* MappedFile::data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
@@ -1,5 +1,9 @@
 #include "Material.h"
 
+MaterialDescription::MaterialDescription()
+: specularFactor(0.0f)
+{}
+
 Material::Material()
 : specularFactor(0.0f)
 {}
@@ -18,3 +22,8 @@ bool Material::hasTexture(TextureType type) const
 {
     return m_textureMap.count(type) > 0;
 }
+
+void Material::releaseTexture(TextureType type)
+{
+    m_textureMap.erase(type);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <string>
 
 #include <glm/vec3.hpp>
 
@@ -16,6 +17,8 @@ enum class TextureType
     Opacity
 };
 
+const unsigned int numTextureTypes = 5;
+
 enum class BumpType
 {
     None,
@@ -23,6 +26,15 @@ enum class BumpType
     Normal
 };
 
+// what a material consists of before any of its textures are loaded
+struct MaterialDescription
+{
+    MaterialDescription();
+
+    float specularFactor;
+    std::map<TextureType, std::string> texturePaths;
+};
+
 class Material
 {
 public:
@@ -35,6 +47,7 @@ public:
     const TextureMap& textureMap() const;
     void addTexture(TextureType type, globjects::ref_ptr<globjects::Texture> texture);
     bool hasTexture(TextureType type) const;
+    void releaseTexture(TextureType type); // once MaterialTable copied it into one of its texture arrays
 
 protected:
     TextureMap m_textureMap;
@@ -0,0 +1,323 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/extension.h>
+#include <glbinding/gl/functions.h>
+
+#include <globjects/globjects.h>
+#include <globjects/Buffer.h>
+#include <globjects/Texture.h>
+
+#include "MemoryRegistry.h"
+#include "SceneGeometry.h"
+
+using namespace gl;
+
+namespace
+{
+    // std430 layout of MaterialEntry in model.frag
+    struct MaterialEntry
+    {
+        GLuint textures[numTextureTypes][2]; // bindless handle as low and high word, or the array layer and 0
+        float shininess;
+        GLuint textureFlags; // one bit per TextureType
+    };
+
+    static_assert(sizeof(MaterialEntry) == 48, "material entries are expected to match the std430 layout");
+
+    // a material's position in the draw order
+    struct OrderedMaterial
+    {
+        unsigned int materialIndex;
+        bool cullFace;
+        int arrays[numTextureTypes];
+    };
+
+    bool sameDrawGroup(const OrderedMaterial& a, const OrderedMaterial& b)
+    {
+        return a.cullFace == b.cullFace && std::equal(a.arrays, a.arrays + numTextureTypes, b.arrays);
+    }
+}
+
+bool MaterialTable::bindlessSupported()
+{
+    return globjects::hasExtension(GLextension::GL_ARB_bindless_texture);
+}
+
+MaterialTable::MaterialTable(bool bindless)
+: m_bindless(bindless)
+, m_maxAnisotropy(1.0f)
+, m_maxLayers(0)
+, m_bufferSize(0)
+{
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_maxAnisotropy);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxLayers);
+
+    m_buffer = new globjects::Buffer();
+    m_buffer->setName("Material Table");
+}
+
+MaterialTable::~MaterialTable()
+{
+    for (const auto& pair : m_textures)
+    {
+        if (pair.second.handle != 0)
+            glMakeTextureHandleNonResidentARB(pair.second.handle);
+    }
+
+    for (const auto& array : m_arrays)
+        MemoryRegistry::unregister(array.texture.get());
+    MemoryRegistry::unregister(m_buffer.get());
+}
+
+bool MaterialTable::bindless() const
+{
+    return m_bindless;
+}
+
+void MaterialTable::update(IdMaterialMap& materials, SceneGeometry& geometry)
+{
+    std::vector<MaterialEntry> entries;
+    std::vector<OrderedMaterial> order;
+    for (auto& pair : materials)
+    {
+        auto materialIndex = pair.first;
+        auto& material = pair.second;
+
+        MaterialEntry entry = {};
+        entry.shininess = material.specularFactor;
+
+        OrderedMaterial ordered;
+        ordered.materialIndex = materialIndex;
+        for (unsigned int t = 0; t < numTextureTypes; ++t)
+        {
+            ordered.arrays[t] = -1;
+
+            // textures copied by an earlier update are only known by their layer
+            auto layer = m_layers.find({ materialIndex, t });
+            auto it = material.textureMap().find(static_cast<TextureType>(t));
+            if (layer == m_layers.end() && (it == material.textureMap().end() || !it->second))
+                continue;
+
+            const auto& texture = layer != m_layers.end() ? layer->second : reference(it->second.get());
+
+            // a texture that could not be copied stays with the material, the next update tries again
+            if (!m_bindless && layer == m_layers.end() && texture.array >= 0)
+            {
+                m_layers[{ materialIndex, t }] = texture;
+                material.releaseTexture(static_cast<TextureType>(t));
+            }
+
+            if (m_bindless)
+            {
+                entry.textures[t][0] = static_cast<GLuint>(texture.handle);
+                entry.textures[t][1] = static_cast<GLuint>(texture.handle >> 32);
+            }
+            else if (texture.array >= 0)
+            {
+                entry.textures[t][0] = texture.layer;
+                ordered.arrays[t] = texture.array;
+            }
+            else
+            {
+                continue;
+            }
+
+            entry.textureFlags |= 1u << t;
+        }
+        ordered.cullFace = (entry.textureFlags & (1u << static_cast<unsigned int>(TextureType::Opacity))) == 0;
+
+        if (entries.size() <= materialIndex)
+            entries.resize(materialIndex + 1, MaterialEntry());
+        entries[materialIndex] = entry;
+        order.push_back(ordered);
+    }
+
+    // the released textures are gone, their addresses may be reused by the next ones
+    if (!m_bindless)
+        m_textures.clear();
+
+    // culled materials first, then grouped by the arrays they sample from (all -1 with bindless textures)
+    auto key = [](const OrderedMaterial& m) {
+        return std::make_tuple(!m.cullFace,
+            m.arrays[static_cast<unsigned int>(TextureType::Diffuse)],
+            m.arrays[static_cast<unsigned int>(TextureType::Bump)],
+            m.arrays[static_cast<unsigned int>(TextureType::Specular)],
+            m.arrays[static_cast<unsigned int>(TextureType::Emissive)],
+            m.arrays[static_cast<unsigned int>(TextureType::Opacity)],
+            m.materialIndex);
+    };
+    std::sort(order.begin(), order.end(), [&key](const OrderedMaterial& a, const OrderedMaterial& b) {
+        return key(a) < key(b);
+    });
+
+    std::vector<unsigned int> materialOrder;
+    materialOrder.reserve(order.size());
+    for (const auto& m : order)
+        materialOrder.push_back(m.materialIndex);
+    geometry.setMaterialOrder(materialOrder);
+    geometry.updateCommands();
+
+    // materials without meshes are left out, so every group starts and ends with a command range
+    m_drawGroups.clear();
+    const OrderedMaterial* previous = nullptr;
+    for (const auto& m : order)
+    {
+        if (!geometry.hasMaterial(m.materialIndex))
+            continue;
+
+        if (previous && sameDrawGroup(*previous, m))
+        {
+            m_drawGroups.back().lastMaterial = m.materialIndex;
+        }
+        else
+        {
+            DrawGroup group;
+            group.cullFace = m.cullFace;
+            for (unsigned int t = 0; t < numTextureTypes; ++t)
+                group.arrays[t] = m.arrays[t] >= 0 ? m_arrays[m.arrays[t]].texture.get() : nullptr;
+            group.firstMaterial = m.materialIndex;
+            group.lastMaterial = m.materialIndex;
+            m_drawGroups.push_back(group);
+        }
+        previous = &m;
+    }
+
+    if (!entries.empty())
+    {
+        m_buffer->setData(entries, GL_STATIC_DRAW);
+        m_bufferSize = entries.size() * sizeof(MaterialEntry);
+        MemoryRegistry::registerBuffer("Material Table", m_buffer, m_bufferSize);
+    }
+}
+
+globjects::Buffer* MaterialTable::buffer() const
+{
+    return m_buffer;
+}
+
+const std::vector<MaterialTable::DrawGroup>& MaterialTable::drawGroups() const
+{
+    return m_drawGroups;
+}
+
+size_t MaterialTable::memoryUsage() const
+{
+    auto size = m_bufferSize;
+    for (const auto& array : m_arrays)
+        size += MemoryRegistry::textureSize(array.internalFormat, array.width, array.height, 1, array.levels) * array.capacity;
+    return size;
+}
+
+const MaterialTable::TextureReference& MaterialTable::reference(globjects::Texture* texture)
+{
+    auto it = m_textures.find(texture);
+    if (it != m_textures.end())
+        return it->second;
+
+    TextureReference reference;
+    reference.handle = 0;
+    reference.array = -1;
+    reference.layer = 0;
+
+    // the handle freezes the texture's state, textures are complete by the time a material receives them
+    if (m_bindless)
+    {
+        reference.texture = texture;
+        reference.handle = glGetTextureHandleARB(texture->id());
+        glMakeTextureHandleResidentARB(reference.handle);
+    }
+    else
+    {
+        reference.array = addToArray(texture, reference.layer);
+    }
+
+    return m_textures[texture] = reference;
+}
+
+int MaterialTable::addToArray(globjects::Texture* texture, unsigned int& layer)
+{
+    auto width = texture->getLevelParameter(0, GL_TEXTURE_WIDTH);
+    auto height = texture->getLevelParameter(0, GL_TEXTURE_HEIGHT);
+    auto internalFormat = static_cast<GLenum>(texture->getLevelParameter(0, GL_TEXTURE_INTERNAL_FORMAT));
+    if (width <= 0 || height <= 0)
+        return -1;
+
+    // immutable textures were allocated with their level count, the others end at GL_TEXTURE_MAX_LEVEL or the full chain
+    auto fullChain = 1 + static_cast<int>(std::log2(std::max(width, height)));
+    auto levels = texture->getParameter(GL_TEXTURE_IMMUTABLE_FORMAT) != 0
+        ? texture->getParameter(GL_TEXTURE_IMMUTABLE_LEVELS)
+        : std::min(texture->getParameter(GL_TEXTURE_MAX_LEVEL) + 1, fullChain);
+    auto grayscale = texture->getParameter(GL_TEXTURE_SWIZZLE_G) == static_cast<GLint>(GL_RED);
+
+    auto key = ArrayKey(internalFormat, width, height, levels, grayscale);
+    auto open = m_openArrays.find(key);
+    if (open == m_openArrays.end() || m_arrays[open->second].numLayers == static_cast<unsigned int>(m_maxLayers))
+    {
+        TextureArray array;
+        array.internalFormat = internalFormat;
+        array.width = width;
+        array.height = height;
+        array.levels = levels;
+        array.grayscale = grayscale;
+        array.numLayers = 0;
+        array.capacity = 0;
+        m_arrays.push_back(array);
+        open = m_openArrays.insert({ key, 0 }).first;
+        open->second = static_cast<int>(m_arrays.size() - 1);
+    }
+
+    auto& array = m_arrays[open->second];
+    if (array.numLayers == array.capacity)
+        growArray(array, std::min(std::max(4u, 2 * array.capacity), static_cast<unsigned int>(m_maxLayers)));
+
+    layer = array.numLayers++;
+    for (int level = 0; level < levels; ++level)
+    {
+        glCopyImageSubData(texture->id(), GL_TEXTURE_2D, level, 0, 0, 0,
+            array.texture->id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(layer),
+            std::max(1, width >> level), std::max(1, height >> level), 1);
+    }
+
+    return open->second;
+}
+
+void MaterialTable::growArray(TextureArray& array, unsigned int capacity)
+{
+    globjects::ref_ptr<globjects::Texture> grown = new globjects::Texture(GL_TEXTURE_2D_ARRAY);
+    grown->storage3D(array.levels, array.internalFormat, array.width, array.height, static_cast<GLsizei>(capacity));
+    grown->setName("Texture Array " + std::to_string(array.width) + "x" + std::to_string(array.height));
+
+    // same sampling as ModelLoadingStage::setTextureParameters, swizzling is part of the texture state
+    grown->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    grown->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    grown->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    grown->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    grown->setParameter(GL_TEXTURE_MAX_ANISOTROPY_EXT, m_maxAnisotropy);
+    if (array.grayscale)
+    {
+        grown->setParameter(GL_TEXTURE_SWIZZLE_G, GL_RED);
+        grown->setParameter(GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    if (array.texture && array.numLayers > 0)
+    {
+        for (int level = 0; level < array.levels; ++level)
+        {
+            glCopyImageSubData(array.texture->id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                grown->id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                std::max(1, array.width >> level), std::max(1, array.height >> level), static_cast<GLsizei>(array.numLayers));
+        }
+    }
+
+    MemoryRegistry::unregister(array.texture.get());
+    array.texture = grown;
+    array.capacity = capacity;
+    MemoryRegistry::registerTexture("Material Table", grown, array.internalFormat,
+        MemoryRegistry::textureSize(array.internalFormat, array.width, array.height, 1, array.levels) * capacity);
+}
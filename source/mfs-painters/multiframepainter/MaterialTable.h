@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/types.h>
+
+#include <globjects/base/ref_ptr.h>
+
+#include "TypeDefinitions.h"
+
+namespace globjects
+{
+    class Buffer;
+    class Texture;
+}
+
+class SceneGeometry;
+
+
+// Everything the model shaders need to know about the materials of one scene, in one shader storage buffer
+// indexed by the per mesh material index. Every entry holds the shininess, one flag bit per TextureType and a
+// reference per texture, which is either
+//  - a bindless texture handle (ARB_bindless_texture), or
+//  - a layer of a texture array. Textures of the same size, format and mip count share an array. Once copied, the
+//    materials release their textures and the table remembers the layer per material, so only the arrays stay in memory.
+//    Textures that cannot be copied (no level 0 yet) are kept by their materials and retried by the next update.
+//
+// Materials are ordered so that all materials that can be drawn together are adjacent, and SceneGeometry keeps its
+// commands in this order. With bindless textures only face culling separates the draw groups,
+// with texture arrays also the arrays the materials sample from.
+class MaterialTable
+{
+public:
+    // materials firstMaterial to lastMaterial of the material order are drawn with one call
+    struct DrawGroup
+    {
+        bool cullFace;
+        globjects::Texture* arrays[numTextureTypes]; // indexed by TextureType, always nullptr with bindless textures
+        unsigned int firstMaterial;
+        unsigned int lastMaterial;
+    };
+
+    static bool bindlessSupported();
+
+    MaterialTable(bool bindless);
+    ~MaterialTable();
+
+    bool bindless() const;
+
+    // adds the materials and textures that appeared since the last call, rebuilds the draw groups
+    // and updates the command order of geometry. Without bindless textures the materials' textures are released
+    // once they are copied into an array
+    void update(IdMaterialMap& materials, SceneGeometry& geometry);
+
+    globjects::Buffer* buffer() const;
+    const std::vector<DrawGroup>& drawGroups() const;
+    size_t memoryUsage() const; // bytes of the table and of the texture arrays, bindless textures are not copied
+
+protected:
+    struct TextureReference
+    {
+        globjects::ref_ptr<globjects::Texture> texture; // only kept for the bindless handle
+        gl::GLuint64 handle;
+        int array; // index into m_arrays, -1 if the texture has no array
+        unsigned int layer;
+    };
+
+    struct TextureArray
+    {
+        globjects::ref_ptr<globjects::Texture> texture;
+        gl::GLenum internalFormat;
+        int width;
+        int height;
+        int levels;
+        bool grayscale;
+        unsigned int numLayers;
+        unsigned int capacity;
+    };
+
+    // internal format, width, height, levels, grayscale
+    using ArrayKey = std::tuple<gl::GLenum, int, int, int, bool>;
+
+    const TextureReference& reference(globjects::Texture* texture);
+    int addToArray(globjects::Texture* texture, unsigned int& layer);
+    void growArray(TextureArray& array, unsigned int capacity);
+
+    bool m_bindless;
+    float m_maxAnisotropy;
+    gl::GLint m_maxLayers; // arrays that are full are followed by a new one with the same key
+
+    globjects::ref_ptr<globjects::Buffer> m_buffer;
+    size_t m_bufferSize;
+
+    std::map<globjects::Texture*, TextureReference> m_textures; // without bindless textures only during update
+    std::map<std::pair<unsigned int, unsigned int>, TextureReference> m_layers; // per material index and TextureType, only copied textures
+    std::vector<TextureArray> m_arrays;
+    std::map<ArrayKey, int> m_openArrays; // the array new textures with this key are added to
+
+    std::vector<DrawGroup> m_drawGroups;
+};
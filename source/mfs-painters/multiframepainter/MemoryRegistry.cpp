@@ -0,0 +1,191 @@
+#include "MemoryRegistry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/enum.h>
+
+#include <globjects/Buffer.h>
+#include <globjects/Texture.h>
+
+using namespace gl;
+
+namespace
+{
+    enum class Memory
+    {
+        GPU,
+        CPU
+    };
+
+    struct Allocation
+    {
+        std::string stage;
+        std::string name;
+        std::string format;
+        Memory memory;
+        size_t size;
+    };
+
+    struct FormatInfo
+    {
+        const char * name;
+        size_t bitsPerTexel; // per 4x4 block for block compressed formats
+        bool blockCompressed;
+    };
+
+    static std::unordered_map<const void *, Allocation> allocations;
+    static std::vector<std::string> orderedStages;
+
+    const FormatInfo & formatInfo(GLenum internalFormat)
+    {
+        static const std::map<GLenum, FormatInfo> formats {
+            { GL_R8,                              { "R8",              8,   false } },
+            { GL_R8UI,                            { "R8UI",            8,   false } },
+            { GL_R16,                             { "R16",             16,  false } },
+            { GL_R16UI,                           { "R16UI",           16,  false } },
+            { GL_R32UI,                           { "R32UI",           32,  false } },
+            { GL_R32F,                            { "R32F",            32,  false } },
+            { GL_RG16F,                           { "RG16F",           32,  false } },
+            { GL_RG32F,                           { "RG32F",           64,  false } },
+            { GL_RG32UI,                          { "RG32UI",          64,  false } },
+            { GL_RGB8,                            { "RGB8",            24,  false } },
+            { GL_RGB10_A2,                        { "RGB10_A2",        32,  false } },
+            { GL_R11F_G11F_B10F,                  { "R11F_G11F_B10F",  32,  false } },
+            { GL_RGB32F,                          { "RGB32F",          96,  false } },
+            { GL_RGBA8,                           { "RGBA8",           32,  false } },
+            { GL_RGBA16F,                         { "RGBA16F",         64,  false } },
+            { GL_RGBA32F,                         { "RGBA32F",         128, false } },
+            { GL_DEPTH_COMPONENT,                 { "DEPTH",           32,  false } },
+            { GL_DEPTH_COMPONENT16,               { "DEPTH16",         16,  false } },
+            { GL_DEPTH_COMPONENT24,               { "DEPTH24",         32,  false } },
+            { GL_DEPTH_COMPONENT32F,              { "DEPTH32F",        32,  false } },
+            { GL_COMPRESSED_RGB_S3TC_DXT1_EXT,    { "BC1",             64,  true } },
+            { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,   { "BC3",             128, true } },
+            { GL_COMPRESSED_RED_RGTC1,            { "BC4",             64,  true } },
+            { GL_COMPRESSED_RG_RGTC2,             { "BC5",             128, true } },
+        };
+        static const FormatInfo unknown = { "unknown format", 0, false };
+
+        auto it = formats.find(internalFormat);
+        return it != formats.end() ? it->second : unknown;
+    }
+
+    void add(const void * owner, Allocation allocation)
+    {
+        if (std::find(orderedStages.begin(), orderedStages.end(), allocation.stage) == orderedStages.end())
+            orderedStages.push_back(allocation.stage);
+
+        allocations[owner] = std::move(allocation);
+    }
+
+    std::string megabytes(size_t size)
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << size / (1024.0 * 1024.0) << " MB";
+        return ss.str();
+    }
+}
+
+void MemoryRegistry::registerTexture(const std::string & stage, const globjects::Texture * texture, GLenum internalFormat, int width, int height, int depth, int levels)
+{
+    registerTexture(stage, texture, internalFormat, textureSize(internalFormat, width, height, depth, levels));
+}
+
+void MemoryRegistry::registerTexture(const std::string & stage, const globjects::Texture * texture, GLenum internalFormat, size_t size)
+{
+    add(texture, { stage, texture->name(), formatInfo(internalFormat).name, Memory::GPU, size });
+}
+
+void MemoryRegistry::registerBuffer(const std::string & stage, const globjects::Buffer * buffer, size_t size)
+{
+    add(buffer, { stage, buffer->name(), "buffer", Memory::GPU, size });
+}
+
+void MemoryRegistry::registerCPU(const std::string & stage, const void * owner, const std::string & name, size_t size)
+{
+    add(owner, { stage, name, "CPU", Memory::CPU, size });
+}
+
+void MemoryRegistry::unregister(const void * owner)
+{
+    allocations.erase(owner);
+}
+
+size_t MemoryRegistry::textureSize(GLenum internalFormat, int width, int height, int depth, int levels)
+{
+    const auto & info = formatInfo(internalFormat);
+
+    size_t size = 0;
+    for (int level = 0; levels == 0 || level < levels; ++level)
+    {
+        if (info.blockCompressed)
+            size += static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * depth * info.bitsPerTexel / 8;
+        else
+            size += static_cast<size_t>(width) * height * depth * info.bitsPerTexel / 8;
+
+        if (width == 1 && height == 1 && depth == 1)
+            break;
+
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        depth = std::max(1, depth / 2);
+    }
+    return size;
+}
+
+std::string MemoryRegistry::generateString()
+{
+    std::map<std::string, std::pair<size_t, size_t>> totals;
+    size_t gpu = 0;
+    size_t cpu = 0;
+    for (const auto & pair : allocations)
+    {
+        auto & total = totals[pair.second.stage];
+        if (pair.second.memory == Memory::GPU)
+        {
+            total.first += pair.second.size;
+            gpu += pair.second.size;
+        }
+        else
+        {
+            total.second += pair.second.size;
+            cpu += pair.second.size;
+        }
+    }
+
+    std::stringstream ss;
+    ss << "GPU " << megabytes(gpu) << ", CPU " << megabytes(cpu) << "  ";
+    for (const auto & stage : orderedStages)
+    {
+        auto it = totals.find(stage);
+        if (it == totals.end())
+            continue;
+
+        ss << stage << ": " << megabytes(it->second.first);
+        if (it->second.second > 0)
+            ss << " (CPU " << megabytes(it->second.second) << ")";
+        ss << "  ";
+    }
+    return ss.str();
+}
+
+std::string MemoryRegistry::generateDetailedString()
+{
+    std::vector<const Allocation *> sorted;
+    for (const auto & pair : allocations)
+        sorted.push_back(&pair.second);
+
+    std::sort(sorted.begin(), sorted.end(), [](const Allocation * a, const Allocation * b) {
+        return a->size > b->size;
+    });
+
+    std::stringstream ss;
+    for (auto allocation : sorted)
+        ss << allocation->stage << " / " << allocation->name << " (" << allocation->format << "): " << megabytes(allocation->size) << std::endl;
+    return ss.str();
+}
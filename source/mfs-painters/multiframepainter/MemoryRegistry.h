@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <glbinding/gl/types.h>
+
+namespace globjects
+{
+    class Buffer;
+    class Texture;
+}
+
+
+// Bookkeeping of the GPU and CPU memory every stage holds.
+// Entries are keyed on the owning object, registering it again replaces its entry (resizes, reallocations)
+// and unregister removes it when the object goes away. Textures and buffers are listed under their globjects name.
+class MemoryRegistry
+{
+public:
+    static void registerTexture(const std::string & stage, const globjects::Texture * texture, gl::GLenum internalFormat, int width, int height, int depth = 1, int levels = 1);
+    static void registerTexture(const std::string & stage, const globjects::Texture * texture, gl::GLenum internalFormat, size_t size);
+    static void registerBuffer(const std::string & stage, const globjects::Buffer * buffer, size_t size);
+    static void registerCPU(const std::string & stage, const void * owner, const std::string & name, size_t size);
+    static void unregister(const void * owner);
+
+    // levels == 0 counts the full mip chain
+    static size_t textureSize(gl::GLenum internalFormat, int width, int height, int depth = 1, int levels = 1);
+
+    // GPU and CPU totals per stage
+    static std::string generateString();
+    // every allocation with its format and size, largest first
+    static std::string generateDetailedString();
+};
@@ -0,0 +1,276 @@
+#include "MeshBvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+#include <xmmintrin.h>
+
+#include <glm/common.hpp>
+
+#include "WorkerPool.h"
+
+namespace
+{
+    const int emptyChild = std::numeric_limits<int>::min();
+
+    // subtrees this many levels below the root (up to 16) are culled in parallel
+    const unsigned int parallelDepth = 2;
+    // smaller trees have too few subtrees at that depth to split the traversal
+    const size_t minParallelMeshes = 64;
+    // every this many culls the traversal that is currently slower is timed again
+    const unsigned int remeasureInterval = 64;
+
+    // partitions order[first, last) at the median center along the axis the centers spread the most
+    unsigned int splitMedian(std::vector<unsigned int>& order, unsigned int first, unsigned int last, const std::vector<glm::vec3>& centers)
+    {
+        auto low = glm::vec3(std::numeric_limits<float>::max());
+        auto high = glm::vec3(-std::numeric_limits<float>::max());
+        for (auto i = first; i < last; ++i)
+        {
+            low = glm::min(low, centers[order[i]]);
+            high = glm::max(high, centers[order[i]]);
+        }
+
+        auto extent = high - low;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        auto middle = first + (last - first) / 2;
+        std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last, [&centers, axis](unsigned int a, unsigned int b) {
+            return centers[a][axis] < centers[b][axis];
+        });
+        return middle;
+    }
+
+    // bit c of outside is set if child c is entirely outside one of the planes,
+    // bit c of intersecting if child c is not entirely inside all of them
+    void testChildren(const float* minX, const float* minY, const float* minZ,
+        const float* maxX, const float* maxY, const float* maxZ,
+        const glm::vec4* planes, int& outside, int& intersecting)
+    {
+        auto outsideMask = _mm_setzero_ps();
+        auto intersectingMask = _mm_setzero_ps();
+        auto zero = _mm_setzero_ps();
+
+        for (int p = 0; p < 6; ++p)
+        {
+            const auto& plane = planes[p];
+
+            // the corner farthest along the plane normal decides whether a box is outside, the nearest one whether it crosses the plane
+            auto farX = _mm_loadu_ps(plane.x >= 0.0f ? maxX : minX);
+            auto farY = _mm_loadu_ps(plane.y >= 0.0f ? maxY : minY);
+            auto farZ = _mm_loadu_ps(plane.z >= 0.0f ? maxZ : minZ);
+            auto nearX = _mm_loadu_ps(plane.x >= 0.0f ? minX : maxX);
+            auto nearY = _mm_loadu_ps(plane.y >= 0.0f ? minY : maxY);
+            auto nearZ = _mm_loadu_ps(plane.z >= 0.0f ? minZ : maxZ);
+
+            auto nx = _mm_set1_ps(plane.x);
+            auto ny = _mm_set1_ps(plane.y);
+            auto nz = _mm_set1_ps(plane.z);
+            auto d = _mm_set1_ps(plane.w);
+
+            auto farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_add_ps(_mm_mul_ps(nz, farZ), d));
+            auto nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_add_ps(_mm_mul_ps(nz, nearZ), d));
+
+            outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(farDistance, zero));
+            intersectingMask = _mm_or_ps(intersectingMask, _mm_cmplt_ps(nearDistance, zero));
+        }
+
+        outside = _mm_movemask_ps(outsideMask);
+        intersecting = _mm_movemask_ps(intersectingMask);
+    }
+}
+
+MeshBvh::MeshBvh()
+: m_serialTime(0.0)
+, m_parallelTime(0.0)
+, m_numCulls(0)
+{
+}
+
+void MeshBvh::build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+    m_nodes.clear();
+    m_meshOrder.resize(boundsMin.size());
+
+    // the traversal times of the previous tree say little about this one
+    m_serialTime = 0.0;
+    m_parallelTime = 0.0;
+    m_numCulls = 0;
+    std::iota(m_meshOrder.begin(), m_meshOrder.end(), 0u);
+
+    if (m_meshOrder.empty())
+        return;
+
+    std::vector<glm::vec3> centers(boundsMin.size());
+    for (size_t i = 0; i < centers.size(); ++i)
+        centers[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+
+    m_nodes.reserve(m_meshOrder.size() / 2 + 1);
+    buildNode(0, static_cast<unsigned int>(m_meshOrder.size()), centers, boundsMin, boundsMax);
+}
+
+size_t MeshBvh::cull(const glm::mat4& viewProjection, std::vector<std::uint8_t>& visible) const
+{
+    visible.assign(m_meshOrder.size(), 0);
+    if (m_nodes.empty())
+        return 0;
+
+    // left, right, bottom, top, near and far plane, pointing inwards (Gribb and Hartmann)
+    glm::vec4 planes[6];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int s = 0; s < 2; ++s)
+        {
+            auto sign = s == 0 ? 1.0f : -1.0f;
+            planes[2 * i + s] = glm::vec4(
+                viewProjection[0][3] + sign * viewProjection[0][i],
+                viewProjection[1][3] + sign * viewProjection[1][i],
+                viewProjection[2][3] + sign * viewProjection[2][i],
+                viewProjection[3][3] + sign * viewProjection[3][i]);
+        }
+    }
+
+    // whether waking the workers pays off depends on the machine and the view, so the serial and the parallel
+    // traversal are both timed and the faster one is used; unmeasured times are 0, so each is tried once first
+    auto& pool = WorkerPool::shared();
+    bool parallel = false;
+    if (pool.numThreads() > 1 && m_meshOrder.size() >= minParallelMeshes)
+    {
+        parallel = m_parallelTime < m_serialTime;
+        if (m_numCulls++ % remeasureInterval == 0)
+            parallel = !parallel;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (parallel)
+    {
+        std::vector<int> subtrees;
+        cullNode(0, planes, visible.data(), parallelDepth - 1, &subtrees);
+        pool.run(subtrees.size(), [&](size_t i) {
+            cullNode(subtrees[i], planes, visible.data(), 0, nullptr);
+        });
+    }
+    else
+    {
+        cullNode(0, planes, visible.data(), 0, nullptr);
+    }
+    auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto& average = parallel ? m_parallelTime : m_serialTime;
+    average = average == 0.0 ? time : 0.9 * average + 0.1 * time;
+
+    return static_cast<size_t>(std::count(visible.begin(), visible.end(), std::uint8_t(1)));
+}
+
+size_t MeshBvh::numMeshes() const
+{
+    return m_meshOrder.size();
+}
+
+size_t MeshBvh::memoryUsage() const
+{
+    return m_nodes.size() * sizeof(Node) + m_meshOrder.size() * sizeof(unsigned int);
+}
+
+int MeshBvh::buildNode(unsigned int firstMesh, unsigned int numMeshes, const std::vector<glm::vec3>& centers,
+    const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+    auto nodeIndex = static_cast<int>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    // one child per mesh for small ranges, otherwise four parts from two levels of median splits
+    unsigned int parts[5];
+    unsigned int numParts;
+    if (numMeshes <= 4)
+    {
+        numParts = numMeshes;
+        for (unsigned int i = 0; i <= numMeshes; ++i)
+            parts[i] = firstMesh + i;
+    }
+    else
+    {
+        auto last = firstMesh + numMeshes;
+        auto middle = splitMedian(m_meshOrder, firstMesh, last, centers);
+        parts[0] = firstMesh;
+        parts[1] = splitMedian(m_meshOrder, firstMesh, middle, centers);
+        parts[2] = middle;
+        parts[3] = splitMedian(m_meshOrder, middle, last, centers);
+        parts[4] = last;
+        numParts = 4;
+    }
+
+    Node node;
+    node.firstMesh = firstMesh;
+    node.numMeshes = numMeshes;
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+        auto low = glm::vec3(0.0f);
+        auto high = glm::vec3(0.0f);
+
+        if (c < numParts)
+        {
+            low = glm::vec3(std::numeric_limits<float>::max());
+            high = glm::vec3(-std::numeric_limits<float>::max());
+            for (auto i = parts[c]; i < parts[c + 1]; ++i)
+            {
+                low = glm::min(low, boundsMin[m_meshOrder[i]]);
+                high = glm::max(high, boundsMax[m_meshOrder[i]]);
+            }
+
+            auto count = parts[c + 1] - parts[c];
+            node.children[c] = count == 1 ? ~static_cast<int>(m_meshOrder[parts[c]]) : buildNode(parts[c], count, centers, boundsMin, boundsMax);
+        }
+        else
+        {
+            node.children[c] = emptyChild;
+        }
+
+        node.minX[c] = low.x;
+        node.minY[c] = low.y;
+        node.minZ[c] = low.z;
+        node.maxX[c] = high.x;
+        node.maxY[c] = high.y;
+        node.maxZ[c] = high.z;
+    }
+
+    m_nodes[nodeIndex] = node;
+    return nodeIndex;
+}
+
+void MeshBvh::cullNode(int nodeIndex, const glm::vec4* planes, std::uint8_t* visible, unsigned int deferDepth, std::vector<int>* deferred) const
+{
+    const auto& node = m_nodes[nodeIndex];
+
+    int outside, intersecting;
+    testChildren(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, planes, outside, intersecting);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        auto child = node.children[c];
+        if (child == emptyChild || (outside & (1 << c)))
+            continue;
+
+        if (child < 0)
+        {
+            visible[~child] = 1;
+            continue;
+        }
+
+        const auto& childNode = m_nodes[child];
+        if (!(intersecting & (1 << c)))
+        {
+            for (auto i = childNode.firstMesh; i < childNode.firstMesh + childNode.numMeshes; ++i)
+                visible[m_meshOrder[i]] = 1;
+        }
+        else if (deferred && deferDepth == 0)
+        {
+            deferred->push_back(child);
+        }
+        else
+        {
+            cullNode(child, planes, visible, deferDepth > 0 ? deferDepth - 1 : 0, deferred);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+
+// Bounding volume hierarchy with four children per node over the axis aligned bounds of the scene meshes,
+// used to frustum cull them on the CPU.
+// Nodes keep the bounds of their children as separate x, y and z arrays, so one SSE test checks all four children
+// against a frustum plane. Subtrees that are entirely inside the frustum are accepted without testing their meshes.
+// The traversal can also be split into subtrees that are culled on a WorkerPool, which is used whenever it measured
+// faster than the serial traversal.
+class MeshBvh
+{
+public:
+    MeshBvh();
+
+    void build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+    // visible[i] is 1 if mesh i intersects the frustum of viewProjection and 0 otherwise, returns the number of visible meshes
+    size_t cull(const glm::mat4& viewProjection, std::vector<std::uint8_t>& visible) const;
+
+    size_t numMeshes() const;
+    size_t memoryUsage() const;
+
+protected:
+    struct Node
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        int children[4]; // node index, ~mesh index for single meshes, or emptyChild
+        unsigned int firstMesh; // range of m_meshOrder below this node
+        unsigned int numMeshes;
+    };
+
+    int buildNode(unsigned int firstMesh, unsigned int numMeshes, const std::vector<glm::vec3>& centers,
+        const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+    void cullNode(int nodeIndex, const glm::vec4* planes, std::uint8_t* visible, unsigned int deferDepth, std::vector<int>* deferred) const;
+
+    std::vector<Node> m_nodes; // the root is the first node
+    std::vector<unsigned int> m_meshOrder; // mesh indices, every node covers a contiguous range
+
+    // average seconds per cull of either traversal, over the views of all stages culling with this tree
+    mutable double m_serialTime;
+    mutable double m_parallelTime;
+    mutable unsigned int m_numCulls;
+};
@@ -0,0 +1,447 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // increment whenever the file layout or the post-processing changes
+    const uint32_t cacheVersion = 4;
+    const char cacheMagic[8] = { 'M', 'F', 'S', 'M', 'E', 'S', 'H', '\0' };
+
+    enum MeshAttributes : uint32_t
+    {
+        HasNormals = 1 << 0,
+        HasTextureCoordinates = 1 << 1
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t postProcessFlags;
+        float vertexScale;
+        uint32_t numMaterials;
+        uint64_t sourceHash;
+        uint32_t numMeshes;
+        uint32_t padding;
+    };
+
+    struct MeshRecord
+    {
+        uint32_t materialIndex;
+        uint32_t numIndices;
+        uint32_t numVertices;
+        uint32_t attributes;
+        uint32_t numLods;
+        uint32_t lodFirstIndex[MeshCache::maxLods];
+        uint32_t lodNumIndices[MeshCache::maxLods];
+        float lodError[MeshCache::maxLods];
+        float statisticsBefore[3];
+        float statisticsAfter[3];
+        uint32_t padding;
+        uint64_t dataOffset;
+    };
+
+    const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+    const uint64_t fnvPrime = 1099511628211ull;
+
+    uint64_t fnv1a(const void* data, size_t size, uint64_t hash = fnvOffsetBasis)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+    size_t align(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t meshAttributes(const MeshCache::Mesh& mesh)
+    {
+        return (mesh.normals ? uint32_t(HasNormals) : 0u) | (mesh.textureCoordinates ? uint32_t(HasTextureCoordinates) : 0u);
+    }
+
+    size_t meshDataSize(uint32_t numIndices, uint32_t numVertices, uint32_t attributes)
+    {
+        size_t size = numIndices * sizeof(unsigned int) + numVertices * sizeof(glm::vec3);
+        if (attributes & HasNormals)
+            size += numVertices * sizeof(glm::vec3);
+        if (attributes & HasTextureCoordinates)
+            size += numVertices * sizeof(glm::vec3);
+        return size;
+    }
+
+    // bounds-checked sequential reads from the mapped file
+    class Reader
+    {
+    public:
+        Reader(const char* data, size_t size)
+        : m_data(data), m_size(size), m_offset(0), m_valid(true)
+        {}
+
+        template <typename T>
+        T read()
+        {
+            T value;
+            std::memset(&value, 0, sizeof(T));
+            if (!require(sizeof(T)))
+                return value;
+            std::memcpy(&value, m_data + m_offset, sizeof(T));
+            m_offset += sizeof(T);
+            return value;
+        }
+
+        std::string readString(size_t length)
+        {
+            if (!require(length))
+                return std::string();
+            std::string result(m_data + m_offset, length);
+            m_offset = align(m_offset + length, 4);
+            return result;
+        }
+
+        void seek(size_t offset) { m_offset = offset; m_valid = m_valid && offset <= m_size; }
+        size_t offset() const { return m_offset; }
+        bool valid() const { return m_valid; }
+        bool contains(size_t offset, size_t size) const { return offset <= m_size && size <= m_size - offset; }
+
+    protected:
+        bool require(size_t size)
+        {
+            m_valid = m_valid && contains(m_offset, size);
+            return m_valid;
+        }
+
+        const char* m_data;
+        size_t m_size;
+        size_t m_offset;
+        bool m_valid;
+    };
+
+    void writePadding(std::ofstream& stream, size_t& offset, size_t alignment)
+    {
+        static const char zeros[16] = {};
+        auto aligned = align(offset, alignment);
+        stream.write(zeros, aligned - offset);
+        offset = aligned;
+    }
+
+    template <typename T>
+    void write(std::ofstream& stream, size_t& offset, const T* data, size_t count)
+    {
+        stream.write(reinterpret_cast<const char*>(data), sizeof(T) * count);
+        offset += sizeof(T) * count;
+    }
+}
+
+const unsigned int MeshCache::maxLods;
+
+MeshCache::MeshCache(const std::string& sourceFilename, unsigned int postProcessFlags, float vertexScale)
+: m_sourceHash(hashSource(sourceFilename))
+, m_postProcessFlags(postProcessFlags)
+, m_vertexScale(vertexScale)
+{
+    auto key = fnv1a(&m_sourceHash, sizeof(m_sourceHash));
+    key = fnv1a(&m_postProcessFlags, sizeof(m_postProcessFlags), key);
+    key = fnv1a(&m_vertexScale, sizeof(m_vertexScale), key);
+    key = fnv1a(&cacheVersion, sizeof(cacheVersion), key);
+
+    std::stringstream ss;
+    ss << sourceFilename << "." << std::hex << std::setw(16) << std::setfill('0') << key << ".meshcache";
+    m_cacheFilename = ss.str();
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+uint64_t MeshCache::hashFile(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return 0;
+
+    return fnv1a(file.data(), file.size());
+}
+
+uint64_t MeshCache::hashSource(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return 0;
+
+    auto hash = fnv1a(file.data(), file.size());
+
+    auto extension = filename.substr(std::min(filename.size(), filename.find_last_of('.') + 1));
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension != "obj")
+        return hash;
+
+    // the libraries are relative to the .obj file, a missing one hashes as 0 so that adding it invalidates the cache
+    auto separator = filename.find_last_of("/\\");
+    auto directory = separator == std::string::npos ? std::string() : filename.substr(0, separator + 1);
+
+    const char keyword[] = "mtllib";
+    const auto keywordLength = sizeof(keyword) - 1;
+    auto data = file.data();
+    auto size = file.size();
+    for (size_t lineStart = 0; lineStart < size;)
+    {
+        auto lineEnd = lineStart;
+        while (lineEnd < size && data[lineEnd] != '\n')
+            ++lineEnd;
+
+        if (lineEnd - lineStart > keywordLength && std::memcmp(data + lineStart, keyword, keywordLength) == 0
+            && (data[lineStart + keywordLength] == ' ' || data[lineStart + keywordLength] == '\t'))
+        {
+            // the rest of the line, trimmed, names may contain spaces
+            auto first = lineStart + keywordLength;
+            auto last = lineEnd;
+            while (first < last && std::isspace(static_cast<unsigned char>(data[first])))
+                ++first;
+            while (last > first && std::isspace(static_cast<unsigned char>(data[last - 1])))
+                --last;
+
+            auto libraryHash = hashFile(directory + std::string(data + first, last - first));
+            hash = fnv1a(&libraryHash, sizeof(libraryHash), hash);
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    return hash;
+}
+
+bool MeshCache::load()
+{
+    m_materials.clear();
+    m_meshes.clear();
+
+    if (m_sourceHash == 0 || !m_file.open(m_cacheFilename))
+        return false;
+
+    Reader reader(m_file.data(), m_file.size());
+
+    auto header = reader.read<FileHeader>();
+    bool headerMatches = reader.valid()
+        && std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && header.version == cacheVersion
+        && header.postProcessFlags == m_postProcessFlags
+        && header.vertexScale == m_vertexScale
+        && header.sourceHash == m_sourceHash;
+
+    if (!headerMatches)
+    {
+        std::cout << "Ignoring outdated mesh cache " << m_cacheFilename << std::endl;
+        m_file.close();
+        return false;
+    }
+
+    m_materials.resize(header.numMaterials);
+    for (auto& material : m_materials)
+    {
+        material.specularFactor = reader.read<float>();
+        auto numTextures = reader.read<uint32_t>();
+        for (uint32_t t = 0; t < numTextures && reader.valid(); ++t)
+        {
+            auto type = static_cast<TextureType>(reader.read<uint32_t>());
+            auto length = reader.read<uint32_t>();
+            material.texturePaths[type] = reader.readString(length);
+        }
+    }
+
+    reader.seek(align(reader.offset(), 8));
+
+    m_meshes.reserve(header.numMeshes);
+    for (uint32_t m = 0; m < header.numMeshes && reader.valid(); ++m)
+    {
+        auto record = reader.read<MeshRecord>();
+
+        auto dataSize = meshDataSize(record.numIndices, record.numVertices, record.attributes);
+        bool lodsValid = record.numLods >= 1 && record.numLods <= maxLods;
+        for (uint32_t l = 0; l < record.numLods && lodsValid; ++l)
+            lodsValid = record.lodFirstIndex[l] <= record.numIndices && record.lodNumIndices[l] <= record.numIndices - record.lodFirstIndex[l];
+
+        if (!reader.contains(record.dataOffset, dataSize) || record.materialIndex >= header.numMaterials || !lodsValid)
+        {
+            reader.seek(m_file.size() + 1);
+            break;
+        }
+
+        Mesh mesh;
+        mesh.materialIndex = record.materialIndex;
+        mesh.numIndices = record.numIndices;
+        mesh.numVertices = record.numVertices;
+        mesh.numLods = record.numLods;
+        for (uint32_t l = 0; l < maxLods; ++l)
+        {
+            mesh.lodFirstIndex[l] = record.lodFirstIndex[l];
+            mesh.lodNumIndices[l] = record.lodNumIndices[l];
+            mesh.lodError[l] = record.lodError[l];
+        }
+        mesh.statisticsBefore.acmr = record.statisticsBefore[0];
+        mesh.statisticsBefore.atvr = record.statisticsBefore[1];
+        mesh.statisticsBefore.overdraw = record.statisticsBefore[2];
+        mesh.statisticsAfter.acmr = record.statisticsAfter[0];
+        mesh.statisticsAfter.atvr = record.statisticsAfter[1];
+        mesh.statisticsAfter.overdraw = record.statisticsAfter[2];
+        mesh.normals = nullptr;
+        mesh.textureCoordinates = nullptr;
+
+        auto data = m_file.data() + record.dataOffset;
+        mesh.indices = reinterpret_cast<const unsigned int*>(data);
+        data += mesh.numIndices * sizeof(unsigned int);
+        mesh.vertices = reinterpret_cast<const glm::vec3*>(data);
+        data += mesh.numVertices * sizeof(glm::vec3);
+        if (record.attributes & HasNormals)
+        {
+            mesh.normals = reinterpret_cast<const glm::vec3*>(data);
+            data += mesh.numVertices * sizeof(glm::vec3);
+        }
+        if (record.attributes & HasTextureCoordinates)
+            mesh.textureCoordinates = reinterpret_cast<const glm::vec3*>(data);
+
+        m_meshes.push_back(mesh);
+    }
+
+    if (!reader.valid())
+    {
+        std::cout << "Mesh cache " << m_cacheFilename << " is corrupt, ignoring it" << std::endl;
+        m_materials.clear();
+        m_meshes.clear();
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache::store(const std::vector<MaterialDescription>& materials, const std::vector<Mesh>& meshes) const
+{
+    if (m_sourceHash == 0)
+        return false;
+
+    // write to a temporary file first so that a crash never leaves a half-written cache behind
+    auto temporaryFilename = m_cacheFilename + ".tmp";
+    std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+    if (!stream)
+    {
+        std::cout << "Could not write mesh cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    size_t offset = 0;
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.postProcessFlags = m_postProcessFlags;
+    header.vertexScale = m_vertexScale;
+    header.numMaterials = static_cast<uint32_t>(materials.size());
+    header.sourceHash = m_sourceHash;
+    header.numMeshes = static_cast<uint32_t>(meshes.size());
+    write(stream, offset, &header, 1);
+
+    for (const auto& material : materials)
+    {
+        auto numTextures = static_cast<uint32_t>(material.texturePaths.size());
+        write(stream, offset, &material.specularFactor, 1);
+        write(stream, offset, &numTextures, 1);
+        for (const auto& pair : material.texturePaths)
+        {
+            auto type = static_cast<uint32_t>(pair.first);
+            auto length = static_cast<uint32_t>(pair.second.size());
+            write(stream, offset, &type, 1);
+            write(stream, offset, &length, 1);
+            write(stream, offset, pair.second.data(), length);
+            writePadding(stream, offset, 4);
+        }
+    }
+
+    writePadding(stream, offset, 8);
+
+    // the mesh data follows the table, each mesh aligned to 16 bytes
+    auto dataOffset = align(offset + meshes.size() * sizeof(MeshRecord), 16);
+    for (const auto& mesh : meshes)
+    {
+        MeshRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.materialIndex = mesh.materialIndex;
+        record.numIndices = mesh.numIndices;
+        record.numVertices = mesh.numVertices;
+        record.attributes = meshAttributes(mesh);
+        record.numLods = mesh.numLods;
+        for (uint32_t l = 0; l < mesh.numLods; ++l)
+        {
+            record.lodFirstIndex[l] = mesh.lodFirstIndex[l];
+            record.lodNumIndices[l] = mesh.lodNumIndices[l];
+            record.lodError[l] = mesh.lodError[l];
+        }
+        record.statisticsBefore[0] = mesh.statisticsBefore.acmr;
+        record.statisticsBefore[1] = mesh.statisticsBefore.atvr;
+        record.statisticsBefore[2] = mesh.statisticsBefore.overdraw;
+        record.statisticsAfter[0] = mesh.statisticsAfter.acmr;
+        record.statisticsAfter[1] = mesh.statisticsAfter.atvr;
+        record.statisticsAfter[2] = mesh.statisticsAfter.overdraw;
+        record.dataOffset = dataOffset;
+        write(stream, offset, &record, 1);
+
+        dataOffset = align(dataOffset + meshDataSize(record.numIndices, record.numVertices, record.attributes), 16);
+    }
+
+    for (const auto& mesh : meshes)
+    {
+        writePadding(stream, offset, 16);
+        write(stream, offset, mesh.indices, mesh.numIndices);
+        write(stream, offset, mesh.vertices, mesh.numVertices);
+        if (mesh.normals)
+            write(stream, offset, mesh.normals, mesh.numVertices);
+        if (mesh.textureCoordinates)
+            write(stream, offset, mesh.textureCoordinates, mesh.numVertices);
+    }
+
+    stream.close();
+    if (!stream)
+    {
+        std::remove(temporaryFilename.c_str());
+        std::cout << "Could not write mesh cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    std::remove(m_cacheFilename.c_str());
+    if (std::rename(temporaryFilename.c_str(), m_cacheFilename.c_str()) != 0)
+    {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const std::string& MeshCache::cacheFilename() const
+{
+    return m_cacheFilename;
+}
+
+const std::vector<MaterialDescription>& MeshCache::materials() const
+{
+    return m_materials;
+}
+
+const std::vector<MeshCache::Mesh>& MeshCache::meshes() const
+{
+    return m_meshes;
+}
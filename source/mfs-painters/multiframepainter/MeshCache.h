@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "IndexOptimizer.h"
+#include "Material.h"
+#include "MappedFile.h"
+
+
+// On-disk cache of the post-processed scene geometry and material descriptions.
+// The cache file is keyed on the source file contents (including the material libraries of .obj files), the
+// post-process flags and the vertex scale,
+// and is memory mapped on load so that the mesh data can be uploaded without any copies.
+class MeshCache
+{
+public:
+    static const unsigned int maxLods = 4;
+
+    // points into the mapped file (or into caller memory when storing)
+    struct Mesh
+    {
+        unsigned int materialIndex;
+        unsigned int numIndices; // all levels of detail
+        unsigned int numVertices;
+        unsigned int numLods;    // level 0 is the full resolution mesh, coarser levels reuse its vertices
+        unsigned int lodFirstIndex[maxLods];
+        unsigned int lodNumIndices[maxLods];
+        float lodError[maxLods]; // geometric deviation in object space
+        IndexOptimizer::Statistics statisticsBefore; // of the full resolution level, before and after reordering
+        IndexOptimizer::Statistics statisticsAfter;
+        const unsigned int* indices;
+        const glm::vec3* vertices;
+        const glm::vec3* normals;            // nullptr if the mesh has no normals
+        const glm::vec3* textureCoordinates; // nullptr if the mesh has no texture coordinates
+    };
+
+    MeshCache(const std::string& sourceFilename, unsigned int postProcessFlags, float vertexScale);
+    ~MeshCache();
+
+    bool load();
+    bool store(const std::vector<MaterialDescription>& materials, const std::vector<Mesh>& meshes) const;
+
+    const std::string& cacheFilename() const;
+    const std::vector<MaterialDescription>& materials() const;
+    const std::vector<Mesh>& meshes() const;
+
+    static uint64_t hashFile(const std::string& filename);
+    // hashFile of the source and, for .obj files, of every material library it references with mtllib
+    static uint64_t hashSource(const std::string& filename);
+
+protected:
+    uint64_t m_sourceHash;
+    unsigned int m_postProcessFlags;
+    float m_vertexScale;
+    std::string m_cacheFilename;
+
+    MappedFile m_file;
+    std::vector<MaterialDescription> m_materials;
+    std::vector<Mesh> m_meshes;
+};
@@ -0,0 +1,251 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+    // symmetric 4x4 matrix of the plane equations a vertex should stay close to
+    struct Quadric
+    {
+        double a00, a01, a02, a03;
+        double a11, a12, a13;
+        double a22, a23;
+        double a33;
+        double weight; // number of planes summed up
+
+        Quadric()
+        : a00(0.0), a01(0.0), a02(0.0), a03(0.0)
+        , a11(0.0), a12(0.0), a13(0.0)
+        , a22(0.0), a23(0.0)
+        , a33(0.0)
+        , weight(0.0)
+        {}
+
+        Quadric(const glm::vec3& n, float d)
+        : a00(n.x * n.x), a01(n.x * n.y), a02(n.x * n.z), a03(n.x * d)
+        , a11(n.y * n.y), a12(n.y * n.z), a13(n.y * d)
+        , a22(n.z * n.z), a23(n.z * d)
+        , a33(d * d)
+        , weight(1.0)
+        {}
+
+        Quadric& operator+=(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+            return *this;
+        }
+
+        // mean squared distance of p to the planes
+        double evaluate(const glm::vec3& p) const
+        {
+            if (weight == 0.0)
+                return 0.0;
+
+            double x = p.x, y = p.y, z = p.z;
+            return (a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                + a22 * z * z + 2.0 * a23 * z
+                + a33) / weight;
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    // moving from onto to must not flip any of the remaining triangles around from
+    bool flipsTriangle(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& triangles,
+        const glm::vec3* vertices, unsigned int from, unsigned int to)
+    {
+        for (auto triangle : triangles)
+        {
+            auto i0 = indices[triangle * 3 + 0];
+            auto i1 = indices[triangle * 3 + 1];
+            auto i2 = indices[triangle * 3 + 2];
+
+            // triangles containing the edge disappear
+            if (i0 == to || i1 == to || i2 == to)
+                continue;
+
+            auto before = glm::cross(vertices[i1] - vertices[i0], vertices[i2] - vertices[i0]);
+            auto p0 = i0 == from ? vertices[to] : vertices[i0];
+            auto p1 = i1 == from ? vertices[to] : vertices[i1];
+            auto p2 = i2 == from ? vertices[to] : vertices[i2];
+            auto after = glm::cross(p1 - p0, p2 - p0);
+
+            if (glm::dot(before, after) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+}
+
+namespace MeshSimplifier
+{
+
+std::vector<unsigned int> simplify(const unsigned int* sourceIndices, size_t numIndices, const glm::vec3* vertices, size_t numVertices, size_t targetIndexCount, float& error)
+{
+    std::vector<unsigned int> indices(sourceIndices, sourceIndices + numIndices);
+    error = 0.0f;
+
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const auto& p0 = vertices[indices[t]];
+        auto normal = glm::cross(vertices[indices[t + 1]] - p0, vertices[indices[t + 2]] - p0);
+        auto length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+
+        normal /= length;
+        Quadric quadric(normal, -glm::dot(normal, p0));
+        for (int k = 0; k < 3; ++k)
+            quadrics[indices[t + k]] += quadric;
+    }
+
+    // an edge used by a single triangle is a border (or a seam), its vertices stay where they are
+    std::vector<bool> locked(numVertices, false);
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+                edges.push_back(edgeKey(indices[t + k], indices[t + (k + 1) % 3]));
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); )
+        {
+            auto j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                ++j;
+            if (j - i == 1)
+            {
+                locked[edges[i] >> 32] = true;
+                locked[edges[i] & 0xFFFFFFFF] = true;
+            }
+            i = j;
+        }
+    }
+
+    std::vector<unsigned int> remap(numVertices);
+    std::vector<bool> touched(numVertices);
+    std::vector<std::vector<unsigned int>> vertexTriangles(numVertices);
+    double maxCost = 0.0;
+
+    while (indices.size() > targetIndexCount)
+    {
+        for (auto& triangles : vertexTriangles)
+            triangles.clear();
+        for (size_t t = 0; t < indices.size() / 3; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+                vertexTriangles[indices[t * 3 + k]].push_back(static_cast<unsigned int>(t));
+        }
+
+        std::vector<Collapse> collapses;
+        std::unordered_set<uint64_t> visited;
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                auto a = indices[t + k];
+                auto b = indices[t + (k + 1) % 3];
+                if ((locked[a] && locked[b]) || !visited.insert(edgeKey(a, b)).second)
+                    continue;
+
+                auto quadric = quadrics[a];
+                quadric += quadrics[b];
+
+                // collapse in the cheaper direction that moves an unlocked vertex
+                Collapse collapse;
+                auto costAB = locked[a] ? -1.0 : quadric.evaluate(vertices[b]);
+                auto costBA = locked[b] ? -1.0 : quadric.evaluate(vertices[a]);
+                if (costBA < 0.0 || (costAB >= 0.0 && costAB <= costBA))
+                    collapse = { a, b, std::max(costAB, 0.0) };
+                else
+                    collapse = { b, a, std::max(costBA, 0.0) };
+                collapses.push_back(collapse);
+            }
+        }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (size_t v = 0; v < numVertices; ++v)
+            remap[v] = static_cast<unsigned int>(v);
+        std::fill(touched.begin(), touched.end(), false);
+
+        // every collapse removes about two triangles, leave some room for collapses that fail the flip test
+        auto trianglesToRemove = (indices.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        for (const auto& collapse : collapses)
+        {
+            if (removed >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            if (flipsTriangle(indices, vertexTriangles[collapse.from], vertices, collapse.from, collapse.to))
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxCost = std::max(maxCost, collapse.cost);
+
+            // neighbours of both vertices changed, they wait for the next pass
+            for (auto vertex : { collapse.from, collapse.to })
+            {
+                for (auto triangle : vertexTriangles[vertex])
+                {
+                    for (int k = 0; k < 3; ++k)
+                        touched[indices[triangle * 3 + k]] = true;
+                }
+            }
+            removed += 2;
+        }
+
+        std::vector<unsigned int> collapsed;
+        collapsed.reserve(indices.size());
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            auto i0 = remap[indices[t]];
+            auto i1 = remap[indices[t + 1]];
+            auto i2 = remap[indices[t + 2]];
+            if (i0 == i1 || i1 == i2 || i0 == i2)
+                continue;
+            collapsed.push_back(i0);
+            collapsed.push_back(i1);
+            collapsed.push_back(i2);
+        }
+
+        if (collapsed.size() == indices.size())
+            break;
+        indices.swap(collapsed);
+    }
+
+    // root mean square distance of the worst collapse
+    error = static_cast<float>(std::sqrt(maxCost));
+
+    return indices;
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+
+// Quadric error metric edge-collapse simplification.
+// Vertices are collapsed onto one of their neighbours, so the simplified index list refers to the
+// unchanged vertex array and levels of detail can share one vertex buffer. Border vertices (which
+// includes vertices on uv and normal seams, as these are split in the index space) are never moved.
+namespace MeshSimplifier
+{
+    // returns at most targetIndexCount indices (or as few as possible without touching borders),
+    // error receives the largest geometric deviation in object space units
+    std::vector<unsigned int> simplify(
+        const unsigned int* indices,
+        size_t numIndices,
+        const glm::vec3* vertices,
+        size_t numVertices,
+        size_t targetIndexCount,
+        float& error);
+}
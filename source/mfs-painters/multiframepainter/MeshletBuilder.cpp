@@ -0,0 +1,134 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+    // octahedral 16 bit normals deviate by less than this from the original direction
+    const float normalTolerance = 0.001f;
+
+    void computeBounds(MeshletBuilder::Meshlet& meshlet, const std::vector<unsigned int>& vertices, const MeshCache::Mesh& mesh, float positionTolerance)
+    {
+        auto low = glm::vec3(std::numeric_limits<float>::max());
+        auto high = glm::vec3(-std::numeric_limits<float>::max());
+        for (auto v : vertices)
+        {
+            low = glm::min(low, mesh.vertices[v]);
+            high = glm::max(high, mesh.vertices[v]);
+        }
+
+        meshlet.center = (low + high) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (auto v : vertices)
+            meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, mesh.vertices[v]));
+        meshlet.radius += positionTolerance;
+
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = -1.0f;
+        if (!mesh.normals)
+            return;
+
+        auto sum = glm::vec3(0.0f);
+        for (auto v : vertices)
+        {
+            auto length = glm::length(mesh.normals[v]);
+            if (length == 0.0f)
+                return;
+            sum += mesh.normals[v] / length;
+        }
+
+        auto sumLength = glm::length(sum);
+        if (sumLength == 0.0f)
+            return;
+
+        meshlet.coneAxis = sum / sumLength;
+        meshlet.coneCutoff = 1.0f;
+        for (auto v : vertices)
+            meshlet.coneCutoff = std::min(meshlet.coneCutoff, glm::dot(meshlet.coneAxis, glm::normalize(mesh.normals[v])));
+        meshlet.coneCutoff -= normalTolerance;
+    }
+}
+
+namespace MeshletBuilder
+{
+
+std::vector<Meshlet> build(const MeshCache::Mesh& mesh)
+{
+    std::vector<Meshlet> meshlets;
+    if (mesh.numVertices == 0)
+        return meshlets;
+
+    // half a quantization step of the compact format along every axis
+    auto low = glm::vec3(std::numeric_limits<float>::max());
+    auto high = glm::vec3(-std::numeric_limits<float>::max());
+    for (unsigned int i = 0; i < mesh.numVertices; ++i)
+    {
+        low = glm::min(low, mesh.vertices[i]);
+        high = glm::max(high, mesh.vertices[i]);
+    }
+    auto positionTolerance = glm::length(high - low) / 65535.0f;
+
+    // last meshlet that used a vertex, to count unique vertices without clearing
+    std::vector<size_t> lastMeshlet(mesh.numVertices, std::numeric_limits<size_t>::max());
+    std::vector<unsigned int> vertices;
+    vertices.reserve(maxVertices);
+
+    for (unsigned int lod = 0; lod < mesh.numLods; ++lod)
+    {
+        const auto* indices = mesh.indices + mesh.lodFirstIndex[lod];
+        auto numIndices = mesh.lodNumIndices[lod];
+
+        Meshlet meshlet;
+        meshlet.lod = lod;
+        meshlet.firstIndex = 0;
+        meshlet.numIndices = 0;
+        vertices.clear();
+
+        for (unsigned int t = 0; t < numIndices; t += 3)
+        {
+            auto newVertices = 0u;
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                // a vertex can repeat within a degenerate triangle
+                auto v = indices[t + i];
+                if (lastMeshlet[v] != meshlets.size() && std::find(indices + t, indices + t + i, v) == indices + t + i)
+                    newVertices++;
+            }
+
+            if (vertices.size() + newVertices > maxVertices || meshlet.numIndices / 3 == maxTriangles)
+            {
+                computeBounds(meshlet, vertices, mesh, positionTolerance);
+                meshlets.push_back(meshlet);
+
+                meshlet.firstIndex = t;
+                meshlet.numIndices = 0;
+                vertices.clear();
+            }
+
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                auto v = indices[t + i];
+                if (lastMeshlet[v] != meshlets.size())
+                {
+                    lastMeshlet[v] = meshlets.size();
+                    vertices.push_back(v);
+                }
+            }
+            meshlet.numIndices += 3;
+        }
+
+        if (meshlet.numIndices > 0)
+        {
+            computeBounds(meshlet, vertices, mesh, positionTolerance);
+            meshlets.push_back(meshlet);
+        }
+    }
+
+    return meshlets;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "MeshCache.h"
+
+
+// Splits the levels of detail of a mesh into meshlets, runs of consecutive triangles with at most maxVertices
+// unique vertices and maxTriangles triangles. They stay contiguous ranges of the index buffer, so every meshlet
+// draws as one indirect command. The vertex cache order of the levels keeps the runs spatially coherent.
+namespace MeshletBuilder
+{
+    const unsigned int maxVertices = 64;
+    const unsigned int maxTriangles = 124;
+
+    struct Meshlet
+    {
+        unsigned int lod;
+        unsigned int firstIndex; // relative to the first index of the level
+        unsigned int numIndices;
+        glm::vec3 center; // bounding sphere
+        float radius;
+        glm::vec3 coneAxis; // contains the vertex normals
+        float coneCutoff;   // cosine of the cone's half angle, at most 0 if the normals spread too far to cull by them
+    };
+
+    // bounds and cones also cover the quantization of the compact vertex format
+    std::vector<Meshlet> build(const MeshCache::Mesh& mesh);
+}
@@ -2,14 +2,25 @@
 
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 #include <glbinding/gl/functions.h>
 #include <glbinding/gl/enum.h>
 
+#include <globjects/Buffer.h>
 #include <globjects/Texture.h>
 
 
-#include <gloperate/primitives/PolygonalDrawable.h>
 #include <gloperate/primitives/PolygonalGeometry.h>
 #include <gloperate/primitives/Scene.h>
 #include <gloperate/resources/ResourceManager.h>
@@ -21,17 +32,231 @@
 #include <assimp/postprocess.h>
 #include <assimp/material.h>
 
+#include "BlockCompression.h"
+#include "IndexOptimizer.h"
+#include "MaterialTable.h"
+#include "MemoryRegistry.h"
+#include "MeshCache.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "ObjParser.h"
+#include "ParallelFor.h"
+#include "PointCloud.h"
+#include "RawImage.h"
+#include "SceneGeometry.h"
+#include "TextureCache.h"
+
 using namespace gl;
 using gloperate::make_unique;
 
 namespace
 {
+    // changing these invalidates all mesh caches
+    const unsigned int postProcessFlags =
+        aiProcess_Triangulate |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_SortByPType |
+        aiProcess_GenNormals |
+        aiProcess_OptimizeGraph |
+        aiProcess_OptimizeMeshes |
+        aiProcess_ImproveCacheLocality |
+        aiProcess_RemoveRedundantMaterials;
+
+    // the native obj parser does none of the assimp post-processing, its meshes get their own cache entries
+    const unsigned int objParserFlags = 0;
+
+    // number of pixel unpack buffers texture uploads cycle through
+    const size_t numPixelUnpackBuffers = 4;
+
+    // every level of detail aims for half the triangles of the previous one, down to this many
+    const size_t minLodTriangles = 64;
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
     std::string getDirectory(const std::string& path)
     {
         size_t found = path.find_last_of("/\\");
         return(path.substr(0, found));
     }
 
+    bool isObjFile(const std::string& filename)
+    {
+        auto extension = filename.substr(std::min(filename.size(), filename.find_last_of('.')));
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".obj";
+    }
+
+    std::string resolveTexturePath(const std::string& directory, const std::string& texturePath)
+    {
+        auto path = directory + "/" + texturePath;
+        std::replace(path.begin(), path.end(), '\\', '/');
+        return path;
+    }
+
+    MaterialDescription describeObjMaterial(const ObjParser::Material& material, const std::string& directory)
+    {
+        MaterialDescription description;
+        description.specularFactor = material.shininess;
+        for (const auto& pair : material.texturePaths)
+            description.texturePaths[pair.first] = resolveTexturePath(directory, pair.second);
+        return description;
+    }
+
+    std::unique_ptr<gloperate::PolygonalGeometry> convertObjMesh(ObjParser::Mesh& mesh, float vertexScale)
+    {
+        auto geometry = gloperate::make_unique<gloperate::PolygonalGeometry>();
+
+        for (auto& vertex : mesh.vertices)
+            vertex *= vertexScale;
+
+        geometry->setIndices(std::move(mesh.indices));
+        geometry->setVertices(std::move(mesh.vertices));
+        geometry->setNormals(std::move(mesh.normals));
+        if (!mesh.textureCoordinates.empty())
+            geometry->setTextureCoordinates(std::move(mesh.textureCoordinates));
+        geometry->setMaterialIndex(mesh.materialIndex);
+
+        return geometry;
+    }
+
+    // built-in presets, data/presets.txt overrides them
+    const std::map<Preset, PresetInformation> defaultPresets {
+        //                          camera eye             camera center          near;far         light position       light center     light radius   ground color   ground height  alpha   bump mapping type  reflections  zThickness  focalDist  focalRadius vertex scale  RSM lod  ISM lod
+        { Preset::Imrod,          { { -10.0, 31.2, 10.65 },{ 30, 5.5, -30.0 },    { 0.3, 50000.0 }, { 0, 52, 0 },       { 0, 0, 0 },     1.0f,          { 1, 1, 1 },   0.0f,         1.0f,   BumpType::Normal,  true,        3.0f,       30.0f,     0.003f,     1.0f,    0,       0 } },
+        { Preset::SanMiguel,      { { -0.83, 1.9, 21.6 },  { -9.7, -0.85, 4.75 }, { 0.05, 50.0 },   {-1.5, 27.4, 15 },  { -7, 11, 15 },  0.15f,         { 1, 1, 1 },  -0.10f,        1.0f,   BumpType::Height,  true,        0.30f,      9.0f,      0.003f,     1.0f,    2,       2 } },
+        { Preset::CrytekSponza,   { { -13, 2.5, -0.23 },   { 0.009, -0.019, -0.021 },{ 0.05, 50.0 },{ 4.5, 2.7, -0.3 }, { -0.5, 14, 0 }, 0.15f,         { 1, 1, 1 },  -0.10f,        1.0f,   BumpType::Height,  true,        0.30f,      9.0f,      0.003f,     0.01f,   0,       0 } },
+        { Preset::DabrovicSponza, { { -10.0, 12.6, 0.9 },  { 3.2, 0.28, -1.82 },  { 0.3, 500.0 },   { 0, 18, 0 },       { 0, 0, 0 },     1.0f,          { 1, 1, 1 },   0.0f,         1.0f,   BumpType::Height,  false,       0.0f,       15.0f,     0.003f,     1.0f,    0,       0 } },
+        { Preset::Jakobi,         { { 0.39, 0.49, -0.63 }, { 0.05, -0.04, -0.1 }, { 0.01, 80.0 },   { -0.4, 1.2, -0.7 },{ 0, 0, 0 },     0.05f,         { 1, 1, 1 },  -0.115f,       1.0f,   BumpType::None,    true,        0.05f,      0.5f,      0.003f,     1.0f,    0,       0 } },
+        { Preset::Megacity,       { { 0.26, 0.23, -0.35 }, { 0.14, 0.0, -0.14 },  { 0.01, 80.0 },   { -0.4, 1.2, -1.5 },{ 0, 0, 0 },     0.01f,         { 1, 1, 1 },  -0.048f,       1.0f,   BumpType::None,    true,        0.05f,      0.5f,      0.003f,     1.0f,    0,       0 } },
+        { Preset::Mitusba,        { { 0.2, 3.7, 4.3 },     { 0.16, 0.07, -1.25 }, { 0.3, 600.0 },   { 10, 20, 0 },      { 0, 0, 0 },     0.7f,          { 1, 1, 1 },   0.1f,         0.5f,   BumpType::None,    false,       0.0f,       7.0f,      0.003f,     1.0f,    0,       0 } },
+        { Preset::Transparency,   { { -1.9, 4.2, 4.6 },    { -0.06, 0.02, 0.56 }, { 0.3, 600.0 },   { 0, 5, 0 },        { 0, 0, 0 },     0.1f,          { 1, 1, 1 },  -1.4f,         0.5f,   BumpType::None,    false,       0.0f,       4.0f,      0.003f,     1.0f,    0,       0 } }
+    };
+
+    const std::map<Preset, std::string> defaultFilenames {
+        { Preset::Imrod, "data/Imrod/Imrod.obj" },
+        { Preset::SanMiguel, "data/sanmiguel/sanMiguel.obj" },
+        { Preset::CrytekSponza, "data/crytek-sponza/sponza.obj" },
+        { Preset::DabrovicSponza, "data/dabrovic-sponza/sponza.obj" },
+        { Preset::Jakobi, "data/jakobi/jakobikirchplatz4.obj" },
+        { Preset::Megacity, "data/megacity/simple2.obj" },
+        { Preset::Mitusba, "data/mitsuba/mitsuba.obj" },
+        { Preset::Transparency, "data/transparency_scene.obj" }
+    };
+
+    const std::string presetFilename = "data/presets.txt";
+
+    bool readValue(std::istream& stream, unsigned int& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    bool readValue(std::istream& stream, float& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    bool readValue(std::istream& stream, glm::vec2& value)
+    {
+        return static_cast<bool>(stream >> value.x >> value.y);
+    }
+
+    bool readValue(std::istream& stream, glm::vec3& value)
+    {
+        return static_cast<bool>(stream >> value.x >> value.y >> value.z);
+    }
+
+    bool readValue(std::istream& stream, bool& value)
+    {
+        return static_cast<bool>(stream >> std::boolalpha >> value);
+    }
+
+    bool readValue(std::istream& stream, std::string& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    bool readValue(std::istream& stream, BumpType& value)
+    {
+        static const std::map<std::string, BumpType> names {
+            { "None", BumpType::None },
+            { "Height", BumpType::Height },
+            { "Normal", BumpType::Normal }
+        };
+
+        std::string name;
+        stream >> name;
+        auto it = names.find(name);
+        if (it == names.end())
+            return false;
+
+        value = it->second;
+        return true;
+    }
+
+    // overrides the keys the preset's section sets, returns false if the file or the section is missing
+    bool readPresetFile(Preset preset, PresetInformation& information, std::string& modelFilename)
+    {
+        std::ifstream file(presetFilename);
+        if (!file)
+            return false;
+
+        auto section = "[" + reflectionzeug::EnumDefaultStrings<Preset>()().at(preset) + "]";
+        bool inSection = false;
+        bool found = false;
+
+        std::string line;
+        for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+        {
+            std::istringstream stream(line.substr(0, line.find('#')));
+            std::string key;
+            if (!(stream >> key))
+                continue;
+
+            if (key.front() == '[')
+            {
+                inSection = key == section;
+                found = found || inSection;
+                continue;
+            }
+
+            if (!inSection)
+                continue;
+
+            bool valid;
+            if (key == "model")               valid = readValue(stream, modelFilename);
+            else if (key == "camEye")         valid = readValue(stream, information.camEye);
+            else if (key == "camCenter")      valid = readValue(stream, information.camCenter);
+            else if (key == "nearFar")        valid = readValue(stream, information.nearFar);
+            else if (key == "lightPosition")  valid = readValue(stream, information.lightPosition);
+            else if (key == "lightCenter")    valid = readValue(stream, information.lightCenter);
+            else if (key == "lightMaxShift")  valid = readValue(stream, information.lightMaxShift);
+            else if (key == "groundColor")    valid = readValue(stream, information.groundColor);
+            else if (key == "groundHeight")   valid = readValue(stream, information.groundHeight);
+            else if (key == "alpha")          valid = readValue(stream, information.alpha);
+            else if (key == "bumpType")       valid = readValue(stream, information.bumpType);
+            else if (key == "useReflections") valid = readValue(stream, information.useReflections);
+            else if (key == "zThickness")     valid = readValue(stream, information.zThickness);
+            else if (key == "focalDist")      valid = readValue(stream, information.focalDist);
+            else if (key == "focalPoint")     valid = readValue(stream, information.focalPoint);
+            else if (key == "vertexScale")    valid = readValue(stream, information.vertexScale);
+            else if (key == "rsmLodLevel")    valid = readValue(stream, information.rsmLodLevel);
+            else if (key == "ismLodLevel")    valid = readValue(stream, information.ismLodLevel);
+            else
+            {
+                std::cout << presetFilename << ":" << lineNumber << ": unknown key " << key << std::endl;
+                continue;
+            }
+
+            if (!valid)
+                std::cout << presetFilename << ":" << lineNumber << ": invalid value for " << key << std::endl;
+        }
+
+        return found;
+    }
+
     auto textureTypes = {
         aiTextureType_DIFFUSE,
         aiTextureType_EMISSIVE,
@@ -52,85 +277,995 @@ namespace
 
         return conversion.at(aiTexType);
     }
+
+    // bytes of a texture with its full mip chain
+    size_t mipChainSize(int width, int height, size_t bytesPerTexel)
+    {
+        size_t size = 0;
+        while (true)
+        {
+            size += static_cast<size_t>(width) * height * bytesPerTexel;
+            if (width == 1 && height == 1)
+                return size;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+    }
+
+    // matches the channels model.frag samples from each texture type, emissive textures stay uncompressed
+    bool chooseBlockFormat(TextureType type, BumpType bumpType, const RawImage& image, BlockFormat& format, bool& grayscale)
+    {
+        grayscale = false;
+        switch (type)
+        {
+        case TextureType::Diffuse:
+            format = BlockCompression::hasAlpha(image) ? BlockFormat::BC3 : BlockFormat::BC1;
+            return true;
+        case TextureType::Specular:
+            grayscale = BlockCompression::isGrayscale(image);
+            format = grayscale ? BlockFormat::BC4 : BlockFormat::BC1;
+            return true;
+        case TextureType::Bump:
+            format = bumpType == BumpType::Normal ? BlockFormat::BC5 : BlockFormat::BC4;
+            return true;
+        case TextureType::Opacity:
+            format = BlockFormat::BC4;
+            return true;
+        case TextureType::Emissive:
+        default:
+            return false;
+        }
+    }
+
+    // block compressed textures are decoded once per type they are used as, the type decides the format
+    bool compressedPerType(bool compressTextures, TextureType type)
+    {
+        return compressTextures && type != TextureType::Emissive;
+    }
+
+    GLenum compressedFormat(BlockFormat format)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+    }
+
+    MeshCache::Mesh meshView(const gloperate::PolygonalGeometry& geometry)
+    {
+        MeshCache::Mesh mesh;
+        mesh.materialIndex = geometry.materialIndex();
+        mesh.numIndices = static_cast<unsigned int>(geometry.indices().size());
+        mesh.numVertices = static_cast<unsigned int>(geometry.vertices().size());
+        mesh.indices = geometry.indices().data();
+        mesh.vertices = geometry.vertices().data();
+        mesh.normals = geometry.hasNormals() ? geometry.normals().data() : nullptr;
+        mesh.textureCoordinates = geometry.hasTextureCoordinates() ? geometry.textureCoordinates().data() : nullptr;
+        mesh.numLods = 1;
+        mesh.lodFirstIndex[0] = 0;
+        mesh.lodNumIndices[0] = mesh.numIndices;
+        mesh.lodError[0] = 0.0f;
+        return mesh;
+    }
+
+    // vertex cache order first, then clusters of it sorted for less overdraw
+    void optimizeIndices(unsigned int* indices, size_t numIndices, const std::vector<glm::vec3>& vertices)
+    {
+        std::vector<size_t> hardBoundaries;
+        IndexOptimizer::optimizeVertexCache(indices, numIndices, vertices.size(), hardBoundaries);
+        IndexOptimizer::optimizeOverdraw(indices, numIndices, vertices.data(), hardBoundaries);
+    }
+
+    // replaces the assimp ordering of the full resolution indices
+    void optimizeGeometry(gloperate::PolygonalGeometry& geometry, IndexOptimizer::Statistics& before, IndexOptimizer::Statistics& after)
+    {
+        auto indices = geometry.indices();
+        const auto& vertices = geometry.vertices();
+
+        before = IndexOptimizer::analyze(indices.data(), indices.size(), vertices.data(), vertices.size());
+        optimizeIndices(indices.data(), indices.size(), vertices);
+        after = IndexOptimizer::analyze(indices.data(), indices.size(), vertices.data(), vertices.size());
+
+        geometry.setIndices(std::move(indices));
+    }
+
+    void printStatistics(const IndexOptimizer::Statistics& before, const IndexOptimizer::Statistics& after)
+    {
+        std::cout << "ACMR " << before.acmr << " -> " << after.acmr
+            << ", ATVR " << before.atvr << " -> " << after.atvr
+            << ", overdraw " << before.overdraw << " -> " << after.overdraw << std::endl;
+    }
+
+    // per mesh and triangle weighted for the whole scene, measured on the full resolution level
+    void printStatistics(const std::string& modelFilename, const std::vector<MeshCache::Mesh>& meshes)
+    {
+        IndexOptimizer::Statistics sceneBefore = { 0.0f, 0.0f, 0.0f };
+        IndexOptimizer::Statistics sceneAfter = { 0.0f, 0.0f, 0.0f };
+        size_t numTriangles = 0;
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            const auto& mesh = meshes[i];
+            auto triangles = mesh.lodNumIndices[0] / 3;
+            std::cout << "Mesh " << i << " (" << triangles << " triangles): ";
+            printStatistics(mesh.statisticsBefore, mesh.statisticsAfter);
+
+            for (auto pair : { std::make_pair(&sceneBefore, &mesh.statisticsBefore), std::make_pair(&sceneAfter, &mesh.statisticsAfter) })
+            {
+                pair.first->acmr += pair.second->acmr * triangles;
+                pair.first->atvr += pair.second->atvr * triangles;
+                pair.first->overdraw += pair.second->overdraw * triangles;
+            }
+            numTriangles += triangles;
+        }
+
+        if (numTriangles == 0)
+            return;
+
+        for (auto statistics : { &sceneBefore, &sceneAfter })
+        {
+            statistics->acmr /= numTriangles;
+            statistics->atvr /= numTriangles;
+            statistics->overdraw /= numTriangles;
+        }
+        std::cout << "Scene " << modelFilename << ": ";
+        printStatistics(sceneBefore, sceneAfter);
+    }
+
+    // appends simplified levels of detail to the indices of the geometry
+    MeshCache::Mesh buildLods(gloperate::PolygonalGeometry& geometry)
+    {
+        auto indices = geometry.indices();
+        const auto& vertices = geometry.vertices();
+        auto numFullIndices = indices.size();
+
+        unsigned int numLods = 1;
+        unsigned int lodFirstIndex[MeshCache::maxLods] = { 0 };
+        unsigned int lodNumIndices[MeshCache::maxLods] = { static_cast<unsigned int>(numFullIndices) };
+        float lodError[MeshCache::maxLods] = { 0.0f };
+
+        for (; numLods < MeshCache::maxLods; ++numLods)
+        {
+            auto target = (numFullIndices / 3 >> numLods) * 3;
+            if (target < minLodTriangles * 3)
+                break;
+
+            // always simplify the full mesh, starting from a coarser level would forget its quadrics
+            float error;
+            auto lod = MeshSimplifier::simplify(geometry.indices().data(), numFullIndices, vertices.data(), vertices.size(), target, error);
+
+            // stop once locked borders keep the simplifier from making real progress
+            if (lod.size() * 5 > lodNumIndices[numLods - 1] * 4)
+                break;
+
+            optimizeIndices(lod.data(), lod.size(), vertices);
+
+            lodFirstIndex[numLods] = static_cast<unsigned int>(indices.size());
+            lodNumIndices[numLods] = static_cast<unsigned int>(lod.size());
+            lodError[numLods] = std::max(error, lodError[numLods - 1]);
+            indices.insert(indices.end(), lod.begin(), lod.end());
+        }
+
+        geometry.setIndices(std::move(indices));
+
+        auto mesh = meshView(geometry);
+        mesh.numLods = numLods;
+        for (unsigned int l = 0; l < numLods; ++l)
+        {
+            mesh.lodFirstIndex[l] = lodFirstIndex[l];
+            mesh.lodNumIndices[l] = lodNumIndices[l];
+            mesh.lodError[l] = lodError[l];
+        }
+        return mesh;
+    }
+
+    // a mesh waiting for upload, pointing either into the mapped mesh cache or into its own storage
+    struct PendingMesh
+    {
+        MeshCache::Mesh mesh;
+        std::vector<MeshletBuilder::Meshlet> meshlets;
+        std::shared_ptr<gloperate::PolygonalGeometry> storage; // shared with the loader while it builds the point cloud
+    };
+
+    size_t meshSize(const MeshCache::Mesh& mesh)
+    {
+        auto attributes = 1 + (mesh.normals ? 1 : 0) + (mesh.textureCoordinates ? 1 : 0);
+        return mesh.numVertices * attributes * sizeof(glm::vec3) + mesh.numIndices * sizeof(unsigned int);
+    }
+
+    // meshlets are cheap to rebuild, so they are not part of the mesh cache
+    std::vector<std::vector<MeshletBuilder::Meshlet>> buildMeshlets(const std::vector<MeshCache::Mesh>& meshes, const std::atomic<bool>& cancelled)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::vector<MeshletBuilder::Meshlet>> meshlets(meshes.size());
+        parallelFor(meshes.size(), [&](size_t i)
+        {
+            if (!cancelled)
+                meshlets[i] = MeshletBuilder::build(meshes[i]);
+        });
+
+        size_t numMeshlets = 0;
+        for (const auto& list : meshlets)
+            numMeshlets += list.size();
+        std::cout << "Built " << numMeshlets << " meshlets in " << millisecondsSince(start) << " ms" << std::endl;
+
+        return meshlets;
+    }
+
+    // the ISM surface samples, generated once per mesh cache
+    std::unique_ptr<PointCloud> buildPointCloud(const std::string& meshCacheFilename, const std::vector<MeshCache::Mesh>& meshes)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        auto pointCloud = gloperate::make_unique<PointCloud>(meshCacheFilename);
+        if (pointCloud->load())
+        {
+            std::cout << "Loaded " << pointCloud->points().size() << " scene points from " << pointCloud->cacheFilename() << " in " << millisecondsSince(start) << " ms" << std::endl;
+            return pointCloud;
+        }
+
+        pointCloud->build(meshes);
+        std::cout << "Generated " << pointCloud->points().size() << " scene points in " << millisecondsSince(start) << " ms" << std::endl;
+        pointCloud->store();
+
+        return pointCloud;
+    }
 }
 
+struct ModelLoadingStage::DecodedTexture
+{
+    DecodedTexture() : type(TextureType::Diffuse), perType(false), decodeTime(0.0), fromCache(false) {}
+
+    std::string path;
+    TextureType type;
+    bool perType; // only for the users of type, see compressedPerType
+    std::unique_ptr<RawImage> image; // nullptr if decoding failed or no RawImage loader is registered
+    std::unique_ptr<CompressedImage> compressed; // replaces image for block compressed textures
+    double decodeTime;
+    bool fromCache;
+};
+
+// everything a scene keeps on the GPU, the current one and recently used ones
+struct ModelLoadingStage::ResidentScene
+{
+    ResidentScene()
+    : preset(Preset::None), textureBytes(0), complete(false)
+    {}
+
+    ~ResidentScene()
+    {
+        for (const auto& pair : textures)
+            MemoryRegistry::unregister(pair.second.get());
+    }
+
+    size_t memoryUsage() const
+    {
+        return geometry->memoryUsage() + textureBytes + materialTable->memoryUsage();
+    }
+
+    Preset preset;
+    std::string modelFilename;
+    std::unique_ptr<PresetInformation> presetInformation;
+    std::unique_ptr<SceneGeometry> geometry;
+    std::unique_ptr<IdMaterialMap> materialMap;
+    StringTextureMap textures;
+    std::unique_ptr<MaterialTable> materialTable; // declared after the textures, so it releases their handles first
+    size_t textureBytes;
+    bool complete; // false while streaming in or if loading was cancelled
+};
+
+// shared between the GL thread and the background loader
+struct ModelLoadingStage::LoadingState
+{
+    LoadingState()
+    : cancelled(false), scene(nullptr), materialsReady(false), workerDone(false)
+    , numVertices(0), numIndices(0)
+    , materialsCreated(false), numMeshes(0), numTextures(0), totalDecodeTime(0.0), totalUploadTime(0.0)
+    , textureBytes(0), uncompressedTextureBytes(0)
+    {}
+
+    std::string modelFilename;
+    BumpType bumpType;
+    bool compressTextures;
+    bool useNativeObjParser;
+    std::chrono::steady_clock::time_point startTime;
+    std::thread worker;
+    std::atomic<bool> cancelled;
+    std::unique_ptr<MeshCache> meshCache; // keeps the mapping alive that pending meshes point into
+
+    // only accessed by the GL thread
+    ResidentScene* scene; // the scene being filled
+    std::unique_ptr<ResidentScene> pendingScene; // owns scene until it replaces the current one, empty for the first scene
+
+    // guarded by mutex
+    std::mutex mutex;
+    bool materialsReady;
+    bool workerDone;
+    std::vector<MaterialDescription> materials;
+    size_t numVertices;
+    size_t numIndices;
+    std::deque<PendingMesh> meshes;
+    std::deque<DecodedTexture> textures;
+    std::unique_ptr<PointCloud> pointCloud; // uploaded after the last mesh
+
+    bool materialsCreated;
+    std::multimap<std::string, std::pair<unsigned int, TextureType>> textureUsers;
+    size_t numMeshes;
+    size_t numTextures;
+    double totalDecodeTime;
+    double totalUploadTime;
+    size_t textureBytes;
+    size_t uncompressedTextureBytes; // what the same textures take as RGBA8
+};
+
 ModelLoadingStage::ModelLoadingStage()
-: m_currentPreset(Preset::None)
+: useCompactVertices(true)
+, useTextureCompression(true)
+, useNativeObjParser(true)
+, useBindlessTextures(true)
+, maxResidentScenes(2)
+, residentSceneBudget(size_t(2048) * 1024 * 1024)
+, m_nextPixelUnpackBuffer(0)
+, m_sceneVersion(0)
+, m_materialTableVersion(~0u)
 {
 }
 
 ModelLoadingStage::~ModelLoadingStage()
 {
+    cancelLoading();
 }
 
 void ModelLoadingStage::loadScene(Preset preset)
 {
-    m_currentPreset = preset;
-    m_currentPresetInformation = make_unique<PresetInformation>(getPresetInformation(preset));
+    startLoading(preset);
 
-    m_drawablesMap = make_unique<IdDrawablesMap>();
-    m_materialMap = make_unique<IdMaterialMap>();
-    m_textures = StringTextureMap{};
+    while (isLoading())
+    {
+        processPending(std::numeric_limits<double>::infinity());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void ModelLoadingStage::startLoading(Preset preset)
+{
+    if (m_loading && m_loading->scene->preset == preset)
+        return;
+
+    cancelLoading();
+
+    if (m_scene && m_scene->complete && m_scene->preset == preset)
+        return;
+
+    auto resident = std::find_if(m_residentScenes.begin(), m_residentScenes.end(), [preset](const std::unique_ptr<ResidentScene>& scene) {
+        return scene->preset == preset;
+    });
+    if (resident != m_residentScenes.end())
+    {
+        auto scene = std::move(*resident);
+        m_residentScenes.erase(resident);
+        std::cout << "Switched to resident scene " << scene->modelFilename << std::endl;
+        makeCurrent(std::move(scene));
+        return;
+    }
+
+    auto scene = make_unique<ResidentScene>();
+    scene->preset = preset;
+    scene->presetInformation = make_unique<PresetInformation>(getPresetInformation(preset, scene->modelFilename));
+    scene->geometry = make_unique<SceneGeometry>(m_scene ? m_scene->geometry->compactVertices() : useCompactVertices);
+    scene->materialMap = make_unique<IdMaterialMap>();
+    scene->materialTable = make_unique<MaterialTable>(m_scene ? m_scene->materialTable->bindless() : useBindlessTextures && MaterialTable::bindlessSupported());
 
     glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_maxAnisotropy);
 
-    auto modelFilename = getFilename(preset);
-    auto dir = getDirectory(modelFilename);
+    if (m_pixelUnpackBuffers.empty())
+    {
+        for (size_t i = 0; i < numPixelUnpackBuffers; ++i)
+        {
+            m_pixelUnpackBuffers.push_back(new globjects::Buffer());
+            m_pixelUnpackBuffers.back()->setName("Pixel Unpack Buffer " + std::to_string(i));
+        }
+    }
+
+    auto modelFilename = scene->modelFilename;
+    auto vertexScale = scene->presetInformation->vertexScale;
 
+    m_loading = make_unique<LoadingState>();
+    m_loading->modelFilename = modelFilename;
+    m_loading->bumpType = scene->presetInformation->bumpType;
+    m_loading->scene = scene.get();
+    m_loading->compressTextures = useTextureCompression;
+    m_loading->useNativeObjParser = useNativeObjParser;
+    m_loading->startTime = std::chrono::steady_clock::now();
 
-    const aiScene* assimpScene = aiImportFile(
-        modelFilename.c_str(),
-        aiProcess_Triangulate |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_SortByPType |
-        aiProcess_GenNormals |
-        aiProcess_OptimizeGraph |
-        aiProcess_OptimizeMeshes |
-        aiProcess_ImproveCacheLocality |
-        aiProcess_RemoveRedundantMaterials);
+    // the current scene keeps rendering until the new one is complete
+    if (m_scene)
+        m_loading->pendingScene = std::move(scene);
+    else
+    {
+        m_scene = std::move(scene);
+        m_sceneVersion++;
+    }
+
+    m_loading->worker = std::thread(&ModelLoadingStage::loadInBackground, this, std::ref(*m_loading), modelFilename, vertexScale);
+}
 
-    if (!assimpScene)
+bool ModelLoadingStage::isLoading() const
+{
+    return m_loading != nullptr;
+}
+
+void ModelLoadingStage::processPending(double timeBudget)
+{
+    if (!m_loading)
+        return;
+
+    auto& state = *m_loading;
+    auto& scene = *state.scene;
+    auto frameStart = std::chrono::steady_clock::now();
+
+    if (!state.materialsCreated)
     {
-        std::cout << "Model could not be loaded: " << aiGetErrorString() << std::endl;
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.materialsReady)
+        {
+            // materials exist before any of their meshes and receive their textures as they arrive
+            scene.geometry->reserve(state.numVertices, state.numIndices);
 
-        return ;
+            for (unsigned int m = 0; m < state.materials.size(); m++)
+            {
+                Material material;
+                material.specularFactor = state.materials[m].specularFactor;
+                (*scene.materialMap)[m] = material;
+
+                for (const auto& pair : state.materials[m].texturePaths)
+                    state.textureUsers.insert({ pair.second, { m, pair.first } });
+            }
+            state.materialsCreated = true;
+            m_sceneVersion++;
+        }
     }
 
-    for (unsigned int m = 0; m < assimpScene->mNumMaterials; m++)
+    size_t numMeshesBefore = state.numMeshes;
+
+    while (true)
     {
-        auto mat = loadMaterial(assimpScene->mMaterials[m], dir);
-        (*m_materialMap)[m] = mat;
-        (*m_drawablesMap)[m] = PolygonalDrawables{};
+        PendingMesh mesh;
+        bool hasMesh = false;
+        DecodedTexture texture;
+        std::unique_ptr<PointCloud> pointCloud;
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.materialsCreated && !state.meshes.empty())
+            {
+                mesh = std::move(state.meshes.front());
+                state.meshes.pop_front();
+                hasMesh = true;
+            }
+            if (state.materialsCreated && !state.textures.empty())
+            {
+                texture = std::move(state.textures.front());
+                state.textures.pop_front();
+            }
+            if (state.materialsCreated && state.meshes.empty() && !hasMesh)
+                pointCloud = std::move(state.pointCloud);
+            done = state.workerDone && state.meshes.empty() && state.textures.empty();
+
+            // decoded data waiting for upload
+            size_t pendingBytes = 0;
+            for (const auto& pending : state.meshes)
+                pendingBytes += meshSize(pending.mesh) + pending.meshlets.size() * sizeof(MeshletBuilder::Meshlet);
+            for (const auto& pending : state.textures)
+                pendingBytes += pending.compressed ? pending.compressed->data.size() : pending.image ? pending.image->data.size() : 0;
+            if (state.pointCloud)
+                pendingBytes += state.pointCloud->points().size() * sizeof(glm::vec4);
+            MemoryRegistry::registerCPU("Scene Loading", &state, "Pending Meshes and Textures", pendingBytes);
+        }
+
+        if (hasMesh)
+        {
+            scene.geometry->add(mesh.mesh, mesh.meshlets);
+            state.numMeshes++;
+        }
+
+        if (pointCloud)
+        {
+            scene.geometry->setPoints(pointCloud->points(), pointCloud->radius());
+            m_sceneVersion++;
+        }
+
+        if (!texture.path.empty())
+            addTexture(state, texture);
+
+        if ((!hasMesh && texture.path.empty()) || millisecondsSince(frameStart) >= timeBudget)
+        {
+            if (state.numMeshes != numMeshesBefore)
+            {
+                scene.geometry->updateCommands();
+                m_sceneVersion++;
+            }
+
+            if (done && !hasMesh && texture.path.empty())
+                finishLoading();
+            return;
+        }
+    }
+}
+
+void ModelLoadingStage::cancelLoading()
+{
+    if (!m_loading)
+        return;
+
+    m_loading->cancelled = true;
+    m_loading->worker.join();
+    MemoryRegistry::unregister(m_loading.get());
+    m_loading.reset();
+}
+
+void ModelLoadingStage::finishLoading()
+{
+    auto& state = *m_loading;
+    state.worker.join();
+
+    std::cout << "Scene " << state.modelFilename << " fully resident after " << millisecondsSince(state.startTime) << " ms: "
+        << state.numMeshes << " meshes, " << state.numTextures << " textures"
+        << " (decode " << state.totalDecodeTime << " ms summed over all threads, upload " << state.totalUploadTime << " ms)" << std::endl;
+
+    const auto megabyte = 1024.0 * 1024.0;
+    std::cout << "Texture memory: " << state.textureBytes / megabyte << " MB instead of " << state.uncompressedTextureBytes / megabyte
+        << " MB uncompressed (saved " << (state.uncompressedTextureBytes - state.textureBytes) / megabyte << " MB)" << std::endl;
+
+    // without bindless textures the texture arrays of the material table hold the only copy
+    state.scene->textureBytes = state.scene->materialTable->bindless() ? state.textureBytes : 0;
+    state.scene->complete = true;
+
+    auto pendingScene = std::move(state.pendingScene);
+    MemoryRegistry::unregister(&state);
+    m_loading.reset();
+
+    if (pendingScene)
+        makeCurrent(std::move(pendingScene));
+    else
+        evictResidentScenes();
+}
+
+void ModelLoadingStage::makeCurrent(std::unique_ptr<ResidentScene> scene)
+{
+    // an incomplete scene would be picked up as resident later, it is loaded again instead
+    if (m_scene && m_scene->complete)
+        m_residentScenes.push_front(std::move(m_scene));
+
+    m_scene = std::move(scene);
+    m_sceneVersion++;
+    evictResidentScenes();
+}
+
+void ModelLoadingStage::evictResidentScenes()
+{
+    auto totalBytes = m_scene ? m_scene->memoryUsage() : 0;
+    for (const auto& scene : m_residentScenes)
+        totalBytes += scene->memoryUsage();
+
+    const auto megabyte = 1024.0 * 1024.0;
+    while (!m_residentScenes.empty() && (m_residentScenes.size() > maxResidentScenes || totalBytes > residentSceneBudget))
+    {
+        const auto& scene = *m_residentScenes.back();
+        totalBytes -= scene.memoryUsage();
+        std::cout << "Evicted resident scene " << scene.modelFilename << " (" << scene.memoryUsage() / megabyte << " MB)" << std::endl;
+        m_residentScenes.pop_back();
     }
 
-    auto scene = new gloperate::Scene;
-    for (size_t i = 0; i < assimpScene->mNumMeshes; ++i)
+    std::cout << m_residentScenes.size() << " scenes resident besides the current one, "
+        << totalBytes / megabyte << " MB of " << residentSceneBudget / megabyte << " MB used" << std::endl;
+}
+
+void ModelLoadingStage::addTexture(LoadingState& state, const DecodedTexture& texture)
+{
+    auto uploadStart = std::chrono::steady_clock::now();
+
+    // without a RawImage loader (or if decoding failed) fall back to decoding on the GL thread
+    bool decoded = texture.image != nullptr || texture.compressed != nullptr;
+    globjects::ref_ptr<globjects::Texture> tex;
+    if (texture.compressed)
+    {
+        const auto& base = texture.compressed->levels.front();
+        tex = uploadCompressedTexture(*texture.compressed);
+        state.textureBytes += texture.compressed->data.size();
+        state.uncompressedTextureBytes += mipChainSize(base.width, base.height, 4);
+    }
+    else if (texture.image)
+    {
+        tex = uploadTexture(*texture.image);
+        auto size = mipChainSize(texture.image->width, texture.image->height, 4);
+        state.textureBytes += size;
+        state.uncompressedTextureBytes += size;
+    }
+    else
     {
-        auto mesh = convertGeometry(assimpScene->mMeshes[i], m_currentPresetInformation->vertexScale);
-        auto& drawables = m_drawablesMap->at(mesh->materialIndex());
-        drawables.push_back(make_unique<gloperate::PolygonalDrawable>(*mesh.get()));
+        tex = loadTexture(texture.path);
     }
+    // without bindless textures the materials only hold on to it until the material table copied it into an array
+    bool keepTexture = state.scene->materialTable->bindless();
+    if (keepTexture)
+        state.scene->textures[texture.perType ? texture.path + "#" + std::to_string(static_cast<int>(texture.type)) : texture.path] = tex;
 
-    aiReleaseImport(assimpScene);
+    if (tex)
+        tex->setName(texture.path);
+
+    if (tex && keepTexture)
+    {
+        if (texture.compressed)
+            MemoryRegistry::registerTexture("Scene Textures", tex, compressedFormat(texture.compressed->format), texture.compressed->data.size());
+        else if (texture.image)
+            MemoryRegistry::registerTexture("Scene Textures", tex, GL_RGBA8, texture.image->width, texture.image->height, 1, 0);
+    }
+
+    auto users = state.textureUsers.equal_range(texture.path);
+    for (auto it = users.first; it != users.second && tex; ++it)
+    {
+        auto type = it->second.second;
+        bool perType = compressedPerType(state.compressTextures, type);
+        if (perType == texture.perType && (!perType || type == texture.type))
+            state.scene->materialMap->at(it->second.first).addTexture(type, tex);
+    }
+    m_sceneVersion++;
+
+    auto uploadTime = millisecondsSince(uploadStart);
+    state.numTextures++;
+    state.totalDecodeTime += texture.decodeTime;
+    state.totalUploadTime += uploadTime;
+
+    std::cout << "Texture " << texture.path << ": decode " << texture.decodeTime << " ms, upload " << uploadTime << " ms"
+        << (decoded ? "" : " (decoded on GL thread)") << (texture.fromCache ? " (from texture cache)" : "") << std::endl;
+}
+
+void ModelLoadingStage::loadInBackground(LoadingState& state, const std::string& modelFilename, float vertexScale) const
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<MaterialDescription> materials;
+    std::vector<std::shared_ptr<gloperate::PolygonalGeometry>> geometries;
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+
+    bool useObjParser = state.useNativeObjParser && isObjFile(modelFilename);
+    auto meshCache = gloperate::make_unique<MeshCache>(modelFilename, useObjParser ? objParserFlags : postProcessFlags, vertexScale);
+    bool cached = meshCache->load();
+    std::unique_ptr<ObjParser> objParser;
+    const aiScene* assimpScene = nullptr;
+
+    if (cached)
+    {
+        materials = meshCache->materials();
+        for (const auto& mesh : meshCache->meshes())
+        {
+            numVertices += mesh.numVertices;
+            numIndices += mesh.numIndices;
+        }
+    }
+    else if (useObjParser)
+    {
+        objParser = gloperate::make_unique<ObjParser>();
+        if (objParser->load(modelFilename))
+        {
+            auto dir = getDirectory(modelFilename);
+            for (const auto& material : objParser->materials())
+                materials.push_back(describeObjMaterial(material, dir));
+
+            for (const auto& mesh : objParser->meshes())
+            {
+                numVertices += mesh.vertices.size();
+                numIndices += mesh.indices.size();
+            }
+
+            // the halving levels of detail add up to less than the full resolution indices
+            numIndices *= 2;
+        }
+        else
+        {
+            std::cout << "Native OBJ parser failed (" << objParser->error() << "), falling back to assimp" << std::endl;
+            objParser.reset();
+            meshCache = gloperate::make_unique<MeshCache>(modelFilename, postProcessFlags, vertexScale);
+        }
+    }
+
+    if (!cached && !objParser)
+    {
+        assimpScene = aiImportFile(modelFilename.c_str(), postProcessFlags);
+
+        if (!assimpScene)
+        {
+            std::cout << "Model could not be loaded: " << aiGetErrorString() << std::endl;
+
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.workerDone = true;
+            return;
+        }
+
+        auto dir = getDirectory(modelFilename);
+        for (unsigned int m = 0; m < assimpScene->mNumMaterials; m++)
+            materials.push_back(describeMaterial(assimpScene->mMaterials[m], dir));
+
+        for (unsigned int i = 0; i < assimpScene->mNumMeshes; i++)
+        {
+            numVertices += assimpScene->mMeshes[i]->mNumVertices;
+            for (unsigned int f = 0; f < assimpScene->mMeshes[i]->mNumFaces; f++)
+                numIndices += assimpScene->mMeshes[i]->mFaces[f].mNumIndices;
+        }
+
+        // the halving levels of detail add up to less than the full resolution indices
+        numIndices *= 2;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.materials = materials;
+        state.numVertices = numVertices;
+        state.numIndices = numIndices;
+        state.materialsReady = true;
+    }
+
+    // textures decode on all other cores while the geometry is converted
+    std::thread decoder(&ModelLoadingStage::decodeTextures, this, std::ref(state), std::cref(materials));
+
+    if (cached)
+    {
+        std::cout << "Loaded " << modelFilename << " from " << meshCache->cacheFilename() << " in " << millisecondsSince(startTime) << " ms" << std::endl;
+        printStatistics(modelFilename, meshCache->meshes());
+
+        // the mapping stays alive in the loading state until the scene is complete
+        const auto& cachedMeshes = meshCache->meshes();
+        auto cacheFilename = meshCache->cacheFilename();
+        auto meshlets = buildMeshlets(cachedMeshes, state.cancelled);
+
+        // the meshes are uploaded straight from the mapping while the point cloud is built
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (size_t i = 0; i < cachedMeshes.size(); ++i)
+            {
+                PendingMesh pending;
+                pending.mesh = cachedMeshes[i];
+                pending.meshlets = std::move(meshlets[i]);
+                state.meshes.push_back(std::move(pending));
+            }
+            state.meshCache = std::move(meshCache);
+        }
+
+        auto pointCloud = state.cancelled ? nullptr : buildPointCloud(cacheFilename, cachedMeshes);
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.pointCloud = std::move(pointCloud);
+    }
+    else
+    {
+        if (objParser)
+        {
+            for (auto& mesh : objParser->meshes())
+                geometries.push_back(convertObjMesh(mesh, vertexScale));
+            objParser.reset();
+
+            std::cout << "Loaded " << modelFilename << " with the native OBJ parser in " << millisecondsSince(startTime) << " ms" << std::endl;
+        }
+        else
+        {
+            for (size_t i = 0; i < assimpScene->mNumMeshes && !state.cancelled; ++i)
+                geometries.push_back(convertGeometry(assimpScene->mMeshes[i], vertexScale));
+
+            aiReleaseImport(assimpScene);
+
+            std::cout << "Loaded " << modelFilename << " with assimp in " << millisecondsSince(startTime) << " ms" << std::endl;
+        }
+
+        auto lodStart = std::chrono::steady_clock::now();
+        std::vector<MeshCache::Mesh> meshes(geometries.size());
+        parallelFor(geometries.size(), [&](size_t i)
+        {
+            if (state.cancelled)
+                return;
+
+            IndexOptimizer::Statistics before, after;
+            optimizeGeometry(*geometries[i], before, after);
+            meshes[i] = buildLods(*geometries[i]);
+            meshes[i].statisticsBefore = before;
+            meshes[i].statisticsAfter = after;
+        });
+
+        std::cout << "Optimized indices and generated levels of detail in " << millisecondsSince(lodStart) << " ms" << std::endl;
+
+        if (!state.cancelled)
+        {
+            printStatistics(modelFilename, meshes);
+            meshCache->store(materials, meshes);
+        }
+
+        auto meshlets = buildMeshlets(meshes, state.cancelled);
+
+        // geometries keeps the storage alive after the upload, until the point cloud is built from it
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (size_t i = 0; i < geometries.size() && !state.cancelled; ++i)
+            {
+                PendingMesh pending;
+                pending.mesh = meshes[i];
+                pending.meshlets = std::move(meshlets[i]);
+                pending.storage = geometries[i];
+                state.meshes.push_back(std::move(pending));
+            }
+        }
+
+        auto pointCloud = state.cancelled ? nullptr : buildPointCloud(meshCache->cacheFilename(), meshes);
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.pointCloud = std::move(pointCloud);
+    }
+
+    decoder.join();
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.workerDone = true;
+}
+
+void ModelLoadingStage::decodeTextures(LoadingState& state, const std::vector<MaterialDescription>& materials) const
+{
+    // a texture shared between slots is compressed for each type it is used as, and decoded once for all others
+    std::vector<std::string> paths;
+    std::vector<TextureType> types;
+    std::set<std::pair<std::string, int>> uniqueTextures;
+    for (const auto& material : materials)
+    {
+        for (const auto& pair : material.texturePaths)
+        {
+            auto slot = compressedPerType(state.compressTextures, pair.first) ? static_cast<int>(pair.first) : -1;
+            if (uniqueTextures.insert({ pair.second, slot }).second)
+            {
+                paths.push_back(pair.second);
+                types.push_back(pair.first);
+            }
+        }
+    }
+
+    parallelFor(paths.size(), [&](size_t i)
+    {
+        if (state.cancelled)
+            return;
+
+        DecodedTexture texture;
+        texture.path = paths[i];
+        texture.type = types[i];
+
+        auto decodeStart = std::chrono::steady_clock::now();
+        bool compress = compressedPerType(state.compressTextures, types[i]);
+        texture.perType = compress;
+
+        if (compress)
+        {
+            // warm start: the cached mip chain replaces decoding and encoding
+            TextureCache cache(paths[i], types[i]);
+            auto compressed = make_unique<CompressedImage>();
+            if (cache.load(*compressed) && (types[i] != TextureType::Bump || (compressed->format == BlockFormat::BC5) == (state.bumpType == BumpType::Normal)))
+            {
+                texture.compressed = std::move(compressed);
+                texture.fromCache = true;
+            }
+        }
+
+        if (!texture.compressed)
+            texture.image.reset(resourceManager->load<RawImage>(paths[i]));
+
+        BlockFormat format;
+        bool grayscale;
+        if (compress && texture.image && chooseBlockFormat(types[i], state.bumpType, *texture.image, format, grayscale))
+        {
+            texture.compressed = make_unique<CompressedImage>(BlockCompression::compress(*texture.image, format));
+            texture.compressed->grayscale = grayscale;
+            texture.image.reset();
+            TextureCache(paths[i], types[i]).store(*texture.compressed);
+        }
+
+        texture.decodeTime = millisecondsSince(decodeStart);
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.textures.push_back(std::move(texture));
+    });
 }
 
 globjects::ref_ptr<globjects::Texture> ModelLoadingStage::loadTexture(const std::string& filename) const
 {
     globjects::ref_ptr<globjects::Texture> tex = resourceManager->load<globjects::Texture>(filename);
+    if (!tex)
+    {
+        std::cout << "Texture could not be loaded: " << filename << std::endl;
+        return nullptr;
+    }
+
+    setTextureParameters(tex);
+    tex->generateMipmap();
+
+    return tex;
+}
+
+globjects::Buffer* ModelLoadingStage::stagePixels(const void* data, size_t size)
+{
+    auto buffer = m_pixelUnpackBuffers[m_nextPixelUnpackBuffer].get();
+    m_nextPixelUnpackBuffer = (m_nextPixelUnpackBuffer + 1) % m_pixelUnpackBuffers.size();
+
+    // reallocating orphans the previous storage, so the copy never waits for an earlier transfer
+    buffer->setData(static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+    auto mapped = buffer->mapRange(0, static_cast<GLsizeiptr>(size), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    std::memcpy(mapped, data, size);
+    buffer->unmap();
+    MemoryRegistry::registerBuffer("Scene Loading", buffer, size);
+
+    return buffer;
+}
+
+globjects::ref_ptr<globjects::Texture> ModelLoadingStage::uploadTexture(const RawImage& image)
+{
+    auto buffer = stagePixels(image.data.data(), image.data.size());
+
+    auto levels = 1 + static_cast<GLsizei>(std::log2(std::max(image.width, image.height)));
+
+    globjects::ref_ptr<globjects::Texture> tex = new globjects::Texture(GL_TEXTURE_2D);
+    tex->storage2D(levels, GL_RGBA8, image.width, image.height);
+
+    buffer->bind(GL_PIXEL_UNPACK_BUFFER);
+    tex->subImage2D(0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    globjects::Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+
+    setTextureParameters(tex);
+    tex->generateMipmap();
+
+    return tex;
+}
+
+globjects::ref_ptr<globjects::Texture> ModelLoadingStage::uploadCompressedTexture(const CompressedImage& image)
+{
+    auto buffer = stagePixels(image.data.data(), image.data.size());
+    auto internalFormat = compressedFormat(image.format);
+
+    globjects::ref_ptr<globjects::Texture> tex = new globjects::Texture(GL_TEXTURE_2D);
+
+    // every level comes from the encoder, so there is nothing left for generateMipmap to do
+    buffer->bind(GL_PIXEL_UNPACK_BUFFER);
+    for (size_t l = 0; l < image.levels.size(); ++l)
+    {
+        const auto& level = image.levels[l];
+        tex->compressedImage2D(static_cast<GLint>(l), internalFormat, level.width, level.height, 0,
+            static_cast<GLsizei>(level.size), reinterpret_cast<const void*>(level.offset));
+    }
+    globjects::Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+
+    tex->setParameter(GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size() - 1));
+    if (image.grayscale)
+    {
+        tex->setParameter(GL_TEXTURE_SWIZZLE_G, GL_RED);
+        tex->setParameter(GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    setTextureParameters(tex);
+
+    return tex;
+}
+
+void ModelLoadingStage::setTextureParameters(globjects::Texture* tex) const
+{
     tex->setParameter(GL_TEXTURE_WRAP_R, GL_REPEAT);
     tex->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
     tex->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
     tex->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     tex->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     tex->setParameter(GL_TEXTURE_MAX_ANISOTROPY_EXT, m_maxAnisotropy);
-    tex->generateMipmap();
-
-    return tex;
 }
 
-Material ModelLoadingStage::loadMaterial(aiMaterial* aiMat, const std::string& directory)
+MaterialDescription ModelLoadingStage::describeMaterial(aiMaterial* aiMat, const std::string& directory) const
 {
-    Material material;
+    MaterialDescription description;
 
     for (aiTextureType aiTexType : textureTypes)
     {
@@ -140,7 +1275,7 @@ Material ModelLoadingStage::loadMaterial(aiMaterial* aiMat, const std::string& d
         aiReturn ret = aiMat->Get(AI_MATKEY_SHININESS, specularFactor);
         if (ret == aiReturn_SUCCESS)
         {
-            material.specularFactor = specularFactor;
+            description.specularFactor = specularFactor;
         }
 
         aiString texPath;
@@ -149,59 +1284,69 @@ Material ModelLoadingStage::loadMaterial(aiMaterial* aiMat, const std::string& d
         if (ret != aiReturn_SUCCESS)
             continue;
 
-        std::string texPathStd = std::string(texPath.C_Str());
-        auto path = directory + "/" + texPathStd;
-        std::replace(path.begin(), path.end(), '\\', '/');
+        description.texturePaths[type] = resolveTexturePath(directory, texPath.C_Str());
+    }
 
-        globjects::ref_ptr<globjects::Texture> texture = nullptr;
-        auto textureIt = m_textures.find(path);
-        if (textureIt != m_textures.end())
+    return description;
+}
+
+void ModelLoadingStage::benchmarkObjParser() const
+{
+    for (auto preset : { Preset::CrytekSponza, Preset::SanMiguel, Preset::DabrovicSponza, Preset::Imrod, Preset::Jakobi, Preset::Megacity, Preset::Mitusba, Preset::Transparency })
+    {
+        std::string filename;
+        getPresetInformation(preset, filename);
+        if (!std::ifstream(filename))
         {
-            texture = (*textureIt).second;
+            std::cout << "Skipping missing " << filename << std::endl;
+            continue;
         }
-        else
+
+        // both sides run up to the converted geometries and material descriptions, everything after is shared
+        auto dir = getDirectory(filename);
+        std::vector<MaterialDescription> materials;
+        std::vector<std::unique_ptr<gloperate::PolygonalGeometry>> geometries;
+
+        auto nativeStart = std::chrono::steady_clock::now();
+        ObjParser parser;
+        bool parsed = parser.load(filename);
+        if (parsed)
         {
-            texture = loadTexture(path);
-            m_textures[path] = texture;
+            for (const auto& material : parser.materials())
+                materials.push_back(describeObjMaterial(material, dir));
+            for (auto& mesh : parser.meshes())
+                geometries.push_back(convertObjMesh(mesh, 1.0f));
         }
+        auto nativeTime = millisecondsSince(nativeStart);
 
-        material.addTexture(type, texture);
-    }
+        materials.clear();
+        geometries.clear();
 
-    return material;
-}
-
-PresetInformation ModelLoadingStage::getPresetInformation(Preset preset)
-{
-    static const std::map<Preset, PresetInformation> conversion {
-        //                          camera eye             camera center          near;far         light position       light center     light radius   ground color   ground height  alpha   bump mapping type  reflections  zThickness  focalDist  focalRadius vertex scale
-        { Preset::Imrod,          { { -10.0, 31.2, 10.65 },{ 30, 5.5, -30.0 },    { 0.3, 50000.0 }, { 0, 52, 0 },       { 0, 0, 0 },     1.0f,          { 1, 1, 1 },   0.0f,         1.0f,   BumpType::Normal,  true,        3.0f,       30.0f,     0.003f,     1.0f } },
-        { Preset::SanMiguel,      { { -0.83, 1.9, 21.6 },  { -9.7, -0.85, 4.75 }, { 0.05, 50.0 },   {-1.5, 27.4, 15 },  { -7, 11, 15 },  0.15f,         { 1, 1, 1 },  -0.10f,        1.0f,   BumpType::Height,  true,        0.30f,      9.0f,      0.003f,     1.0f } },
-        { Preset::CrytekSponza,   { { -13, 2.5, -0.23 },   { 0.009, -0.019, -0.021 },{ 0.05, 50.0 },{ 4.5, 2.7, -0.3 }, { -0.5, 14, 0 }, 0.15f,         { 1, 1, 1 },  -0.10f,        1.0f,   BumpType::Height,  true,        0.30f,      9.0f,      0.003f,     0.01f } },
-        { Preset::DabrovicSponza, { { -10.0, 12.6, 0.9 },  { 3.2, 0.28, -1.82 },  { 0.3, 500.0 },   { 0, 18, 0 },       { 0, 0, 0 },     1.0f,          { 1, 1, 1 },   0.0f,         1.0f,   BumpType::Height,  false,       0.0f,       15.0f,     0.003f,     1.0f } },
-        { Preset::Jakobi,         { { 0.39, 0.49, -0.63 }, { 0.05, -0.04, -0.1 }, { 0.01, 80.0 },   { -0.4, 1.2, -0.7 },{ 0, 0, 0 },     0.05f,         { 1, 1, 1 },  -0.115f,       1.0f,   BumpType::None,    true,        0.05f,      0.5f,      0.003f,     1.0f } },
-        { Preset::Megacity,       { { 0.26, 0.23, -0.35 }, { 0.14, 0.0, -0.14 },  { 0.01, 80.0 },   { -0.4, 1.2, -1.5 },{ 0, 0, 0 },     0.01f,         { 1, 1, 1 },  -0.048f,       1.0f,   BumpType::None,    true,        0.05f,      0.5f,      0.003f,     1.0f } },
-        { Preset::Mitusba,        { { 0.2, 3.7, 4.3 },     { 0.16, 0.07, -1.25 }, { 0.3, 600.0 },   { 10, 20, 0 },      { 0, 0, 0 },     0.7f,          { 1, 1, 1 },   0.1f,         0.5f,   BumpType::None,    false,       0.0f,       7.0f,      0.003f,     1.0f } },
-        { Preset::Transparency,   { { -1.9, 4.2, 4.6 },    { -0.06, 0.02, 0.56 }, { 0.3, 600.0 },   { 0, 5, 0 },        { 0, 0, 0 },     0.1f,          { 1, 1, 1 },  -1.4f,         0.5f,   BumpType::None,    false,       0.0f,       4.0f,      0.003f,     1.0f } }
-    };
+        auto assimpStart = std::chrono::steady_clock::now();
+        auto assimpScene = aiImportFile(filename.c_str(), postProcessFlags);
+        if (assimpScene)
+        {
+            for (unsigned int m = 0; m < assimpScene->mNumMaterials; m++)
+                materials.push_back(describeMaterial(assimpScene->mMaterials[m], dir));
+            for (unsigned int i = 0; i < assimpScene->mNumMeshes; i++)
+                geometries.push_back(convertGeometry(assimpScene->mMeshes[i], 1.0f));
+        }
+        auto assimpTime = millisecondsSince(assimpStart);
+        if (assimpScene)
+            aiReleaseImport(assimpScene);
 
-    return conversion.at(preset);
+        std::cout << filename << ": native OBJ parser " << nativeTime << " ms" << (parsed ? "" : " (failed)")
+            << ", assimp " << assimpTime << " ms" << (assimpScene ? "" : " (failed)")
+            << ", speed-up " << assimpTime / std::max(nativeTime, 0.001) << "x" << std::endl;
+    }
 }
 
-std::string ModelLoadingStage::getFilename(Preset preset)
+PresetInformation ModelLoadingStage::getPresetInformation(Preset preset, std::string& modelFilename)
 {
-    static const std::map<Preset, std::string> conversion {
-        { Preset::Imrod, "data/Imrod/Imrod.obj" },
-        { Preset::SanMiguel, "data/sanmiguel/sanMiguel.obj" },
-        { Preset::CrytekSponza, "data/crytek-sponza/sponza.obj" },
-        { Preset::DabrovicSponza, "data/dabrovic-sponza/sponza.obj" },
-        { Preset::Jakobi, "data/jakobi/jakobikirchplatz4.obj" },
-        { Preset::Megacity, "data/megacity/simple2.obj" },
-        { Preset::Mitusba, "data/mitsuba/mitsuba.obj" },
-        { Preset::Transparency, "data/transparency_scene.obj" }
-    };
-
-    return conversion.at(preset);
+    auto information = defaultPresets.at(preset);
+    modelFilename = defaultFilenames.at(preset);
+    readPresetFile(preset, information, modelFilename);
+    return information;
 }
 
 std::unique_ptr<gloperate::PolygonalGeometry> ModelLoadingStage::convertGeometry(const aiMesh * mesh, float vertexScale) const
@@ -252,19 +1397,39 @@ std::unique_ptr<gloperate::PolygonalGeometry> ModelLoadingStage::convertGeometry
 
     return geometry;
 }
+
 const Preset& ModelLoadingStage::getCurrentPreset() const
 {
-    return m_currentPreset;
+    static const Preset none = Preset::None;
+    return m_scene ? m_scene->preset : none;
 }
 const PresetInformation& ModelLoadingStage::getCurrentPresetInformation() const
 {
-    return *m_currentPresetInformation.get();
+    return *m_scene->presetInformation.get();
 }
-const IdDrawablesMap& ModelLoadingStage::getDrawablesMap() const
+const SceneGeometry& ModelLoadingStage::getSceneGeometry() const
 {
-    return *m_drawablesMap.get();
+    return *m_scene->geometry.get();
+}
+SceneGeometry& ModelLoadingStage::getSceneGeometry()
+{
+    return *m_scene->geometry.get();
 }
 const IdMaterialMap& ModelLoadingStage::getMaterialMap() const
 {
-    return *m_materialMap.get();
+    return *m_scene->materialMap.get();
+}
+unsigned int ModelLoadingStage::getSceneVersion() const
+{
+    return m_sceneVersion;
+}
+
+MaterialTable& ModelLoadingStage::getMaterialTable()
+{
+    if (m_materialTableVersion != m_sceneVersion)
+    {
+        m_scene->materialTable->update(*m_scene->materialMap, *m_scene->geometry);
+        m_materialTableVersion = m_sceneVersion;
+    }
+    return *m_scene->materialTable;
 }
@@ -1,29 +1,37 @@
 #pragma once
 
+#include <list>
 #include <vector>
 #include <memory>
 
 #include "TypeDefinitions.h"
 #include "Preset.h"
 #include "Material.h"
+#include "MeshCache.h"
 
 namespace globjects
 {
+    class Buffer;
     class Texture;
 }
 
 namespace gloperate
 {
     class PolygonalGeometry;
-    class Drawable;
     class ResourceManager;
     class Scene;
 }
 
+class MaterialTable;
+class SceneGeometry;
+
 class aiMesh;
 class aiScene;
 class aiMaterial;
 
+struct RawImage;
+struct CompressedImage;
+
 class ModelLoadingStage
 {
 public:
@@ -31,32 +39,73 @@ public:
     ~ModelLoadingStage();
 
     gloperate::ResourceManager* resourceManager;
-
+    bool useCompactVertices; // vertex layout of the first scene, later scenes keep it since the programs are built for it
+    bool useTextureCompression; // read when a scene's textures are loaded
+    bool useNativeObjParser; // parses obj files without assimp, read when a scene is loaded
+    bool useBindlessTextures; // if supported, decided by the first scene like the vertex layout
+    unsigned int maxResidentScenes; // recently used scenes kept on the GPU besides the current one
+    size_t residentSceneBudget; // bytes all resident scenes including the current one may occupy
+
+    // blocks until the whole scene is resident
     void loadScene(Preset preset);
 
+    // streaming alternative to loadScene: import and texture decoding run in the background,
+    // processPending adds finished meshes and textures to the loading scene until timeBudget (ms) is used up.
+    // The first scene renders while it streams in, later ones replace the current scene once they are complete.
+    // Switching to a scene that is still resident is instant.
+    void startLoading(Preset preset);
+    void processPending(double timeBudget);
+    bool isLoading() const;
+
+    // times the import up to converted geometries and materials with the native OBJ parser and with assimp
+    // for every preset, blocks until done
+    void benchmarkObjParser() const;
+
     const Preset& getCurrentPreset() const;
     const PresetInformation& getCurrentPresetInformation() const;
-    const IdDrawablesMap& getDrawablesMap() const;
+    const SceneGeometry& getSceneGeometry() const;
+    SceneGeometry& getSceneGeometry();
     const IdMaterialMap& getMaterialMap() const;
+    // changes whenever materials, textures or meshes of the current scene change, or another scene becomes current
+    unsigned int getSceneVersion() const;
+    // brought up to date with the current scene's materials and meshes on access
+    MaterialTable& getMaterialTable();
 
 
 protected:
     using StringTextureMap = std::map<std::string, globjects::ref_ptr<globjects::Texture>>;
+    struct DecodedTexture;
+    struct LoadingState;
+    struct ResidentScene;
 
     float m_maxAnisotropy;
-    StringTextureMap m_textures;
+    std::vector<globjects::ref_ptr<globjects::Buffer>> m_pixelUnpackBuffers;
+    size_t m_nextPixelUnpackBuffer;
+    unsigned int m_sceneVersion;
+    unsigned int m_materialTableVersion; // scene version the current scene's material table was updated for
+
 
+    void cancelLoading();
+    void finishLoading();
+    void makeCurrent(std::unique_ptr<ResidentScene> scene);
+    void evictResidentScenes();
+    void addTexture(LoadingState& state, const DecodedTexture& texture);
+    void loadInBackground(LoadingState& state, const std::string& modelFilename, float vertexScale) const;
+    void decodeTextures(LoadingState& state, const std::vector<MaterialDescription>& materials) const;
 
     globjects::ref_ptr<globjects::Texture> loadTexture(const std::string& filename) const;
-    Material loadMaterial(aiMaterial* mat, const std::string& directory);
+    globjects::ref_ptr<globjects::Texture> uploadTexture(const RawImage& image);
+    globjects::ref_ptr<globjects::Texture> uploadCompressedTexture(const CompressedImage& image);
+    globjects::Buffer* stagePixels(const void* data, size_t size);
+    void setTextureParameters(globjects::Texture* tex) const;
+    MaterialDescription describeMaterial(aiMaterial* mat, const std::string& directory) const;
     std::unique_ptr<gloperate::PolygonalGeometry> convertGeometry(const aiMesh * mesh, float vertexScale) const;
 
-    static PresetInformation getPresetInformation(Preset preset);
-    static std::string getFilename(Preset preset);
+    // the built-in preset with the overrides of data/presets.txt, which is read once per call
+    static PresetInformation getPresetInformation(Preset preset, std::string& modelFilename);
 
 
-    Preset m_currentPreset;
-    std::unique_ptr<PresetInformation> m_currentPresetInformation;
-    std::unique_ptr<IdDrawablesMap> m_drawablesMap;
-    std::unique_ptr<IdMaterialMap> m_materialMap;
+    std::unique_ptr<ResidentScene> m_scene;
+    std::list<std::unique_ptr<ResidentScene>> m_residentScenes; // most recently used first
+    std::unique_ptr<LoadingState> m_loading;
 };
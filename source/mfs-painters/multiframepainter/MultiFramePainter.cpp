@@ -24,11 +24,13 @@
 #include "ModelLoadingStage.h"
 #include "KernelGenerationStage.h"
 #include "RasterizationStage.h"
+#include "HiZStage.h"
 #include "GIStage.h"
 #include "DeferredShadingStage.h"
 #include "SSAOStage.h"
 #include "BlitStage.h"
 #include "PerfCounter.h"
+#include "MemoryRegistry.h"
 #include "ImperfectShadowmap.h"
 #include "ClusteredShading.h"
 #include "VPLProcessor.h"
@@ -43,7 +45,9 @@ MultiFramePainter::MultiFramePainter(ResourceManager & resourceManager, const cp
 : Painter("MultiFramePainter", resourceManager, moduleInfo)
 , resourceManager(resourceManager)
 , preset(Preset::CrytekSponza)
+, m_displayedPreset(Preset::None)
 , m_useFullHD(false)
+, m_sceneLoadingBudget(4.0f)
 {
     // Setup painter
     m_targetFramebufferCapability = addCapability(new gloperate::TargetFramebufferCapability());
@@ -56,6 +60,7 @@ MultiFramePainter::MultiFramePainter(ResourceManager & resourceManager, const cp
     modelLoadingStage = std::make_unique<ModelLoadingStage>();
     kernelGenerationStage = std::make_unique<KernelGenerationStage>();
     rasterizationStage = std::make_unique<RasterizationStage>("GBuffer", *modelLoadingStage, *kernelGenerationStage, false);
+    hiZStage = std::make_unique<HiZStage>("Hi-Z");
     giStage = std::make_unique<GIStage>(*modelLoadingStage, *kernelGenerationStage);
     ssaoStage = std::make_unique<SSAOStage>(*kernelGenerationStage, *modelLoadingStage);
     deferredShadingStage = std::make_unique<DeferredShadingStage>();
@@ -94,6 +99,68 @@ void MultiFramePainter::onInitialize()
 
     });
 
+    this->addProperty<float>("SceneLoadingBudget",
+        [this]() { return m_sceneLoadingBudget; },
+        [this](const float & budget) {
+            m_sceneLoadingBudget = budget;
+        }
+    )->setOptions({
+        { "minimum", 0.5f },
+        { "maximum", 100.0f },
+        { "step", 0.5f },
+        { "precision", 1u },
+    });
+
+    // the current scene keeps rendering while the new one loads in the background
+    this->addProperty<Preset>("Preset",
+        [this]() { return preset; },
+        [this](const Preset & value) {
+            preset = value;
+            modelLoadingStage->startLoading(preset);
+    });
+
+    this->addProperty<int>("ResidentScenes",
+        [this]() { return static_cast<int>(modelLoadingStage->maxResidentScenes); },
+        [this](const int & value) {
+            modelLoadingStage->maxResidentScenes = static_cast<unsigned int>(value);
+        }
+    )->setOptions({
+        { "minimum", 0 },
+        { "maximum", 7 },
+    });
+
+    this->addProperty<int>("ResidentSceneBudgetMB",
+        [this]() { return static_cast<int>(modelLoadingStage->residentSceneBudget / (1024 * 1024)); },
+        [this](const int & value) {
+            modelLoadingStage->residentSceneBudget = static_cast<size_t>(value) * 1024 * 1024;
+        }
+    )->setOptions({
+        { "minimum", 0 },
+        { "maximum", 32768 },
+    });
+
+    this->addProperty<bool>("UseNativeObjParser",
+        [this]() { return modelLoadingStage->useNativeObjParser; },
+        [this](const bool & value) {
+            modelLoadingStage->useNativeObjParser = value;
+    });
+
+    // acts as a button, the benchmark runs synchronously and prints its results
+    this->addProperty<bool>("BenchmarkObjParser",
+        []() { return false; },
+        [this](const bool & value) {
+            if (value)
+                modelLoadingStage->benchmarkObjParser();
+    });
+
+    // acts as a button, prints every registered allocation
+    this->addProperty<bool>("PrintMemoryUsage",
+        []() { return false; },
+        [](const bool & value) {
+            if (value)
+                std::cout << MemoryRegistry::generateDetailedString() << std::flush;
+    });
+
     gloperate::registerNamedStrings("data/shaders", "glsl", true);
 
     // disable debug group console output
@@ -102,21 +169,29 @@ void MultiFramePainter::onInitialize()
 
     kernelGenerationStage->initialize();
 
-    modelLoadingStage->loadScene(preset);
+    // the first frames render while the scene streams in, see onPaint
+    modelLoadingStage->startLoading(preset);
 
     rasterizationStage->projection = m_projectionCapability;
     rasterizationStage->camera = m_cameraCapability;
     rasterizationStage->viewport = m_virtualViewportCapability;
     rasterizationStage->useDOF = useDOF;
+    rasterizationStage->hiZStage = hiZStage.get();
     rasterizationStage->initialize();
     rasterizationStage->initProperties(*this);
     rasterizationStage->loadPreset(modelLoadingStage->getCurrentPresetInformation());
+    m_displayedPreset = preset;
+
+    hiZStage->viewport = m_virtualViewportCapability;
+    hiZStage->depthBuffer = rasterizationStage->depthBuffer;
+    hiZStage->initialize();
 
     giStage->viewport = m_virtualViewportCapability;
     giStage->camera = m_cameraCapability;
     giStage->projection = m_projectionCapability;
     giStage->faceNormalBuffer = rasterizationStage->faceNormalBuffer;
     giStage->depthBuffer = rasterizationStage->depthBuffer;
+    giStage->hiZBuffer = hiZStage->hiZBuffer;
     giStage->initialize();
     giStage->initProperties(*this);
 
@@ -156,6 +231,7 @@ void MultiFramePainter::onInitialize()
         rasterizationStage->normalBuffer,
         rasterizationStage->faceNormalBuffer,
         rasterizationStage->depthBuffer,
+        hiZStage->hiZBuffer,
         giStage->rsmRenderer->diffuseBuffer,
         giStage->rsmRenderer->specularBuffer,
         giStage->rsmRenderer->normalBuffer,
@@ -164,8 +240,7 @@ void MultiFramePainter::onInitialize()
         giStage->rsmRenderer->depthBuffer,
         giStage->ism->depthBuffer,
         giStage->ism->softrenderBuffer,
-        giStage->ism->pullBuffer,
-        giStage->ism->pushBuffer,
+        giStage->ism->pullPushPyramid,
         giStage->ism->pushPullResultBuffer,
         giStage->clusteredShading->lightLists,
         giStage->giBuffer,
@@ -181,6 +256,16 @@ void MultiFramePainter::onInitialize()
 
 void MultiFramePainter::onPaint()
 {
+    modelLoadingStage->processPending(m_sceneLoadingBudget);
+
+    // a scene that finished loading in the background (or a resident one) replaced the current scene
+    if (modelLoadingStage->getCurrentPreset() != m_displayedPreset)
+    {
+        m_displayedPreset = modelLoadingStage->getCurrentPreset();
+        rasterizationStage->loadPreset(modelLoadingStage->getCurrentPresetInformation());
+        giStage->loadPreset(modelLoadingStage->getCurrentPresetInformation());
+    }
+
     if (!m_useFullHD && m_viewportCapability->hasChanged()) {
         m_virtualViewportCapability->setViewport(0, 0, m_viewportCapability->width(), m_viewportCapability->height());
     }
@@ -189,6 +274,10 @@ void MultiFramePainter::onPaint()
     AutoGLPerfCounter c("GBuffer");
     rasterizationStage->process();
     }
+    {
+    AutoGLPerfCounter c("Hi-Z");
+    hiZStage->process();
+    }
     giStage->process();
     ssaoStage->process();
     deferredShadingStage->process();
@@ -203,4 +292,9 @@ void MultiFramePainter::onPaint()
 std::string MultiFramePainter::getPerfCounterString() const
 {
     return PerfCounter::generateString();
+}
+
+std::string MultiFramePainter::getMemoryString() const
+{
+    return MemoryRegistry::generateString();
 }
\ No newline at end of file
@@ -23,6 +23,7 @@ namespace gloperate
 class ModelLoadingStage;
 class KernelGenerationStage;
 class RasterizationStage;
+class HiZStage;
 class GIStage;
 class DeferredShadingStage;
 class SSAOStage;
@@ -37,6 +38,7 @@ public:
 
     // Viewer.cpp can't access PerfCounter::generateString(), probably because different compilation unit
     std::string getPerfCounterString() const;
+    std::string getMemoryString() const;
 
     gloperate::ResourceManager& resourceManager;
     Preset preset;
@@ -59,10 +61,13 @@ protected:
     std::unique_ptr<ModelLoadingStage> modelLoadingStage;
     std::unique_ptr<KernelGenerationStage> kernelGenerationStage;
     std::unique_ptr<RasterizationStage> rasterizationStage;
+    std::unique_ptr<HiZStage> hiZStage;
     std::unique_ptr<GIStage> giStage;
     std::unique_ptr<SSAOStage> ssaoStage;
     std::unique_ptr<DeferredShadingStage> deferredShadingStage;
     std::unique_ptr<BlitStage> blitStage;
 
+    Preset m_displayedPreset; // the stages are set up for it, differs from preset while a scene loads
     bool m_useFullHD;
+    float m_sceneLoadingBudget; // milliseconds per frame spent on uploading streamed scene data
 };
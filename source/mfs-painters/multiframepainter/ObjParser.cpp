@@ -0,0 +1,604 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+#include "MappedFile.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    // chunks are small enough to balance between threads and large enough to amortize the merge
+    const size_t chunkSize = 4 * 1024 * 1024;
+
+    // a reference to a vertex attribute, either 0 based into the whole file or, for negative
+    // (relative) obj indices, relative to the start of the chunk and biased by chunkRelative;
+    // those may point into earlier chunks and are resolved once all chunk sizes are known
+    using Reference = int64_t;
+    const Reference noReference = std::numeric_limits<Reference>::min();
+    const Reference chunkRelative = Reference(1) << 62;
+
+    struct Corner
+    {
+        Reference position;
+        Reference textureCoordinate;
+        Reference normal;
+    };
+
+    struct CornerKey
+    {
+        int64_t position;
+        int64_t textureCoordinate;
+        int64_t normal;
+
+        bool operator==(const CornerKey& other) const
+        {
+            return position == other.position && textureCoordinate == other.textureCoordinate && normal == other.normal;
+        }
+    };
+
+    struct CornerKeyHash
+    {
+        size_t operator()(const CornerKey& key) const
+        {
+            auto hash = static_cast<uint64_t>(key.position) * 0x9E3779B97F4A7C15ull;
+            hash ^= static_cast<uint64_t>(key.textureCoordinate) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+            hash ^= static_cast<uint64_t>(key.normal) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    // minimal cursor over the mapped text, none of the parsing depends on the locale
+    class Cursor
+    {
+    public:
+        Cursor(const char* begin, const char* end)
+        : m_position(begin), m_end(end)
+        {}
+
+        bool atEnd() const { return m_position >= m_end; }
+        bool atLineEnd() const { return m_position >= m_end || *m_position == '\n' || *m_position == '\r'; }
+        char peek() const { return m_position < m_end ? *m_position : '\0'; }
+        void advance() { ++m_position; }
+
+        void skipSpaces()
+        {
+            while (m_position < m_end && (*m_position == ' ' || *m_position == '\t'))
+                ++m_position;
+        }
+
+        void skipLine()
+        {
+            while (m_position < m_end && *m_position != '\n')
+                ++m_position;
+            if (m_position < m_end)
+                ++m_position;
+        }
+
+        std::string word()
+        {
+            skipSpaces();
+            auto begin = m_position;
+            while (m_position < m_end && !std::isspace(static_cast<unsigned char>(*m_position)))
+                ++m_position;
+            return std::string(begin, m_position);
+        }
+
+        // rest of the line without surrounding whitespace
+        std::string rest()
+        {
+            skipSpaces();
+            auto begin = m_position;
+            while (!atLineEnd())
+                ++m_position;
+            auto end = m_position;
+            while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+                --end;
+            return std::string(begin, end);
+        }
+
+        float parseFloat()
+        {
+            skipSpaces();
+
+            bool negative = false;
+            if (peek() == '-' || peek() == '+')
+            {
+                negative = peek() == '-';
+                advance();
+            }
+
+            double value = 0.0;
+            while (std::isdigit(static_cast<unsigned char>(peek())))
+            {
+                value = value * 10.0 + (peek() - '0');
+                advance();
+            }
+
+            if (peek() == '.')
+            {
+                advance();
+                double scale = 0.1;
+                while (std::isdigit(static_cast<unsigned char>(peek())))
+                {
+                    value += (peek() - '0') * scale;
+                    scale *= 0.1;
+                    advance();
+                }
+            }
+
+            if (peek() == 'e' || peek() == 'E')
+            {
+                advance();
+                bool negativeExponent = false;
+                if (peek() == '-' || peek() == '+')
+                {
+                    negativeExponent = peek() == '-';
+                    advance();
+                }
+                int exponent = 0;
+                while (std::isdigit(static_cast<unsigned char>(peek())))
+                {
+                    exponent = exponent * 10 + (peek() - '0');
+                    advance();
+                }
+                value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+            }
+
+            return static_cast<float>(negative ? -value : value);
+        }
+
+        // returns false if there is no number
+        bool parseInteger(int64_t& value)
+        {
+            bool negative = false;
+            if (peek() == '-' || peek() == '+')
+            {
+                negative = peek() == '-';
+                advance();
+            }
+            if (!std::isdigit(static_cast<unsigned char>(peek())))
+                return false;
+
+            value = 0;
+            while (std::isdigit(static_cast<unsigned char>(peek())))
+            {
+                value = value * 10 + (peek() - '0');
+                advance();
+            }
+            if (negative)
+                value = -value;
+            return true;
+        }
+
+    protected:
+        const char* m_position;
+        const char* m_end;
+    };
+
+    Reference makeReference(int64_t objIndex, size_t localCount)
+    {
+        if (objIndex > 0)
+            return objIndex - 1;
+        if (objIndex < 0)
+            return chunkRelative + static_cast<int64_t>(localCount) + objIndex;
+        return noReference;
+    }
+
+    Reference resolve(Reference reference, size_t chunkOffset)
+    {
+        if (reference == noReference || reference < chunkRelative / 2)
+            return reference;
+        return static_cast<Reference>(chunkOffset) + (reference - chunkRelative);
+    }
+
+    std::string directoryOf(const std::string& path)
+    {
+        auto found = path.find_last_of("/\\");
+        return found == std::string::npos ? std::string(".") : path.substr(0, found);
+    }
+}
+
+struct ObjParser::Chunk
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> textureCoordinates;
+    std::vector<glm::vec3> normals;
+    std::vector<Corner> corners; // three per triangle
+
+    // usemtl statements, as the triangle they apply from and the material name
+    std::vector<std::pair<size_t, std::string>> materialChanges;
+    std::vector<std::string> materialLibraries;
+
+    size_t positionOffset;
+    size_t textureCoordinateOffset;
+    size_t normalOffset;
+};
+
+ObjParser::Material::Material()
+: shininess(0.0f)
+{
+}
+
+ObjParser::ObjParser()
+{
+}
+
+ObjParser::~ObjParser()
+{
+}
+
+bool ObjParser::load(const std::string& filename)
+{
+    m_error.clear();
+    m_materials.clear();
+    m_meshes.clear();
+
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        m_error = "could not open " + filename;
+        return false;
+    }
+
+    // line aligned chunk boundaries
+    std::vector<const char*> boundaries;
+    auto end = file.data() + file.size();
+    boundaries.push_back(file.data());
+    while (boundaries.back() < end)
+    {
+        auto boundary = boundaries.back() + std::min(chunkSize, static_cast<size_t>(end - boundaries.back()));
+        while (boundary < end && boundary[-1] != '\n')
+            ++boundary;
+        boundaries.push_back(boundary);
+    }
+
+    std::vector<Chunk> chunks(boundaries.size() - 1);
+    parallelFor(chunks.size(), [&](size_t c)
+    {
+        auto& chunk = chunks[c];
+        Cursor cursor(boundaries[c], boundaries[c + 1]);
+        std::vector<Corner> polygon;
+
+        while (!cursor.atEnd())
+        {
+            cursor.skipSpaces();
+            if (cursor.atLineEnd())
+            {
+                cursor.skipLine();
+                continue;
+            }
+
+            auto first = cursor.peek();
+            cursor.advance();
+            auto second = cursor.peek();
+
+            if (first == 'v' && (second == ' ' || second == '\t'))
+            {
+                auto x = cursor.parseFloat();
+                auto y = cursor.parseFloat();
+                auto z = cursor.parseFloat();
+                chunk.positions.push_back(glm::vec3(x, y, z));
+            }
+            else if (first == 'v' && second == 't')
+            {
+                cursor.advance();
+                auto u = cursor.parseFloat();
+                cursor.skipSpaces();
+                auto v = cursor.atLineEnd() ? 0.0f : cursor.parseFloat();
+                cursor.skipSpaces();
+                auto w = cursor.atLineEnd() ? 0.0f : cursor.parseFloat();
+                chunk.textureCoordinates.push_back(glm::vec3(u, v, w));
+            }
+            else if (first == 'v' && second == 'n')
+            {
+                cursor.advance();
+                auto x = cursor.parseFloat();
+                auto y = cursor.parseFloat();
+                auto z = cursor.parseFloat();
+                chunk.normals.push_back(glm::vec3(x, y, z));
+            }
+            else if (first == 'f' && (second == ' ' || second == '\t'))
+            {
+                polygon.clear();
+                while (true)
+                {
+                    cursor.skipSpaces();
+                    if (cursor.atLineEnd())
+                        break;
+
+                    int64_t index;
+                    if (!cursor.parseInteger(index))
+                        break;
+
+                    Corner corner;
+                    corner.position = makeReference(index, chunk.positions.size());
+                    corner.textureCoordinate = noReference;
+                    corner.normal = noReference;
+
+                    if (cursor.peek() == '/')
+                    {
+                        cursor.advance();
+                        if (cursor.parseInteger(index))
+                            corner.textureCoordinate = makeReference(index, chunk.textureCoordinates.size());
+                        if (cursor.peek() == '/')
+                        {
+                            cursor.advance();
+                            if (cursor.parseInteger(index))
+                                corner.normal = makeReference(index, chunk.normals.size());
+                        }
+                    }
+                    polygon.push_back(corner);
+                }
+
+                for (size_t i = 2; i < polygon.size(); ++i)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+            else if (first == 'u' && second == 's')
+            {
+                auto keyword = "u" + cursor.word();
+                if (keyword == "usemtl")
+                    chunk.materialChanges.push_back({ chunk.corners.size() / 3, cursor.rest() });
+            }
+            else if (first == 'm' && second == 't')
+            {
+                auto keyword = "m" + cursor.word();
+                if (keyword == "mtllib")
+                    chunk.materialLibraries.push_back(cursor.rest());
+            }
+
+            cursor.skipLine();
+        }
+    });
+
+    size_t positionOffset = 0, textureCoordinateOffset = 0, normalOffset = 0;
+    for (auto& chunk : chunks)
+    {
+        chunk.positionOffset = positionOffset;
+        chunk.textureCoordinateOffset = textureCoordinateOffset;
+        chunk.normalOffset = normalOffset;
+        positionOffset += chunk.positions.size();
+        textureCoordinateOffset += chunk.textureCoordinates.size();
+        normalOffset += chunk.normals.size();
+
+        for (const auto& library : chunk.materialLibraries)
+        {
+            if (!loadMaterialLibrary(directoryOf(filename) + "/" + library))
+                return false;
+        }
+    }
+
+    buildMeshes(chunks);
+    return true;
+}
+
+bool ObjParser::loadMaterialLibrary(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        m_error = "could not open material library " + filename;
+        return false;
+    }
+
+    static const std::map<std::string, TextureType> textureKeywords {
+        { "map_Kd", TextureType::Diffuse },
+        { "map_Ks", TextureType::Specular },
+        { "map_Ke", TextureType::Emissive },
+        { "map_bump", TextureType::Bump },
+        { "map_Bump", TextureType::Bump },
+        { "bump", TextureType::Bump },
+        { "map_d", TextureType::Opacity }
+    };
+
+    Cursor cursor(file.data(), file.data() + file.size());
+    Material* material = nullptr;
+
+    while (!cursor.atEnd())
+    {
+        auto keyword = cursor.word();
+
+        if (keyword == "newmtl")
+        {
+            m_materials.push_back(Material());
+            material = &m_materials.back();
+            material->name = cursor.rest();
+        }
+        else if (material && keyword == "Ns")
+        {
+            material->shininess = cursor.parseFloat();
+        }
+        else if (material && textureKeywords.count(keyword) > 0)
+        {
+            // texture options (-bm 0.5 ...) come before the file name
+            auto arguments = cursor.rest();
+            auto separator = arguments.find_last_of(" \t");
+            material->texturePaths[textureKeywords.at(keyword)] = separator == std::string::npos ? arguments : arguments.substr(separator + 1);
+        }
+
+        cursor.skipLine();
+    }
+
+    return true;
+}
+
+void ObjParser::buildMeshes(const std::vector<Chunk>& chunks)
+{
+    // like aiProcess_RemoveRedundantMaterials, materials that only differ in their name are joined
+    std::map<std::string, unsigned int> materialIndices;
+    for (unsigned int m = 0; m < m_materials.size(); ++m)
+    {
+        unsigned int same = 0;
+        while (m_materials[same].shininess != m_materials[m].shininess || m_materials[same].texturePaths != m_materials[m].texturePaths)
+            ++same;
+        materialIndices.insert({ m_materials[m].name, same });
+    }
+
+    // faces before any usemtl (or with an unknown material) get a default material
+    auto defaultMaterial = static_cast<unsigned int>(m_materials.size());
+    bool usesDefaultMaterial = false;
+
+    // triangles per material in file order, as chunk and triangle index
+    std::vector<std::vector<std::pair<size_t, size_t>>> materialTriangles(m_materials.size() + 1);
+    auto currentMaterial = defaultMaterial;
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        const auto& chunk = chunks[c];
+        auto numTriangles = chunk.corners.size() / 3;
+        size_t change = 0;
+        for (size_t t = 0; t < numTriangles; ++t)
+        {
+            while (change < chunk.materialChanges.size() && chunk.materialChanges[change].first <= t)
+            {
+                auto found = materialIndices.find(chunk.materialChanges[change].second);
+                currentMaterial = found != materialIndices.end() ? found->second : defaultMaterial;
+                ++change;
+            }
+            usesDefaultMaterial |= currentMaterial == defaultMaterial;
+            materialTriangles[currentMaterial].push_back({ c, t });
+        }
+        if (change < chunk.materialChanges.size())
+        {
+            auto found = materialIndices.find(chunk.materialChanges.back().second);
+            currentMaterial = found != materialIndices.end() ? found->second : defaultMaterial;
+        }
+    }
+
+    if (usesDefaultMaterial)
+    {
+        Material material;
+        material.name = "DefaultMaterial";
+        m_materials.push_back(material);
+    }
+
+    // and materials no face refers to are removed
+    std::vector<unsigned int> materialRemap(materialTriangles.size());
+    std::vector<Material> usedMaterials;
+    for (size_t m = 0; m < materialTriangles.size(); ++m)
+    {
+        materialRemap[m] = static_cast<unsigned int>(usedMaterials.size());
+        if (!materialTriangles[m].empty())
+            usedMaterials.push_back(m_materials[m]);
+    }
+    m_materials = std::move(usedMaterials);
+
+    size_t numPositions = 0, numTextureCoordinates = 0, numNormals = 0;
+    for (const auto& chunk : chunks)
+    {
+        numPositions += chunk.positions.size();
+        numTextureCoordinates += chunk.textureCoordinates.size();
+        numNormals += chunk.normals.size();
+    }
+
+    auto lookup = [&chunks](const std::vector<glm::vec3> Chunk::* pool, const size_t Chunk::* offset, Reference reference, size_t count) -> const glm::vec3*
+    {
+        if (reference < 0 || static_cast<size_t>(reference) >= count)
+            return nullptr;
+
+        // chunks are sorted by offset, find the one holding the reference
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), static_cast<size_t>(reference),
+            [offset](size_t value, const Chunk& chunk) { return value < chunk.*offset; });
+        const auto& chunk = *(it - 1);
+        return &(chunk.*pool)[static_cast<size_t>(reference) - chunk.*offset];
+    };
+
+    std::vector<Mesh> meshes(materialTriangles.size());
+    parallelFor(materialTriangles.size(), [&](size_t m)
+    {
+        const auto& triangles = materialTriangles[m];
+        auto& mesh = meshes[m];
+        mesh.materialIndex = materialRemap[m];
+        if (triangles.empty())
+            return;
+
+        std::unordered_map<CornerKey, unsigned int, CornerKeyHash> vertexIndices;
+        bool hasTextureCoordinates = false;
+        bool hasMissingNormals = false;
+        std::vector<bool> generatedNormal;
+
+        mesh.indices.reserve(triangles.size() * 3);
+        for (const auto& triangle : triangles)
+        {
+            const auto& chunk = chunks[triangle.first];
+            for (int k = 0; k < 3; ++k)
+            {
+                const auto& corner = chunk.corners[triangle.second * 3 + k];
+                CornerKey key;
+                key.position = resolve(corner.position, chunk.positionOffset);
+                key.textureCoordinate = resolve(corner.textureCoordinate, chunk.textureCoordinateOffset);
+                key.normal = resolve(corner.normal, chunk.normalOffset);
+
+                auto inserted = vertexIndices.insert({ key, static_cast<unsigned int>(mesh.vertices.size()) });
+                if (inserted.second)
+                {
+                    auto position = lookup(&Chunk::positions, &Chunk::positionOffset, key.position, numPositions);
+                    auto textureCoordinate = lookup(&Chunk::textureCoordinates, &Chunk::textureCoordinateOffset, key.textureCoordinate, numTextureCoordinates);
+                    auto normal = lookup(&Chunk::normals, &Chunk::normalOffset, key.normal, numNormals);
+
+                    mesh.vertices.push_back(position ? *position : glm::vec3(0.0f));
+                    mesh.textureCoordinates.push_back(textureCoordinate ? *textureCoordinate : glm::vec3(0.0f));
+                    mesh.normals.push_back(normal ? *normal : glm::vec3(0.0f));
+                    generatedNormal.push_back(normal == nullptr);
+                    hasTextureCoordinates |= textureCoordinate != nullptr;
+                    hasMissingNormals |= normal == nullptr;
+                }
+                mesh.indices.push_back(inserted.first->second);
+            }
+        }
+
+        if (!hasTextureCoordinates)
+            mesh.textureCoordinates.clear();
+
+        // vertices without a normal get the area weighted average of their faces
+        if (hasMissingNormals)
+        {
+            for (size_t t = 0; t < mesh.indices.size(); t += 3)
+            {
+                const auto& a = mesh.vertices[mesh.indices[t]];
+                auto faceNormal = glm::cross(mesh.vertices[mesh.indices[t + 1]] - a, mesh.vertices[mesh.indices[t + 2]] - a);
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (generatedNormal[mesh.indices[t + k]])
+                        mesh.normals[mesh.indices[t + k]] += faceNormal;
+                }
+            }
+            for (size_t v = 0; v < mesh.normals.size(); ++v)
+            {
+                auto length = glm::length(mesh.normals[v]);
+                if (generatedNormal[v] && length > 0.0f)
+                    mesh.normals[v] /= length;
+            }
+        }
+    });
+
+    for (auto& mesh : meshes)
+    {
+        if (!mesh.indices.empty())
+            m_meshes.push_back(std::move(mesh));
+    }
+}
+
+const std::string& ObjParser::error() const
+{
+    return m_error;
+}
+
+const std::vector<ObjParser::Material>& ObjParser::materials() const
+{
+    return m_materials;
+}
+
+std::vector<ObjParser::Mesh>& ObjParser::meshes()
+{
+    return m_meshes;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "Material.h"
+
+
+// Wavefront OBJ/MTL parser that parses line aligned chunks of the file in parallel.
+// Chunks are merged in file order, so the result does not depend on the thread count.
+// Like the assimp import it replaces, polygons are fan triangulated, identical position/uv/normal
+// tuples are joined, materials differing only in name are merged and unused ones removed, all faces
+// of a material end up in one mesh and missing normals are generated.
+class ObjParser
+{
+public:
+    struct Material
+    {
+        Material();
+
+        std::string name;
+        float shininess;
+        std::map<TextureType, std::string> texturePaths; // as written in the mtl file
+    };
+
+    struct Mesh
+    {
+        unsigned int materialIndex;
+        std::vector<unsigned int> indices;
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec3> textureCoordinates; // empty if no face of the mesh has them
+    };
+
+    ObjParser();
+    ~ObjParser();
+
+    bool load(const std::string& filename);
+
+    const std::string& error() const;
+    const std::vector<Material>& materials() const;
+    std::vector<Mesh>& meshes();
+
+protected:
+    struct Chunk;
+
+    bool loadMaterialLibrary(const std::string& filename);
+    void buildMeshes(const std::vector<Chunk>& chunks);
+
+    std::string m_error;
+    std::vector<Material> m_materials;
+    std::vector<Mesh> m_meshes;
+};
@@ -0,0 +1,156 @@
+#include "OcclusionCulling.h"
+
+#include <glm/vec2.hpp>
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/boolean.h>
+#include <glbinding/gl/functions.h>
+#include <glbinding/gl/bitfield.h>
+
+#include <globjects/Buffer.h>
+#include <globjects/Program.h>
+#include <globjects/Shader.h>
+#include <globjects/Texture.h>
+
+#include <gloperate/base/make_unique.hpp>
+#include <gloperate/painter/AbstractViewportCapability.h>
+
+#include "HiZStage.h"
+#include "MemoryRegistry.h"
+#include "SceneGeometry.h"
+
+
+using namespace gl;
+
+namespace
+{
+    const int cullingGroupSize = 64;
+
+    // bindings of occlusion_culling.comp
+    const GLuint inputCommandsBinding = 0;
+    const GLuint outputCommandsBinding = 1;
+    const GLuint meshBoundsBinding = 2;
+    const GLuint drawnInFirstPhaseBinding = 3;
+    const GLuint visibleCounterBinding = 4;
+}
+
+
+OcclusionCulling::OcclusionCulling(const std::string& name, gloperate::AbstractViewportCapability* viewport, HiZStage& hiZStage)
+: m_hiZStage(hiZStage)
+, m_drawnInFirstPhaseCapacity(0)
+, m_numVisible(0)
+, m_frame(0)
+, m_viewport(viewport)
+, m_hiZValid(false)
+, m_name(name)
+{
+    m_cullingProgram = new globjects::Program();
+    m_cullingProgram->attach(globjects::Shader::fromFile(GL_COMPUTE_SHADER, "data/shaders/culling/occlusion_culling.comp"));
+
+    m_firstPhase = gloperate::make_unique<DrawSelection>(m_name + " Occlusion Culling First Phase");
+    m_secondPhase = gloperate::make_unique<DrawSelection>(m_name + " Occlusion Culling Second Phase");
+
+    m_drawnInFirstPhase = new globjects::Buffer();
+    m_drawnInFirstPhase->setName(m_name + " Drawn In First Phase");
+
+    for (auto& counter : m_visibleCounters)
+    {
+        GLuint zero = 0;
+        counter = new globjects::Buffer();
+        counter->setName(m_name + " Visible Counter");
+        counter->setData(sizeof(GLuint), &zero, GL_STREAM_READ);
+        MemoryRegistry::registerBuffer("Occlusion Culling", counter, sizeof(GLuint));
+    }
+}
+
+OcclusionCulling::~OcclusionCulling()
+{
+    MemoryRegistry::unregister(m_drawnInFirstPhase.get());
+    for (auto& counter : m_visibleCounters)
+        MemoryRegistry::unregister(counter.get());
+}
+
+void OcclusionCulling::cullFirstPhase(const SceneGeometry& geometry, const DrawSelection& input, const glm::mat4& viewProjection)
+{
+    // the counter of the previous frame is done by now, the one of the frame before is reused
+    auto& previousCounter = m_visibleCounters[(m_frame + 1) % 2];
+    previousCounter->getSubData(0, sizeof(GLuint), &m_numVisible);
+
+    GLuint zero = 0;
+    m_visibleCounters[m_frame % 2]->clearData(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    m_viewProjection = viewProjection;
+
+    // a resized pyramid has to be built again before testing against it
+    auto viewportSize = glm::ivec2(m_viewport->width(), m_viewport->height());
+    if (viewportSize != m_hiZViewportSize)
+        m_hiZValid = false;
+
+    // the complete depth of the previous frame is tested from the view it was rendered with
+    cull(geometry, input, *m_firstPhase, false, m_hiZValid);
+}
+
+void OcclusionCulling::cullSecondPhase(const SceneGeometry& geometry, const DrawSelection& input)
+{
+    // the painter builds it again from the complete depth after this frame, with the same view
+    m_hiZStage.process();
+    m_hiZViewProjection = m_viewProjection;
+    m_hiZViewportSize = glm::ivec2(m_viewport->width(), m_viewport->height());
+    m_hiZValid = true;
+
+    cull(geometry, input, *m_secondPhase, true, true);
+    ++m_frame;
+}
+
+void OcclusionCulling::invalidate()
+{
+    m_hiZValid = false;
+}
+
+const DrawSelection& OcclusionCulling::firstPhase() const
+{
+    return *m_firstPhase;
+}
+
+const DrawSelection& OcclusionCulling::secondPhase() const
+{
+    return *m_secondPhase;
+}
+
+unsigned int OcclusionCulling::numVisible() const
+{
+    return m_numVisible;
+}
+
+void OcclusionCulling::cull(const SceneGeometry& geometry, const DrawSelection& input, DrawSelection& output, bool secondPhase, bool useHiZ)
+{
+    auto numCommands = geometry.numCommands();
+    output.reserve(numCommands);
+    if (numCommands == 0)
+        return;
+
+    if (m_drawnInFirstPhaseCapacity < geometry.numMeshes())
+    {
+        m_drawnInFirstPhaseCapacity = geometry.numMeshes();
+        m_drawnInFirstPhase->setData(static_cast<GLsizeiptr>(m_drawnInFirstPhaseCapacity * sizeof(GLuint)), nullptr, GL_DYNAMIC_COPY);
+        MemoryRegistry::registerBuffer("Occlusion Culling", m_drawnInFirstPhase, m_drawnInFirstPhaseCapacity * sizeof(GLuint));
+    }
+
+    input.commands()->bindBase(GL_SHADER_STORAGE_BUFFER, inputCommandsBinding);
+    output.commands()->bindBase(GL_SHADER_STORAGE_BUFFER, outputCommandsBinding);
+    geometry.cullingBounds()->bindBase(GL_SHADER_STORAGE_BUFFER, meshBoundsBinding);
+    m_drawnInFirstPhase->bindBase(GL_SHADER_STORAGE_BUFFER, drawnInFirstPhaseBinding);
+    m_visibleCounters[m_frame % 2]->bindBase(GL_SHADER_STORAGE_BUFFER, visibleCounterBinding);
+    m_hiZStage.hiZBuffer->bindActive(0);
+
+    m_cullingProgram->setUniform("hiZ", 0);
+    m_cullingProgram->setUniform("viewportSize", glm::ivec2(m_viewport->width(), m_viewport->height()));
+    m_cullingProgram->setUniform("numCommands", static_cast<GLuint>(numCommands));
+    m_cullingProgram->setUniform("secondPhase", secondPhase);
+    m_cullingProgram->setUniform("useHiZ", useHiZ);
+    m_cullingProgram->setUniform("viewProjection", m_viewProjection);
+    m_cullingProgram->setUniform("hiZViewProjection", m_hiZViewProjection);
+    m_cullingProgram->dispatchCompute(static_cast<GLuint>((numCommands + cullingGroupSize - 1) / cullingGroupSize), 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <globjects/base/ref_ptr.h>
+
+namespace globjects
+{
+    class Buffer;
+    class Program;
+    class Texture;
+}
+
+namespace gloperate
+{
+    class AbstractViewportCapability;
+}
+
+class DrawSelection;
+class HiZStage;
+class SceneGeometry;
+
+
+// Frustum and occlusion culling of the scene meshes on the GPU, in two phases per frame:
+// the first one draws the meshes that were not occluded in the depth of the previous frame,
+// the second one tests the others against the depth of the first and draws the disoccluded ones.
+// Both write one command per mesh into their own DrawSelection, so drawing them needs no readback.
+// Both test against the pyramid of the painter's HiZStage: the first phase against the one built from the previous
+// frame's complete depth, the second phase rebuilds it from the depth of the first in between.
+class OcclusionCulling
+{
+public:
+    OcclusionCulling(const std::string& name, gloperate::AbstractViewportCapability* viewport, HiZStage& hiZStage);
+    ~OcclusionCulling();
+
+    // input is the selection made on the CPU, it picks the levels of detail
+    void cullFirstPhase(const SceneGeometry& geometry, const DrawSelection& input, const glm::mat4& viewProjection);
+    // the depth buffer has to contain the meshes of the first phase
+    void cullSecondPhase(const SceneGeometry& geometry, const DrawSelection& input);
+    // for frames drawn without culling, the pyramid is then built from a view the first phase does not know
+    void invalidate();
+
+    const DrawSelection& firstPhase() const;
+    const DrawSelection& secondPhase() const;
+    // meshes drawn by both phases of the previous frame
+    unsigned int numVisible() const;
+
+protected:
+    void cull(const SceneGeometry& geometry, const DrawSelection& input, DrawSelection& output, bool secondPhase, bool useHiZ);
+
+    globjects::ref_ptr<globjects::Program> m_cullingProgram;
+    // shared with the painter, it builds the pyramid from the complete depth after the frame
+    HiZStage& m_hiZStage;
+
+    std::unique_ptr<DrawSelection> m_firstPhase;
+    std::unique_ptr<DrawSelection> m_secondPhase;
+    globjects::ref_ptr<globjects::Buffer> m_drawnInFirstPhase;
+    size_t m_drawnInFirstPhaseCapacity;
+    // written in turns, so reading the one of the previous frame does not wait for the current one
+    globjects::ref_ptr<globjects::Buffer> m_visibleCounters[2];
+    unsigned int m_numVisible;
+    unsigned int m_frame;
+
+    gloperate::AbstractViewportCapability* m_viewport;
+    bool m_hiZValid;
+    glm::mat4 m_viewProjection;
+    glm::mat4 m_hiZViewProjection;
+    glm::ivec2 m_hiZViewportSize;
+
+    std::string m_name;
+};
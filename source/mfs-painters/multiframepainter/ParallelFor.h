@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+// Calls body(i) for every i in [0, count) using all hardware threads, including the calling one.
+// Returns when all calls are done. Indices are handed out one at a time, so uneven workloads balance out.
+template <typename Body>
+void parallelFor(size_t count, Body body)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            body(i);
+    };
+
+    size_t numThreads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+}
@@ -27,11 +27,14 @@ namespace
 
     static std::unordered_map<std::string, ref_ptr<Query>> glTimerMap;
     static std::string runningGLQuery("");
+
+    static std::unordered_map<std::string, uint64_t> countMap;
+    static std::vector<std::string> orderedCountNames;
 }
 
 void PerfCounter::begin(const std::string & name)
 {
-    assert(timerMap.find(name) != timerMap.end());
+    assert(timerMap.find(name) == timerMap.end());
     timerMap[name] = gloperate::ChronoTimer();
 }
 
@@ -75,6 +78,14 @@ void PerfCounter::endGL(const std::string & name)
     glTimerMap[name]->end(GL_TIME_ELAPSED);
 }
 
+void PerfCounter::setCount(const std::string & name, uint64_t count)
+{
+    if (countMap.find(name) == countMap.end())
+        orderedCountNames.push_back(name);
+
+    countMap[name] = count;
+}
+
 std::string PerfCounter::generateString()
 {
     std::stringstream ss;
@@ -82,6 +93,8 @@ std::string PerfCounter::generateString()
 
     for (std::string name : orderedNames)
         ss << name << ": " << std::fixed << map[name] / 1000000.0 << "  ";
+    for (std::string name : orderedCountNames)
+        ss << name << ": " << countMap[name] << "  ";
     return ss.str();
 }
 
@@ -10,6 +10,8 @@ public:
     static void beginGL(const std::string & name);
     static void end(const std::string & name);
     static void endGL(const std::string & name);
+    // a per frame value listed after the timings, e.g. how many meshes a pass culled
+    static void setCount(const std::string & name, uint64_t count);
     static std::string generateString();
 
 protected:
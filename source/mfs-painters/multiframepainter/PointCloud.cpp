@@ -0,0 +1,314 @@
+#include "PointCloud.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "MappedFile.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    // increment whenever the file layout or the sampling changes
+    const uint32_t cacheVersion = 2;
+    const char cacheMagic[8] = { 'M', 'F', 'S', 'P', 'O', 'I', 'N', 'T' };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t targetNumPoints;
+        uint32_t numPoints;
+        float radius;
+    };
+
+    // candidates drawn per point of the target density
+    const float candidatesPerPoint = 4.0f;
+    // minimum distance between accepted points relative to the mean spacing sqrt(area per point),
+    // with four candidates per point dart throwing then accepts somewhat fewer points than the target
+    const float minimumDistanceFactor = 0.7f;
+
+    float triangleArea(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        return 0.5f * glm::length(glm::cross(b - a, c - a));
+    }
+
+    float packNormal(const glm::vec3& normal)
+    {
+        auto packed = glm::packUnorm4x8(glm::vec4(normal * 0.5f + 0.5f, 0.0f));
+        float result;
+        std::memcpy(&result, &packed, sizeof(result));
+        return result;
+    }
+
+    // cells of a uniform grid with the minimum distance as edge length, so only neighbouring cells hold conflicts
+    class DartGrid
+    {
+    public:
+        DartGrid(float cellSize)
+        : m_cellSize(cellSize)
+        {}
+
+        bool tryInsert(const glm::vec3& position)
+        {
+            auto cell = glm::floor(position / m_cellSize);
+            auto minimumSquared = m_cellSize * m_cellSize;
+            for (int z = -1; z <= 1; ++z)
+            {
+                for (int y = -1; y <= 1; ++y)
+                {
+                    for (int x = -1; x <= 1; ++x)
+                    {
+                        auto it = m_cells.find(key(cell + glm::vec3(x, y, z)));
+                        if (it == m_cells.end())
+                            continue;
+                        for (const auto& other : it->second)
+                        {
+                            auto d = other - position;
+                            if (glm::dot(d, d) < minimumSquared)
+                                return false;
+                        }
+                    }
+                }
+            }
+
+            m_cells[key(cell)].push_back(position);
+            return true;
+        }
+
+    protected:
+        static uint64_t key(const glm::vec3& cell)
+        {
+            auto x = static_cast<uint64_t>(static_cast<int64_t>(cell.x) & 0x1FFFFF);
+            auto y = static_cast<uint64_t>(static_cast<int64_t>(cell.y) & 0x1FFFFF);
+            auto z = static_cast<uint64_t>(static_cast<int64_t>(cell.z) & 0x1FFFFF);
+            return x | (y << 21) | (z << 42);
+        }
+
+        float m_cellSize;
+        std::unordered_map<uint64_t, std::vector<glm::vec3>> m_cells;
+    };
+
+    std::vector<glm::vec4> sampleMesh(const MeshCache::Mesh& mesh, const std::vector<float>& cumulativeArea, float areaPerPoint, unsigned int seed)
+    {
+        std::vector<glm::vec4> points;
+        if (cumulativeArea.empty() || cumulativeArea.back() <= 0.0f)
+            return points;
+
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+        // rounded randomly, so meshes smaller than a point still get one now and then
+        auto expectedCandidates = cumulativeArea.back() / areaPerPoint * candidatesPerPoint;
+        auto numCandidates = static_cast<size_t>(expectedCandidates + uniform(generator));
+
+        const auto* indices = mesh.indices + mesh.lodFirstIndex[0];
+        DartGrid grid(minimumDistanceFactor * std::sqrt(areaPerPoint));
+
+        for (size_t i = 0; i < numCandidates; ++i)
+        {
+            auto target = uniform(generator) * cumulativeArea.back();
+            auto triangle = static_cast<size_t>(std::upper_bound(cumulativeArea.begin(), cumulativeArea.end(), target) - cumulativeArea.begin());
+            triangle = std::min(triangle, cumulativeArea.size() - 1);
+
+            auto i0 = indices[3 * triangle];
+            auto i1 = indices[3 * triangle + 1];
+            auto i2 = indices[3 * triangle + 2];
+
+            // uniform barycentric coordinates
+            auto r = std::sqrt(uniform(generator));
+            auto s = uniform(generator);
+            auto b0 = 1.0f - r;
+            auto b1 = r * (1.0f - s);
+            auto b2 = r * s;
+
+            auto position = b0 * mesh.vertices[i0] + b1 * mesh.vertices[i1] + b2 * mesh.vertices[i2];
+            if (!grid.tryInsert(position))
+                continue;
+
+            auto normal = glm::cross(mesh.vertices[i1] - mesh.vertices[i0], mesh.vertices[i2] - mesh.vertices[i0]);
+            if (mesh.normals)
+            {
+                auto interpolated = b0 * mesh.normals[i0] + b1 * mesh.normals[i1] + b2 * mesh.normals[i2];
+                if (glm::dot(interpolated, interpolated) > 0.0f)
+                    normal = interpolated;
+            }
+            auto length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+            points.push_back(glm::vec4(position, packNormal(normal)));
+        }
+
+        return points;
+    }
+}
+
+const unsigned int PointCloud::targetNumPoints;
+
+PointCloud::PointCloud(const std::string& meshCacheFilename)
+: m_radius(0.0f)
+{
+    auto extension = meshCacheFilename.rfind('.');
+    m_cacheFilename = meshCacheFilename.substr(0, extension) + ".pointcache";
+}
+
+PointCloud::~PointCloud()
+{
+}
+
+bool PointCloud::load()
+{
+    m_points.clear();
+    m_radius = 0.0f;
+
+    MappedFile file;
+    if (!file.open(m_cacheFilename))
+        return false;
+
+    FileHeader header;
+    bool headerMatches = file.size() >= sizeof(FileHeader);
+    if (headerMatches)
+    {
+        std::memcpy(&header, file.data(), sizeof(FileHeader));
+        headerMatches = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+            && header.version == cacheVersion
+            && header.targetNumPoints == targetNumPoints;
+    }
+
+    if (!headerMatches)
+    {
+        std::cout << "Ignoring outdated point cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    if (file.size() - sizeof(FileHeader) != header.numPoints * sizeof(glm::vec4))
+    {
+        std::cout << "Point cache " << m_cacheFilename << " is corrupt, ignoring it" << std::endl;
+        return false;
+    }
+
+    m_points.resize(header.numPoints);
+    std::memcpy(m_points.data(), file.data() + sizeof(FileHeader), header.numPoints * sizeof(glm::vec4));
+    m_radius = header.radius;
+
+    return true;
+}
+
+bool PointCloud::store() const
+{
+    // write to a temporary file first so that a crash never leaves a half-written cache behind
+    auto temporaryFilename = m_cacheFilename + ".tmp";
+    std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+    if (!stream)
+    {
+        std::cout << "Could not write point cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.targetNumPoints = targetNumPoints;
+    header.numPoints = static_cast<uint32_t>(m_points.size());
+    header.radius = m_radius;
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(m_points.data()), m_points.size() * sizeof(glm::vec4));
+
+    stream.close();
+    if (!stream)
+    {
+        std::remove(temporaryFilename.c_str());
+        std::cout << "Could not write point cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    std::remove(m_cacheFilename.c_str());
+    if (std::rename(temporaryFilename.c_str(), m_cacheFilename.c_str()) != 0)
+    {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void PointCloud::build(const std::vector<MeshCache::Mesh>& meshes)
+{
+    m_points.clear();
+    m_radius = 0.0f;
+
+    // the triangle areas of every mesh, summed up to pick triangles by area with a binary search
+    std::vector<std::vector<float>> cumulativeAreas(meshes.size());
+    parallelFor(meshes.size(), [&](size_t m)
+    {
+        const auto& mesh = meshes[m];
+        const auto* indices = mesh.indices + mesh.lodFirstIndex[0];
+        auto numTriangles = mesh.lodNumIndices[0] / 3;
+
+        auto& cumulative = cumulativeAreas[m];
+        cumulative.resize(numTriangles);
+        float sum = 0.0f;
+        for (unsigned int t = 0; t < numTriangles; ++t)
+        {
+            sum += triangleArea(mesh.vertices[indices[3 * t]], mesh.vertices[indices[3 * t + 1]], mesh.vertices[indices[3 * t + 2]]);
+            cumulative[t] = sum;
+        }
+    });
+
+    double totalArea = 0.0;
+    for (const auto& cumulative : cumulativeAreas)
+        totalArea += cumulative.empty() ? 0.0f : cumulative.back();
+    if (totalArea <= 0.0)
+        return;
+
+    // meshes are sampled independently, seeded by their index so the result does not depend on the scheduling
+    auto areaPerPoint = static_cast<float>(totalArea / targetNumPoints);
+    std::vector<std::vector<glm::vec4>> meshPoints(meshes.size());
+    parallelFor(meshes.size(), [&](size_t m)
+    {
+        meshPoints[m] = sampleMesh(meshes[m], cumulativeAreas[m], areaPerPoint, static_cast<unsigned int>(m));
+    });
+
+    size_t numPoints = 0;
+    for (const auto& points : meshPoints)
+        numPoints += points.size();
+    m_points.reserve(numPoints);
+    for (const auto& points : meshPoints)
+        m_points.insert(m_points.end(), points.begin(), points.end());
+
+    if (m_points.empty())
+        return;
+
+    // in random order, so every contiguous range is spread over the whole scene, see ImperfectShadowmap's round-robin update
+    std::shuffle(m_points.begin(), m_points.end(), std::mt19937(static_cast<unsigned int>(meshes.size())));
+
+    // the distance from the center of an equilateral triangle with the area of a point to its corners,
+    // which is the radius ism.geom gives a tessellated triangle
+    auto actualAreaPerPoint = static_cast<float>(totalArea / m_points.size());
+    m_radius = std::sqrt(4.0f * actualAreaPerPoint / (3.0f * std::sqrt(3.0f)));
+}
+
+const std::string& PointCloud::cacheFilename() const
+{
+    return m_cacheFilename;
+}
+
+const std::vector<glm::vec4>& PointCloud::points() const
+{
+    return m_points;
+}
+
+float PointCloud::radius() const
+{
+    return m_radius;
+}
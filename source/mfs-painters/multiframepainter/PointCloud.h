@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+#include "MeshCache.h"
+
+
+// Area weighted blue noise samples of the full resolution scene surfaces, which the ISM pass splats instead of
+// tessellating every triangle each frame. Candidates are drawn uniformly over the surface area of each mesh and
+// thinned out by dart throwing, so no two points of a mesh are closer than a fixed fraction of the mean spacing.
+// The points are stored in random order and cached on disk next to the mesh cache they were generated from.
+class PointCloud
+{
+public:
+    // about 32 MB on the GPU
+    static const unsigned int targetNumPoints = 1 << 21;
+
+    PointCloud(const std::string& meshCacheFilename);
+    ~PointCloud();
+
+    bool load();
+    bool store() const;
+    void build(const std::vector<MeshCache::Mesh>& meshes);
+
+    const std::string& cacheFilename() const;
+    // position and the bits of the normal packed like packUnorm4x8(normal * 0.5 + 0.5) with alpha zero,
+    // which the shaders have to read as an integer
+    const std::vector<glm::vec4>& points() const;
+    // the same for all points, sized like the tessellated triangles ism.geom turns into points
+    float radius() const;
+
+protected:
+    std::string m_cacheFilename;
+    std::vector<glm::vec4> m_points;
+    float m_radius;
+};
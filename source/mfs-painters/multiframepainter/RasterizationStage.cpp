@@ -1,9 +1,13 @@
 #include "RasterizationStage.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <glbinding/gl/enum.h>
 #include <glbinding/gl/functions.h>
 #include <glbinding/gl/boolean.h>
 
+#include <globjects/Buffer.h>
 #include <globjects/Framebuffer.h>
 #include <globjects/Texture.h>
 #include <globjects/Program.h>
@@ -14,14 +18,17 @@
 #include <gloperate/painter/AbstractViewportCapability.h>
 #include <gloperate/painter/AbstractCameraCapability.h>
 
-#include <gloperate/primitives/PolygonalDrawable.h>
-
 #include <reflectionzeug/property/extensions/GlmProperties.h>
 
 #include "Material.h"
+#include "MaterialTable.h"
 #include "ModelLoadingStage.h"
+#include "SceneGeometry.h"
 #include "KernelGenerationStage.h"
+#include "MemoryRegistry.h"
 #include "MultiFramePainter.h"
+#include "OcclusionCulling.h"
+#include "PerfCounter.h"
 
 using namespace gl;
 using gloperate::make_unique;
@@ -39,6 +46,12 @@ namespace
         OpacitySampler,
         BumpSampler
     };
+
+    // indexed by TextureType
+    const Sampler textureSamplers[numTextureTypes] = { DiffuseSampler, SpecularSampler, EmissiveSampler, BumpSampler, OpacitySampler };
+
+    // matches the MaterialTable block in model.frag
+    const GLuint materialTableBinding = 0;
 }
 
 RasterizationStage::RasterizationStage(std::string name, ModelLoadingStage& modelLoadingStage, KernelGenerationStage& kernelGenerationStage, bool renderRSM)
@@ -47,6 +60,12 @@ RasterizationStage::RasterizationStage(std::string name, ModelLoadingStage& mode
 , m_kernelGenerationStage(kernelGenerationStage)
 , m_renderRSM(renderRSM)
 {
+    useScreenSpaceLod = !renderRSM;
+    lodPixelError = 1.0f;
+    lodLevel = 0;
+    useFrustumCulling = true;
+    useOcclusionCulling = !renderRSM;
+    hiZStage = nullptr;
     currentFrame = 1;
 }
 RasterizationStage::~RasterizationStage()
@@ -55,6 +74,35 @@ RasterizationStage::~RasterizationStage()
 
 void RasterizationStage::initProperties(MultiFramePainter& painter)
 {
+    painter.addProperty<bool>("ScreenSpaceLod",
+        [this]() { return useScreenSpaceLod; },
+        [this](const bool & value) {
+            useScreenSpaceLod = value;
+    });
+
+    painter.addProperty<float>("LodPixelError",
+        [this]() { return lodPixelError; },
+        [this](const float & value) {
+            lodPixelError = value;
+        }
+    )->setOptions({
+        { "minimum", 0.0f },
+        { "maximum", 16.0f },
+        { "step", 0.25f },
+        { "precision", 2u },
+    });
+
+    painter.addProperty<bool>("FrustumCulling",
+        [this]() { return useFrustumCulling; },
+        [this](const bool & value) {
+            useFrustumCulling = value;
+    });
+
+    painter.addProperty<bool>("OcclusionCulling",
+        [this]() { return useOcclusionCulling; },
+        [this](const bool & value) {
+            useOcclusionCulling = value;
+    });
 }
 
 void RasterizationStage::initialize()
@@ -100,8 +148,15 @@ void RasterizationStage::initialize()
     glm::vec4 color(0.0);
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, (float*)&color);
 
+    bool compactVertices = m_modelLoadingStage.getSceneGeometry().compactVertices();
+    bool bindlessTextures = m_modelLoadingStage.getMaterialTable().bindless();
+
     if (!m_renderRSM)
         globjects::Shader::globalReplace("#define RENDER_RSM", "#undef RENDER_RSM");
+    if (!compactVertices)
+        globjects::Shader::globalReplace("#define COMPACT_VERTICES", "#undef COMPACT_VERTICES");
+    if (!bindlessTextures)
+        globjects::Shader::globalReplace("#define BINDLESS_TEXTURES", "#undef BINDLESS_TEXTURES");
     m_program = new globjects::Program();
     m_program->attach(
         globjects::Shader::fromFile(GL_VERTEX_SHADER, "data/shaders/model.vert"),
@@ -109,11 +164,19 @@ void RasterizationStage::initialize()
     );
     globjects::Shader::clearGlobalReplacements();
 
+    if (!compactVertices)
+        globjects::Shader::globalReplace("#define COMPACT_VERTICES", "#undef COMPACT_VERTICES");
     m_zOnlyProgram = new globjects::Program();
     m_zOnlyProgram->attach(
         globjects::Shader::fromFile(GL_VERTEX_SHADER, "data/shaders/model.vert"),
         globjects::Shader::fromFile(GL_FRAGMENT_SHADER, "data/shaders/empty.frag")
     );
+    globjects::Shader::clearGlobalReplacements();
+
+    m_selection = gloperate::make_unique<DrawSelection>(m_name);
+    // reflective shadow maps are small and low detail, culling them on the CPU is enough
+    if (!m_renderRSM && hiZStage)
+        m_occlusionCulling = gloperate::make_unique<OcclusionCulling>(m_name, viewport, *hiZStage);
 }
 
 
@@ -145,6 +208,13 @@ void RasterizationStage::resizeTextures(int width, int height)
     vsmBuffer->image2D(0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, nullptr);
     depthBuffer->image2D(0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
+    MemoryRegistry::registerTexture(m_name, diffuseBuffer, GL_RGB8, width, height);
+    MemoryRegistry::registerTexture(m_name, specularBuffer, GL_RGB8, width, height);
+    MemoryRegistry::registerTexture(m_name, faceNormalBuffer, GL_RGB10_A2, width, height);
+    MemoryRegistry::registerTexture(m_name, normalBuffer, GL_RGB10_A2, width, height);
+    MemoryRegistry::registerTexture(m_name, vsmBuffer, GL_RG32F, width, height);
+    MemoryRegistry::registerTexture(m_name, depthBuffer, GL_DEPTH_COMPONENT, width, height);
+
     m_fbo->printStatus(true);
 }
 
@@ -200,104 +270,115 @@ void RasterizationStage::render()
         program->setUniform("focalDist", m_focalDist);
     }
 
-    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-
-    // zPrepass speeds up crytek sponza due to its low geometric complexity
-    if (m_modelLoadingStage.getCurrentPreset() == Preset::CrytekSponza)
-        zPrepass();
+    m_program->setUniform("bumpType", static_cast<int>(m_bumpType));
 
-    m_program->use();
+    // updating the table reorders the commands of the scene geometry, so it has to happen before selecting them
+    const auto& materialTable = m_modelLoadingStage.getMaterialTable();
+    const auto& sceneGeometry = m_modelLoadingStage.getSceneGeometry();
+    auto viewProjection = projection->projection() * camera->view();
 
-    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    for (auto& pair : m_modelLoadingStage.getDrawablesMap())
     {
-        auto materialId = pair.first;
-        auto& drawables = pair.second;
-
-        auto& material = m_modelLoadingStage.getMaterialMap().at(materialId);
-
-        bool hasDiffuseTex = material.hasTexture(TextureType::Diffuse);
-        bool hasBumpTex = material.hasTexture(TextureType::Bump);
-        bool hasSpecularTex = material.hasTexture(TextureType::Specular);
-        bool hasEmissiveTex = material.hasTexture(TextureType::Emissive);
-        bool hasOpacityTex = material.hasTexture(TextureType::Opacity);
-
-        if (hasDiffuseTex)
+        AutoPerfCounter c(m_name + " Culling");
+        if (useScreenSpaceLod)
         {
-            auto tex = material.textureMap().at(TextureType::Diffuse);
-            tex->bindActive(DiffuseSampler);
+            // projection[1][1] is the cotangent of half the vertical field of view
+            auto pixelsPerUnit = 0.5f * viewport->height() * projection->projection()[1][1];
+            sceneGeometry.select(*m_selection, viewProjection, useFrustumCulling, camera->eye(), pixelsPerUnit, lodPixelError);
         }
-
-        if (hasSpecularTex)
+        else
         {
-            auto tex = material.textureMap().at(TextureType::Specular);
-            tex->bindActive(SpecularSampler);
+            sceneGeometry.select(*m_selection, viewProjection, useFrustumCulling, lodLevel);
         }
+    }
+    PerfCounter::setCount(m_name + " visible", m_selection->numVisible());
+    PerfCounter::setCount(m_name + " culled", m_selection->numCulled());
 
-        if (hasEmissiveTex)
-        {
-            auto tex = material.textureMap().at(TextureType::Emissive);
-            tex->bindActive(EmissiveSampler);
-        }
+    auto occlusionCulling = useOcclusionCulling && m_occlusionCulling;
+    const DrawSelection* selection = m_selection.get();
+    if (occlusionCulling)
+    {
+        m_occlusionCulling->cullFirstPhase(sceneGeometry, *m_selection, viewProjection);
+        selection = &m_occlusionCulling->firstPhase();
+        PerfCounter::setCount(m_name + " occlusion visible", m_occlusionCulling->numVisible());
+    }
+    else if (m_occlusionCulling)
+    {
+        m_occlusionCulling->invalidate();
+    }
 
-        if (hasOpacityTex)
-        {
-            auto tex = material.textureMap().at(TextureType::Opacity);
-            tex->bindActive(OpacitySampler);
-            glDisable(GL_CULL_FACE);
-        } else {
-            glEnable(GL_CULL_FACE);
-        }
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-        auto bumpType = BumpType::None;
-        if (hasBumpTex)
-        {
-            bumpType = m_bumpType;
-            auto tex = material.textureMap().at(TextureType::Bump);
-            tex->bindActive(BumpSampler);
-        }
+    // zPrepass speeds up crytek sponza due to its low geometric complexity
+    if (m_modelLoadingStage.getCurrentPreset() == Preset::CrytekSponza)
+        zPrepass(materialTable, *selection);
 
-        m_program->setUniform("shininess", material.specularFactor);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-        m_program->setUniform("bumpType", static_cast<int>(bumpType));
-        m_program->setUniform("useDiffuseTexture", hasDiffuseTex);
-        m_program->setUniform("useSpecularTexture", hasSpecularTex);
-        m_program->setUniform("useEmissiveTexture", hasEmissiveTex);
-        m_program->setUniform("useOpacityTexture", hasOpacityTex);
+    drawGroups(materialTable, *selection);
 
-        for (auto& drawable : drawables)
-        {
-            drawable->draw();
-        }
+    if (occlusionCulling)
+    {
+        m_occlusionCulling->cullSecondPhase(sceneGeometry, *m_selection);
+        drawGroups(materialTable, m_occlusionCulling->secondPhase());
     }
 
-    m_program->release();
-
     m_fbo->unbind();
 }
 
-void RasterizationStage::zPrepass()
+void RasterizationStage::zPrepass(const MaterialTable& materialTable, const DrawSelection& selection)
 {
+    // alpha tested materials are ordered last and skipped, all others are one range of commands
+    const auto& drawGroups = materialTable.drawGroups();
+    auto unculled = std::find_if(drawGroups.begin(), drawGroups.end(), [](const MaterialTable::DrawGroup& group) {
+        return !group.cullFace;
+    });
+    if (unculled == drawGroups.begin())
+        return;
+
     m_zOnlyProgram->use();
+    drawMaterials(selection, drawGroups.front().firstMaterial, std::prev(unculled)->lastMaterial);
+    m_zOnlyProgram->release();
+}
 
-    for (auto& pair : m_modelLoadingStage.getDrawablesMap())
+void RasterizationStage::drawGroups(const MaterialTable& materialTable, const DrawSelection& selection)
+{
+    m_program->use();
+    materialTable.buffer()->bindBase(GL_SHADER_STORAGE_BUFFER, materialTableBinding);
+
+    // materials are looked up in the table by the shader, with bindless textures the groups only differ in culling,
+    // otherwise every group also binds the texture arrays it samples from
+    const globjects::Texture* boundArrays[numTextureTypes] = {};
+    bool cullFace = true;
+    glEnable(GL_CULL_FACE);
+    for (const auto& group : materialTable.drawGroups())
     {
-        auto materialId = pair.first;
-        auto& drawables = pair.second;
-
-        auto& material = m_modelLoadingStage.getMaterialMap().at(materialId);
-        if (material.hasTexture(TextureType::Opacity))
+        for (unsigned int t = 0; t < numTextureTypes; ++t)
         {
-            continue;
+            if (group.arrays[t] && group.arrays[t] != boundArrays[t])
+            {
+                group.arrays[t]->bindActive(textureSamplers[t]);
+                boundArrays[t] = group.arrays[t];
+            }
         }
 
-        for (auto& drawable : drawables)
+        if (group.cullFace != cullFace)
         {
-            drawable->draw();
+            cullFace = group.cullFace;
+            if (cullFace)
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
         }
+
+        drawMaterials(selection, group.firstMaterial, group.lastMaterial);
     }
 
-    m_zOnlyProgram->release();
+    m_program->release();
+}
+
+void RasterizationStage::drawMaterials(const DrawSelection& selection, unsigned int firstMaterial, unsigned int lastMaterial) const
+{
+    m_modelLoadingStage.getSceneGeometry().drawSelectedMaterials(selection, firstMaterial, lastMaterial, GL_TRIANGLES);
 }
 
 void RasterizationStage::setupGLState()
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <globjects/base/ref_ptr.h>
 
 #include "TypeDefinitions.h"
@@ -17,10 +20,13 @@ namespace gloperate
     class AbstractViewportCapability;
     class AbstractCameraCapability;
 
-    class PolygonalDrawable;
 }
 
+class DrawSelection;
 class GroundPlane;
+class HiZStage;
+class MaterialTable;
+class OcclusionCulling;
 class ModelLoadingStage;
 class KernelGenerationStage;
 class MultiFramePainter;
@@ -43,6 +49,16 @@ public:
     gloperate::AbstractCameraCapability * camera;
     bool useDOF;
 
+    // either a level of detail per mesh by its projected error or one fixed level for the whole scene
+    bool useScreenSpaceLod;
+    float lodPixelError;
+    unsigned int lodLevel;
+    bool useFrustumCulling;
+    // draws what was visible in the previous frame first, then what its depth reveals as disoccluded
+    bool useOcclusionCulling;
+    // the pyramid of depthBuffer the painter builds after this stage, occlusion culling needs it
+    HiZStage * hiZStage;
+
     int currentFrame;
     globjects::ref_ptr<globjects::Texture> diffuseBuffer;
     globjects::ref_ptr<globjects::Texture> specularBuffer;
@@ -53,15 +69,18 @@ public:
 
 
 protected:
-
     void resizeTextures(int width, int height);
     static void setupGLState();
     void render();
-    void zPrepass();
+    void zPrepass(const MaterialTable& materialTable, const DrawSelection& selection);
+    void drawGroups(const MaterialTable& materialTable, const DrawSelection& selection);
+    void drawMaterials(const DrawSelection& selection, unsigned int firstMaterial, unsigned int lastMaterial) const;
 
     globjects::ref_ptr<globjects::Framebuffer> m_fbo;
     globjects::ref_ptr<globjects::Program> m_program;
     globjects::ref_ptr<globjects::Program> m_zOnlyProgram;
+    std::unique_ptr<DrawSelection> m_selection;
+    std::unique_ptr<OcclusionCulling> m_occlusionCulling;
 
     float m_focalPoint;
     float m_focalDist;
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+
+// Decoded 8 bit RGBA image in OpenGL row order (bottom row first).
+// Loaded through a gloperate::Loader<RawImage> so that images can be decoded on worker threads
+// and uploaded on the GL thread later.
+struct RawImage
+{
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
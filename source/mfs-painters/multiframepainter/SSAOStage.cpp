@@ -14,6 +14,7 @@
 #include <gloperate/painter/AbstractCameraCapability.h>
 
 #include "KernelGenerationStage.h"
+#include "MemoryRegistry.h"
 #include "ModelLoadingStage.h"
 #include "PerfCounter.h"
 
@@ -94,6 +95,7 @@ void SSAOStage::process()
 void SSAOStage::resizeTexture(int width, int height)
 {
     occlusionBuffer->image2D(0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    MemoryRegistry::registerTexture("SSAO", occlusionBuffer, GL_R8, width, height);
     m_fbo->printStatus(true);
 }
 
@@ -108,7 +110,9 @@ void SSAOStage::generateNoiseTexture()
     texture->setParameter(gl::GL_TEXTURE_WRAP_S, gl::GL_REPEAT);
     texture->setParameter(gl::GL_TEXTURE_WRAP_T, gl::GL_REPEAT);
 
+    texture->setName("SSAO Noise");
     texture->image2D(0, gl::GL_RGBA32F, glm::ivec2(size), 0, gl::GL_RGB, gl::GL_FLOAT, noise.data());
+    MemoryRegistry::registerTexture("SSAO", texture, gl::GL_RGBA32F, size, size);
 
     m_ssaoNoiseTexture = texture;
 }
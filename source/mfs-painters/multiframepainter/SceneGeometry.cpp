@@ -0,0 +1,752 @@
+#include "SceneGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/functions.h>
+
+#include <globjects/Buffer.h>
+#include <globjects/VertexArray.h>
+#include <globjects/VertexAttributeBinding.h>
+
+#include "MemoryRegistry.h"
+
+using namespace gl;
+
+namespace
+{
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 textureCoordinate;
+    };
+
+    struct CompactVertex
+    {
+        glm::u16vec4 position; // w unused, keeps the vertex 4 byte aligned
+        glm::i16vec2 normal;
+        glm::uint32 textureCoordinate; // two half floats
+    };
+
+    static_assert(sizeof(CompactVertex) == 16, "compact vertices are expected to be 16 bytes");
+
+    glm::i16vec2 encodeOctahedral(const glm::vec3& normal)
+    {
+        auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.0f)
+            return glm::i16vec2(0);
+
+        auto p = glm::vec2(normal.x, normal.y) / length;
+        if (normal.z < 0.0f)
+        {
+            auto signs = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+            p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signs;
+        }
+
+        return glm::i16vec2(glm::round(glm::clamp(p, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    // copies the used part of the old buffer into a new, larger one
+    globjects::ref_ptr<globjects::Buffer> grow(globjects::Buffer* buffer, size_t usedSize, size_t newSize)
+    {
+        globjects::ref_ptr<globjects::Buffer> grown = new globjects::Buffer();
+        grown->setData(static_cast<GLsizeiptr>(newSize), nullptr, GL_STATIC_DRAW);
+        if (buffer && usedSize > 0)
+            buffer->copySubData(grown, 0, 0, static_cast<GLsizeiptr>(usedSize));
+        return grown;
+    }
+
+    DrawElementsIndirectCommand makeCommand(GLuint firstIndex, GLuint numIndices, GLint baseVertex, size_t meshIndex)
+    {
+        DrawElementsIndirectCommand command;
+        command.count = numIndices;
+        command.instanceCount = 1;
+        command.firstIndex = firstIndex;
+        command.baseVertex = baseVertex;
+        command.baseInstance = static_cast<GLuint>(meshIndex);
+        return command;
+    }
+}
+
+DrawSelection::DrawSelection(const std::string& name)
+: m_name(name)
+, m_capacity(0)
+, m_numVisible(0)
+, m_numCulled(0)
+{
+    m_commands = new globjects::Buffer();
+    m_commands->setName(name + " Draw Commands");
+}
+
+DrawSelection::~DrawSelection()
+{
+    MemoryRegistry::unregister(m_commands.get());
+}
+
+size_t DrawSelection::numVisible() const
+{
+    return m_numVisible;
+}
+
+size_t DrawSelection::numCulled() const
+{
+    return m_numCulled;
+}
+
+globjects::Buffer* DrawSelection::commands() const
+{
+    return m_commands;
+}
+
+void DrawSelection::reserve(size_t numCommands)
+{
+    if (m_capacity >= numCommands)
+        return;
+
+    m_commands->setData(static_cast<GLsizeiptr>(numCommands * sizeof(DrawElementsIndirectCommand)), nullptr, GL_STREAM_DRAW);
+    m_capacity = numCommands;
+    MemoryRegistry::registerBuffer(m_name, m_commands, m_capacity * sizeof(DrawElementsIndirectCommand));
+}
+
+SceneGeometry::SceneGeometry(bool compactVertices)
+: m_compactVertices(compactVertices)
+, m_vertexCapacity(0)
+, m_indexCapacity(0)
+, m_numVertices(0)
+, m_numIndices(0)
+, m_surfaceArea(0.0f)
+, m_numPoints(0)
+, m_pointRadius(0.0f)
+, m_lodFirstMeshlet()
+, m_lodNumMeshlets()
+, m_numCommands(0)
+, m_commandsDirty(false)
+{
+    m_vao = new globjects::VertexArray();
+    m_meshBounds = new globjects::Buffer();
+    m_meshBounds->setName("Mesh Bounds");
+    m_cullingBounds = new globjects::Buffer();
+    m_cullingBounds->setName("Mesh Culling Bounds");
+    m_meshMaterials = new globjects::Buffer();
+    m_meshMaterials->setName("Mesh Materials");
+    m_commands = new globjects::Buffer();
+    m_commands->setName("Draw Commands");
+    m_meshlets = new globjects::Buffer();
+    m_meshlets->setName("Meshlets");
+
+    m_points = new globjects::Buffer();
+    m_points->setName("Scene Points");
+    m_pointVao = new globjects::VertexArray();
+    m_pointVao->binding(0)->setAttribute(0);
+    m_pointVao->binding(0)->setBuffer(m_points, 0, sizeof(glm::vec4));
+    m_pointVao->binding(0)->setFormat(3, GL_FLOAT);
+    m_pointVao->enable(0);
+
+    // the packed normal is read as an integer, as a float its bit pattern may be a denormal or NaN
+    m_pointVao->binding(1)->setAttribute(1);
+    m_pointVao->binding(1)->setBuffer(m_points, 0, sizeof(glm::vec4));
+    m_pointVao->binding(1)->setIFormat(1, GL_UNSIGNED_INT, sizeof(glm::vec3));
+    m_pointVao->enable(1);
+}
+
+SceneGeometry::~SceneGeometry()
+{
+    MemoryRegistry::unregister(m_vertices.get());
+    MemoryRegistry::unregister(m_indices.get());
+    MemoryRegistry::unregister(m_meshBounds.get());
+    MemoryRegistry::unregister(m_cullingBounds.get());
+    MemoryRegistry::unregister(m_meshMaterials.get());
+    MemoryRegistry::unregister(m_commands.get());
+    MemoryRegistry::unregister(m_meshlets.get());
+    MemoryRegistry::unregister(m_points.get());
+    MemoryRegistry::unregister(this);
+}
+
+bool SceneGeometry::compactVertices() const
+{
+    return m_compactVertices;
+}
+
+void SceneGeometry::clear()
+{
+    m_numVertices = 0;
+    m_numIndices = 0;
+    m_surfaceArea = 0.0f;
+    m_numPoints = 0;
+    m_pointRadius = 0.0f;
+    m_meshes.clear();
+    m_meshletRecords.clear();
+    std::fill(std::begin(m_lodFirstMeshlet), std::end(m_lodFirstMeshlet), 0);
+    std::fill(std::begin(m_lodNumMeshlets), std::end(m_lodNumMeshlets), 0);
+    m_commandOrder.clear();
+    m_materialCommands.clear();
+    m_bvh.build({}, {});
+    m_numCommands = 0;
+    m_commandsDirty = false;
+}
+
+void SceneGeometry::reserve(size_t numVertices, size_t numIndices)
+{
+    if (numVertices > m_vertexCapacity)
+    {
+        MemoryRegistry::unregister(m_vertices.get());
+        m_vertices = grow(m_vertices, m_numVertices * vertexSize(), numVertices * vertexSize());
+        m_vertices->setName("Scene Vertices");
+        m_vertexCapacity = numVertices;
+        MemoryRegistry::registerBuffer("Scene Geometry", m_vertices, m_vertexCapacity * vertexSize());
+    }
+
+    if (numIndices > m_indexCapacity)
+    {
+        MemoryRegistry::unregister(m_indices.get());
+        m_indices = grow(m_indices, m_numIndices * sizeof(GLuint), numIndices * sizeof(GLuint));
+        m_indices->setName("Scene Indices");
+        m_indexCapacity = numIndices;
+        MemoryRegistry::registerBuffer("Scene Geometry", m_indices, m_indexCapacity * sizeof(GLuint));
+    }
+
+    setupVertexArray();
+}
+
+void SceneGeometry::add(const MeshCache::Mesh& mesh, const std::vector<MeshletBuilder::Meshlet>& meshlets)
+{
+    if (m_numVertices + mesh.numVertices > m_vertexCapacity || m_numIndices + mesh.numIndices > m_indexCapacity)
+    {
+        reserve(std::max(2 * m_vertexCapacity, m_numVertices + mesh.numVertices),
+            std::max(2 * m_indexCapacity, m_numIndices + mesh.numIndices));
+    }
+
+    MeshRange range;
+    range.materialIndex = mesh.materialIndex;
+    range.baseVertex = static_cast<GLint>(m_numVertices);
+    range.numLods = mesh.numLods;
+    for (unsigned int l = 0; l < mesh.numLods; ++l)
+    {
+        range.lodFirstIndex[l] = static_cast<GLuint>(m_numIndices) + mesh.lodFirstIndex[l];
+        range.lodNumIndices[l] = mesh.lodNumIndices[l];
+        range.lodError[l] = mesh.lodError[l];
+    }
+
+    // bounds are needed for the compact vertex format and for choosing levels of detail
+    auto boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    range.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    for (unsigned int i = 0; i < mesh.numVertices; ++i)
+    {
+        range.boundsMin = glm::min(range.boundsMin, mesh.vertices[i]);
+        boundsMax = glm::max(boundsMax, mesh.vertices[i]);
+    }
+    if (mesh.numVertices == 0)
+        range.boundsMin = glm::vec3(0.0f);
+    range.boundsExtent = mesh.numVertices > 0 ? boundsMax - range.boundsMin : glm::vec3(0.0f);
+
+    const auto* indices = mesh.indices + mesh.lodFirstIndex[0];
+    for (unsigned int i = 0; i + 2 < mesh.lodNumIndices[0]; i += 3)
+    {
+        const auto& a = mesh.vertices[indices[i]];
+        m_surfaceArea += 0.5f * glm::length(glm::cross(mesh.vertices[indices[i + 1]] - a, mesh.vertices[indices[i + 2]] - a));
+    }
+
+    auto vertexOffset = static_cast<GLintptr>(m_numVertices * vertexSize());
+    auto verticesSize = static_cast<GLsizeiptr>(mesh.numVertices * vertexSize());
+
+    if (m_compactVertices)
+    {
+        // flat meshes have a zero extent along one axis, which decodes correctly with any scale
+        auto scale = glm::vec3(
+            range.boundsExtent.x > 0.0f ? 65535.0f / range.boundsExtent.x : 0.0f,
+            range.boundsExtent.y > 0.0f ? 65535.0f / range.boundsExtent.y : 0.0f,
+            range.boundsExtent.z > 0.0f ? 65535.0f / range.boundsExtent.z : 0.0f);
+
+        std::vector<CompactVertex> vertices(mesh.numVertices);
+        for (unsigned int i = 0; i < mesh.numVertices; ++i)
+        {
+            auto quantized = glm::round(glm::clamp((mesh.vertices[i] - range.boundsMin) * scale, 0.0f, 65535.0f));
+            vertices[i].position = glm::u16vec4(glm::u16vec3(quantized), 0);
+            vertices[i].normal = mesh.normals ? encodeOctahedral(mesh.normals[i]) : glm::i16vec2(0);
+            vertices[i].textureCoordinate = mesh.textureCoordinates
+                ? glm::packHalf2x16(glm::vec2(mesh.textureCoordinates[i].x, mesh.textureCoordinates[i].y))
+                : 0u;
+        }
+        m_vertices->setSubData(vertexOffset, verticesSize, vertices.data());
+    }
+    else
+    {
+        std::vector<Vertex> vertices(mesh.numVertices);
+        for (unsigned int i = 0; i < mesh.numVertices; ++i)
+        {
+            vertices[i].position = mesh.vertices[i];
+            vertices[i].normal = mesh.normals ? mesh.normals[i] : glm::vec3(0.0f);
+            vertices[i].textureCoordinate = mesh.textureCoordinates ? mesh.textureCoordinates[i] : glm::vec3(0.0f);
+        }
+        m_vertices->setSubData(vertexOffset, verticesSize, vertices.data());
+    }
+
+    m_indices->setSubData(static_cast<GLintptr>(m_numIndices * sizeof(GLuint)), static_cast<GLsizeiptr>(mesh.numIndices * sizeof(GLuint)), mesh.indices);
+
+    // meshlets arrive grouped by level
+    for (unsigned int l = 0; l < MeshCache::maxLods; ++l)
+    {
+        range.lodFirstMeshlet[l] = m_meshletRecords.size();
+        range.lodNumMeshlets[l] = 0;
+    }
+    for (const auto& meshlet : meshlets)
+    {
+        if (range.lodNumMeshlets[meshlet.lod]++ == 0)
+            range.lodFirstMeshlet[meshlet.lod] = m_meshletRecords.size();
+
+        MeshletRecord record;
+        record.sphere = glm::vec4(meshlet.center, meshlet.radius);
+        record.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+        record.count = meshlet.numIndices;
+        record.firstIndex = range.lodFirstIndex[meshlet.lod] + meshlet.firstIndex;
+        record.baseVertex = range.baseVertex;
+        record.meshIndex = static_cast<GLuint>(m_meshes.size());
+        m_meshletRecords.push_back(record);
+    }
+
+    m_meshes.push_back(range);
+
+    m_numVertices += mesh.numVertices;
+    m_numIndices += mesh.numIndices;
+    m_commandsDirty = true;
+}
+
+void SceneGeometry::updateCommands()
+{
+    if (!m_commandsDirty)
+        return;
+
+    // commands are grouped by material, so every material is one contiguous range of the buffer
+    std::map<unsigned int, size_t> materialRank;
+    for (size_t i = 0; i < m_materialOrder.size(); ++i)
+        materialRank.insert({ m_materialOrder[i], i });
+
+    auto rank = [this, &materialRank](size_t meshIndex) {
+        auto materialIndex = m_meshes[meshIndex].materialIndex;
+        auto it = materialRank.find(materialIndex);
+        return it != materialRank.end() ? std::make_pair(it->second, 0u) : std::make_pair(m_materialOrder.size(), materialIndex);
+    };
+
+    std::vector<size_t> order(m_meshes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&rank](size_t a, size_t b) {
+        return rank(a) < rank(b);
+    });
+
+    m_materialCommands.clear();
+    for (size_t c = 0; c < order.size(); ++c)
+    {
+        auto& range = m_materialCommands[m_meshes[order[c]].materialIndex];
+        if (range.second == 0)
+            range.first = c;
+        range.second++;
+    }
+
+    // the same command order repeats for every level, meshes with fewer levels repeat their coarsest one
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(order.size() * MeshCache::maxLods);
+    for (unsigned int lod = 0; lod < MeshCache::maxLods; ++lod)
+    {
+        for (auto meshIndex : order)
+        {
+            const auto& mesh = m_meshes[meshIndex];
+            auto level = std::min(lod, mesh.numLods - 1);
+            commands.push_back(makeCommand(mesh.lodFirstIndex[level], mesh.lodNumIndices[level], mesh.baseVertex, meshIndex));
+        }
+    }
+
+    m_commands->setData(commands, GL_STATIC_DRAW);
+    m_numCommands = order.size();
+    m_commandOrder = std::move(order);
+
+    // meshlets follow the meshes in the order they were added, with the same repetition of coarse levels
+    std::vector<MeshletRecord> meshlets;
+    for (unsigned int lod = 0; lod < MeshCache::maxLods; ++lod)
+    {
+        m_lodFirstMeshlet[lod] = meshlets.size();
+        for (const auto& mesh : m_meshes)
+        {
+            auto level = std::min(lod, mesh.numLods - 1);
+            auto first = m_meshletRecords.begin() + mesh.lodFirstMeshlet[level];
+            meshlets.insert(meshlets.end(), first, first + mesh.lodNumMeshlets[level]);
+        }
+        m_lodNumMeshlets[lod] = meshlets.size() - m_lodFirstMeshlet[lod];
+    }
+    m_meshlets->setData(meshlets, GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("Scene Geometry", m_meshlets, meshlets.size() * sizeof(MeshletRecord));
+
+    if (m_compactVertices)
+    {
+        std::vector<glm::vec3> bounds;
+        bounds.reserve(2 * m_meshes.size());
+        for (const auto& mesh : m_meshes)
+        {
+            bounds.push_back(mesh.boundsMin);
+            bounds.push_back(mesh.boundsExtent);
+        }
+        m_meshBounds->setData(bounds, GL_STATIC_DRAW);
+        MemoryRegistry::registerBuffer("Scene Geometry", m_meshBounds, bounds.size() * sizeof(glm::vec3));
+    }
+
+    std::vector<glm::vec3> boundsMin, boundsMax;
+    boundsMin.reserve(m_meshes.size());
+    boundsMax.reserve(m_meshes.size());
+    for (const auto& mesh : m_meshes)
+    {
+        boundsMin.push_back(mesh.boundsMin);
+        boundsMax.push_back(mesh.boundsMin + mesh.boundsExtent);
+    }
+    m_bvh.build(boundsMin, boundsMax);
+
+    std::vector<glm::vec4> cullingBounds;
+    cullingBounds.reserve(2 * m_meshes.size());
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        cullingBounds.push_back(glm::vec4(boundsMin[i], 0.0f));
+        cullingBounds.push_back(glm::vec4(boundsMax[i], 0.0f));
+    }
+    m_cullingBounds->setData(cullingBounds, GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("Scene Geometry", m_cullingBounds, cullingBounds.size() * sizeof(glm::vec4));
+
+    std::vector<GLuint> materials;
+    materials.reserve(m_meshes.size());
+    for (const auto& mesh : m_meshes)
+        materials.push_back(mesh.materialIndex);
+    m_meshMaterials->setData(materials, GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("Scene Geometry", m_meshMaterials, materials.size() * sizeof(GLuint));
+
+    MemoryRegistry::registerBuffer("Scene Geometry", m_commands, commands.size() * sizeof(DrawElementsIndirectCommand));
+    MemoryRegistry::registerCPU("Scene Geometry", this, "Mesh Ranges, Meshlets and BVH",
+        m_meshes.size() * sizeof(MeshRange) + m_meshletRecords.size() * sizeof(MeshletRecord)
+        + m_commandOrder.size() * sizeof(size_t) + m_bvh.memoryUsage());
+
+    m_commandsDirty = false;
+}
+
+void SceneGeometry::setMaterialOrder(const std::vector<unsigned int>& order)
+{
+    if (order == m_materialOrder)
+        return;
+
+    m_materialOrder = order;
+    m_commandsDirty = true;
+}
+
+bool SceneGeometry::hasMaterial(unsigned int materialIndex) const
+{
+    return m_materialCommands.count(materialIndex) > 0;
+}
+
+size_t SceneGeometry::numMeshes() const
+{
+    return m_meshes.size();
+}
+
+float SceneGeometry::surfaceArea() const
+{
+    return m_surfaceArea;
+}
+
+size_t SceneGeometry::numCommands() const
+{
+    return m_numCommands;
+}
+
+size_t SceneGeometry::vertexSize() const
+{
+    return m_compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+size_t SceneGeometry::memoryUsage() const
+{
+    auto commands = MeshCache::maxLods * m_numCommands * sizeof(DrawElementsIndirectCommand);
+    auto bounds = (m_compactVertices ? 2 * m_meshes.size() * sizeof(glm::vec3) : 0) + 2 * m_meshes.size() * sizeof(glm::vec4);
+    auto meshlets = (m_lodFirstMeshlet[MeshCache::maxLods - 1] + m_lodNumMeshlets[MeshCache::maxLods - 1]) * sizeof(MeshletRecord);
+    auto points = m_numPoints * sizeof(glm::vec4);
+    return m_vertexCapacity * vertexSize() + m_indexCapacity * sizeof(GLuint) + commands + bounds + meshlets + points;
+}
+
+globjects::Buffer* SceneGeometry::cullingBounds() const
+{
+    return m_cullingBounds;
+}
+
+globjects::Buffer* SceneGeometry::vertices() const
+{
+    return m_vertices;
+}
+
+globjects::Buffer* SceneGeometry::indices() const
+{
+    return m_indices;
+}
+
+globjects::Buffer* SceneGeometry::meshBounds() const
+{
+    return m_meshBounds;
+}
+
+globjects::Buffer* SceneGeometry::meshlets() const
+{
+    return m_meshlets;
+}
+
+size_t SceneGeometry::firstMeshlet(unsigned int lod) const
+{
+    return m_lodFirstMeshlet[std::min(lod, MeshCache::maxLods - 1)];
+}
+
+size_t SceneGeometry::numMeshlets(unsigned int lod) const
+{
+    return m_lodNumMeshlets[std::min(lod, MeshCache::maxLods - 1)];
+}
+
+void SceneGeometry::draw(unsigned int materialIndex, GLenum mode, unsigned int lod) const
+{
+    auto it = m_materialCommands.find(materialIndex);
+    if (it == m_materialCommands.end())
+        return;
+
+    lod = std::min(lod, MeshCache::maxLods - 1);
+    drawCommands(m_commands, mode, lod * m_numCommands + it->second.first, it->second.second);
+}
+
+void SceneGeometry::drawAll(GLenum mode, unsigned int lod) const
+{
+    lod = std::min(lod, MeshCache::maxLods - 1);
+    drawCommands(m_commands, mode, lod * m_numCommands, m_numCommands);
+}
+
+void SceneGeometry::drawMaterials(unsigned int firstMaterial, unsigned int lastMaterial, GLenum mode, unsigned int lod) const
+{
+    size_t firstCommand, numCommands;
+    if (!commandRange(firstMaterial, lastMaterial, firstCommand, numCommands))
+        return;
+
+    lod = std::min(lod, MeshCache::maxLods - 1);
+    drawCommands(m_commands, mode, lod * m_numCommands + firstCommand, numCommands);
+}
+
+void SceneGeometry::select(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, unsigned int lod) const
+{
+    fillSelection(selection, viewProjection, cull, lod, nullptr, 0.0f, 0.0f);
+}
+
+void SceneGeometry::select(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, const glm::vec3& eye, float pixelsPerUnit, float maxPixelError) const
+{
+    fillSelection(selection, viewProjection, cull, 0, &eye, pixelsPerUnit, maxPixelError);
+}
+
+void SceneGeometry::drawSelected(const DrawSelection& selection, unsigned int materialIndex, GLenum mode) const
+{
+    auto it = m_materialCommands.find(materialIndex);
+    if (it == m_materialCommands.end() || selection.m_capacity < m_numCommands)
+        return;
+
+    drawCommands(selection.m_commands, mode, it->second.first, it->second.second);
+}
+
+void SceneGeometry::drawSelectedMaterials(const DrawSelection& selection, unsigned int firstMaterial, unsigned int lastMaterial, GLenum mode) const
+{
+    size_t firstCommand, numCommands;
+    if (selection.m_capacity < m_numCommands || !commandRange(firstMaterial, lastMaterial, firstCommand, numCommands))
+        return;
+
+    drawCommands(selection.m_commands, mode, firstCommand, numCommands);
+}
+
+void SceneGeometry::drawMeshlets(const DrawSelection& selection, unsigned int lod, GLenum mode) const
+{
+    auto numCommands = numMeshlets(lod);
+    if (selection.m_capacity < numCommands)
+        return;
+
+    drawCommands(selection.m_commands, mode, 0, numCommands);
+}
+
+void SceneGeometry::setPoints(const std::vector<glm::vec4>& points, float radius)
+{
+    m_points->setData(points, GL_STATIC_DRAW);
+    m_numPoints = points.size();
+    m_pointRadius = radius;
+    MemoryRegistry::registerBuffer("Scene Geometry", m_points, m_numPoints * sizeof(glm::vec4));
+}
+
+size_t SceneGeometry::numPoints() const
+{
+    return m_numPoints;
+}
+
+float SceneGeometry::pointRadius() const
+{
+    return m_pointRadius;
+}
+
+void SceneGeometry::drawPoints() const
+{
+    drawPoints(0, m_numPoints);
+}
+
+void SceneGeometry::drawPoints(size_t first, size_t count) const
+{
+    if (first >= m_numPoints)
+        return;
+    count = std::min(count, m_numPoints - first);
+    if (count == 0)
+        return;
+
+    m_pointVao->bind();
+    glDrawArrays(GL_POINTS, static_cast<GLint>(first), static_cast<GLsizei>(count));
+    m_pointVao->unbind();
+}
+
+void SceneGeometry::fillSelection(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, unsigned int lod,
+    const glm::vec3* eye, float pixelsPerUnit, float maxPixelError) const
+{
+    if (cull)
+    {
+        selection.m_numVisible = m_bvh.cull(viewProjection, selection.m_visible);
+    }
+    else
+    {
+        selection.m_visible.assign(m_bvh.numMeshes(), 1);
+        selection.m_numVisible = m_bvh.numMeshes();
+    }
+    selection.m_numCulled = selection.m_visible.size() - selection.m_numVisible;
+
+    if (m_numCommands == 0)
+        return;
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(m_numCommands);
+
+    for (auto meshIndex : m_commandOrder)
+    {
+        const auto& mesh = m_meshes[meshIndex];
+
+        // the material ranges only stay valid if every mesh keeps its command
+        if (!selection.m_visible[meshIndex])
+        {
+            commands.push_back(makeCommand(0, 0, 0, meshIndex));
+            commands.back().instanceCount = 0;
+            continue;
+        }
+
+        auto level = std::min(lod, mesh.numLods - 1);
+        if (eye)
+        {
+            // distance to the bounding sphere, so a mesh the camera is inside of always gets full detail
+            auto center = mesh.boundsMin + mesh.boundsExtent * 0.5f;
+            auto distance = glm::length(center - *eye) - glm::length(mesh.boundsExtent) * 0.5f;
+
+            level = 0;
+            if (distance > 0.0f)
+            {
+                for (auto l = mesh.numLods - 1; l > 0; --l)
+                {
+                    if (mesh.lodError[l] * pixelsPerUnit / distance <= maxPixelError)
+                    {
+                        level = l;
+                        break;
+                    }
+                }
+            }
+        }
+
+        commands.push_back(makeCommand(mesh.lodFirstIndex[level], mesh.lodNumIndices[level], mesh.baseVertex, meshIndex));
+    }
+
+    selection.reserve(m_numCommands);
+    selection.m_commands->setSubData(commands);
+}
+
+void SceneGeometry::setupVertexArray()
+{
+    auto stride = static_cast<GLint>(vertexSize());
+    for (GLuint i = 0; i < 3; ++i)
+    {
+        m_vao->binding(i)->setAttribute(i);
+        m_vao->binding(i)->setBuffer(m_vertices, 0, stride);
+        m_vao->enable(i);
+    }
+
+    if (m_compactVertices)
+    {
+        m_vao->binding(0)->setFormat(3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, position));
+        m_vao->binding(1)->setFormat(2, GL_SHORT, GL_TRUE, offsetof(CompactVertex, normal));
+        m_vao->binding(2)->setFormat(2, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactVertex, textureCoordinate));
+
+        // per mesh bounds, selected through baseInstance
+        for (GLuint i = 3; i < 5; ++i)
+        {
+            m_vao->binding(i)->setAttribute(i);
+            m_vao->binding(i)->setBuffer(m_meshBounds, (i - 3) * sizeof(glm::vec3), 2 * sizeof(glm::vec3));
+            m_vao->binding(i)->setFormat(3, GL_FLOAT);
+            m_vao->binding(i)->setDivisor(1);
+            m_vao->enable(i);
+        }
+    }
+    else
+    {
+        m_vao->binding(0)->setFormat(3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        m_vao->binding(1)->setFormat(3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        m_vao->binding(2)->setFormat(3, GL_FLOAT, GL_FALSE, offsetof(Vertex, textureCoordinate));
+    }
+
+    // per mesh material index, selected through baseInstance
+    m_vao->binding(5)->setAttribute(5);
+    m_vao->binding(5)->setBuffer(m_meshMaterials, 0, sizeof(GLuint));
+    m_vao->binding(5)->setIFormat(1, GL_UNSIGNED_INT);
+    m_vao->binding(5)->setDivisor(1);
+    m_vao->enable(5);
+
+    m_vao->bindElementBuffer(m_indices);
+}
+
+bool SceneGeometry::commandRange(unsigned int firstMaterial, unsigned int lastMaterial, size_t& firstCommand, size_t& numCommands) const
+{
+    auto first = m_materialCommands.find(firstMaterial);
+    auto last = m_materialCommands.find(lastMaterial);
+    if (first == m_materialCommands.end() || last == m_materialCommands.end() || last->second.first < first->second.first)
+        return false;
+
+    firstCommand = first->second.first;
+    numCommands = last->second.first + last->second.second - firstCommand;
+    return true;
+}
+
+void SceneGeometry::drawCommands(globjects::Buffer* commands, GLenum mode, size_t firstCommand, size_t numCommands) const
+{
+    if (numCommands == 0)
+        return;
+
+    m_vao->bind();
+    commands->bind(GL_DRAW_INDIRECT_BUFFER);
+
+    auto offset = reinterpret_cast<const void*>(firstCommand * sizeof(DrawElementsIndirectCommand));
+    glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, offset, static_cast<GLsizei>(numCommands), 0);
+
+    globjects::Buffer::unbind(GL_DRAW_INDIRECT_BUFFER);
+    m_vao->unbind();
+}
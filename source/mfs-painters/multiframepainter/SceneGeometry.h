@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <glbinding/gl/types.h>
+
+#include <globjects/base/ref_ptr.h>
+
+#include "MeshBvh.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+
+namespace globjects
+{
+    class Buffer;
+    class VertexArray;
+}
+
+
+// The meshes one view draws and their levels of detail, filled by SceneGeometry::select every frame.
+// Culled meshes keep their command with zero instances, so the command ranges of the materials stay valid.
+// Every pass keeps its own selection so that they don't overwrite each other's commands.
+class DrawSelection
+{
+public:
+    DrawSelection(const std::string& name);
+    ~DrawSelection();
+
+    size_t numVisible() const;
+    size_t numCulled() const;
+
+    // one command per mesh in the command order of the SceneGeometry it was selected from
+    globjects::Buffer* commands() const;
+    // makes room for numCommands, for selections that are written on the GPU
+    void reserve(size_t numCommands);
+
+protected:
+    friend class SceneGeometry;
+
+    std::string m_name;
+    globjects::ref_ptr<globjects::Buffer> m_commands;
+    size_t m_capacity; // commands
+    std::vector<std::uint8_t> m_visible; // per mesh
+    size_t m_numVisible;
+    size_t m_numCulled;
+};
+
+
+// All scene meshes packed into one shared set of vertex and index buffers.
+// Meshes keep their own index space (drawn with baseVertex) and are drawn with glMultiDrawElementsIndirect,
+// one call per material, per run of materials that are adjacent in the material order, or a single call
+// for the whole scene. baseInstance is the mesh index.
+//
+// Every mesh brings up to MeshCache::maxLods levels of detail as index ranges into its vertices.
+// Draws either use one fixed level for all meshes (clamped to the coarsest level a mesh has)
+// or the per mesh levels and visibility of a DrawSelection. Selections frustum cull the meshes with a MeshBvh
+// over their bounds.
+//
+// Vertices are interleaved in one of two layouts:
+//  - full:    vec3 position, vec3 normal, vec3 texture coordinate (36 bytes)
+//  - compact: position quantized to 16 bit unorm relative to the mesh bounds, octahedral 16 bit snorm normal,
+//             half float uv (16 bytes); the bounds are per-instance attributes 3 (min) and 4 (extent).
+// Shaders select the matching decode path with COMPACT_VERTICES.
+// In both layouts the mesh's material index is the per-instance integer attribute 5.
+//
+// Meshes also come split into meshlets (see MeshletBuilder), which GPU passes cull one by one and draw with
+// one command each. Like the commands, the meshlets of every level of detail form one block.
+class SceneGeometry
+{
+public:
+    SceneGeometry(bool compactVertices);
+    ~SceneGeometry();
+
+    bool compactVertices() const;
+
+    void clear();
+    void reserve(size_t numVertices, size_t numIndices);
+
+    // missing normals or texture coordinates are zeroed, meshlets are those MeshletBuilder::build returns for mesh
+    void add(const MeshCache::Mesh& mesh, const std::vector<MeshletBuilder::Meshlet>& meshlets);
+
+    // commands are grouped by material in this order, materials missing from it follow by index
+    void setMaterialOrder(const std::vector<unsigned int>& order);
+
+    // rebuilds the indirect command buffer after meshes were added or the material order changed
+    void updateCommands();
+
+    bool hasMaterial(unsigned int materialIndex) const;
+    size_t numMeshes() const;
+    // of the full resolution triangles of all meshes
+    float surfaceArea() const;
+    size_t numCommands() const;
+    size_t vertexSize() const;
+    size_t memoryUsage() const; // bytes allocated for vertices, indices, bounds, commands, meshlets and points
+    // vec4 minimum and vec4 maximum per mesh, for culling on the GPU
+    globjects::Buffer* cullingBounds() const;
+    // the vertices in the layout compactVertices() selects, the indices relative to the base vertex of their mesh and,
+    // with compact vertices, the vec3 minimum and vec3 extent per mesh, for passes that fetch the triangles themselves
+    globjects::Buffer* vertices() const;
+    globjects::Buffer* indices() const;
+    globjects::Buffer* meshBounds() const;
+
+    // per meshlet a vec4 bounding sphere, a vec4 normal cone (axis and cutoff) and the index count, first index,
+    // base vertex and mesh index of its command; the meshlets at level lod start at firstMeshlet(lod)
+    globjects::Buffer* meshlets() const;
+    size_t firstMeshlet(unsigned int lod) const;
+    size_t numMeshlets(unsigned int lod) const;
+
+    void draw(unsigned int materialIndex, gl::GLenum mode, unsigned int lod = 0) const;
+    void drawAll(gl::GLenum mode, unsigned int lod = 0) const;
+    // all materials from firstMaterial to lastMaterial in the material order, both need to have meshes
+    void drawMaterials(unsigned int firstMaterial, unsigned int lastMaterial, gl::GLenum mode, unsigned int lod = 0) const;
+
+    // culls the meshes against the frustum of viewProjection (unless cull is false) and keeps the fixed level lod
+    // for the visible ones
+    void select(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, unsigned int lod) const;
+    // same, but picks the coarsest level per visible mesh whose error stays below maxPixelError on screen,
+    // pixelsPerUnit is the projected size of one unit at distance one from eye
+    void select(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, const glm::vec3& eye, float pixelsPerUnit, float maxPixelError) const;
+    void drawSelected(const DrawSelection& selection, unsigned int materialIndex, gl::GLenum mode) const;
+    void drawSelectedMaterials(const DrawSelection& selection, unsigned int firstMaterial, unsigned int lastMaterial, gl::GLenum mode) const;
+    // the numMeshlets(lod) commands a GPU pass wrote into selection, one per meshlet
+    void drawMeshlets(const DrawSelection& selection, unsigned int lod, gl::GLenum mode) const;
+
+    // surface samples of the whole scene (see PointCloud), attribute 0 is the point, gl_VertexID its index
+    void setPoints(const std::vector<glm::vec4>& points, float radius);
+    size_t numPoints() const;
+    float pointRadius() const;
+    void drawPoints() const;
+    // points first to first + count, the range is clamped to the points there are
+    void drawPoints(size_t first, size_t count) const;
+
+protected:
+    struct MeshRange
+    {
+        unsigned int materialIndex;
+        gl::GLint baseVertex;
+        unsigned int numLods;
+        gl::GLuint lodFirstIndex[MeshCache::maxLods];
+        gl::GLuint lodNumIndices[MeshCache::maxLods];
+        float lodError[MeshCache::maxLods];
+        glm::vec3 boundsMin;
+        glm::vec3 boundsExtent;
+        size_t lodFirstMeshlet[MeshCache::maxLods]; // into m_meshletRecords
+        size_t lodNumMeshlets[MeshCache::maxLods];
+    };
+
+    // matches Meshlet in meshlet_culling.comp
+    struct MeshletRecord
+    {
+        glm::vec4 sphere;
+        glm::vec4 cone;
+        gl::GLuint count;
+        gl::GLuint firstIndex;
+        gl::GLint baseVertex;
+        gl::GLuint meshIndex;
+    };
+
+    void setupVertexArray();
+    // screen space levels of detail if eye is given, the fixed level lod otherwise
+    void fillSelection(DrawSelection& selection, const glm::mat4& viewProjection, bool cull, unsigned int lod,
+        const glm::vec3* eye, float pixelsPerUnit, float maxPixelError) const;
+    void drawCommands(globjects::Buffer* commands, gl::GLenum mode, size_t firstCommand, size_t numCommands) const;
+    bool commandRange(unsigned int firstMaterial, unsigned int lastMaterial, size_t& firstCommand, size_t& numCommands) const;
+
+    bool m_compactVertices;
+
+    globjects::ref_ptr<globjects::VertexArray> m_vao;
+    globjects::ref_ptr<globjects::Buffer> m_vertices;
+    globjects::ref_ptr<globjects::Buffer> m_indices;
+    globjects::ref_ptr<globjects::Buffer> m_meshBounds;
+    globjects::ref_ptr<globjects::Buffer> m_cullingBounds;
+    globjects::ref_ptr<globjects::Buffer> m_meshMaterials;
+    globjects::ref_ptr<globjects::Buffer> m_commands; // one block of commands per level of detail
+    globjects::ref_ptr<globjects::Buffer> m_meshlets; // one block of meshlets per level of detail
+    globjects::ref_ptr<globjects::VertexArray> m_pointVao;
+    globjects::ref_ptr<globjects::Buffer> m_points;
+
+    size_t m_vertexCapacity;
+    size_t m_indexCapacity;
+    size_t m_numVertices;
+    size_t m_numIndices;
+    float m_surfaceArea;
+    size_t m_numPoints;
+    float m_pointRadius;
+
+    std::vector<MeshRange> m_meshes;
+    std::vector<MeshletRecord> m_meshletRecords; // of all meshes and levels in the order they were added
+    size_t m_lodFirstMeshlet[MeshCache::maxLods];
+    size_t m_lodNumMeshlets[MeshCache::maxLods];
+    std::vector<size_t> m_commandOrder; // mesh index of every command
+    std::vector<unsigned int> m_materialOrder;
+    std::map<unsigned int, std::pair<size_t, size_t>> m_materialCommands; // first command and command count
+    MeshBvh m_bvh;
+    size_t m_numCommands;
+    bool m_commandsDirty;
+};
@@ -0,0 +1,189 @@
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+namespace
+{
+    // increment whenever the file layout or the encoder changes
+    const uint32_t cacheVersion = 1;
+    const char cacheMagic[8] = { 'M', 'F', 'S', 'T', 'E', 'X', '\0', '\0' };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t type;
+        uint64_t sourceHash;
+        uint32_t format;
+        uint32_t grayscale;
+        uint32_t numLevels;
+        uint32_t padding;
+    };
+
+    struct LevelRecord
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::string typeName(TextureType type)
+    {
+        switch (type)
+        {
+        case TextureType::Diffuse: return "diffuse";
+        case TextureType::Specular: return "specular";
+        case TextureType::Emissive: return "emissive";
+        case TextureType::Bump: return "bump";
+        case TextureType::Opacity: return "opacity";
+        default: return "unknown";
+        }
+    }
+}
+
+TextureCache::TextureCache(const std::string& sourceFilename, TextureType type)
+: m_sourceHash(MeshCache::hashFile(sourceFilename))
+, m_type(type)
+{
+    m_cacheFilename = sourceFilename + "." + typeName(type) + ".texcache";
+}
+
+TextureCache::~TextureCache()
+{
+}
+
+bool TextureCache::load(CompressedImage& image) const
+{
+    // the source is gone, so is the entry
+    if (m_sourceHash == 0)
+    {
+        std::remove(m_cacheFilename.c_str());
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(m_cacheFilename))
+        return false;
+
+    FileHeader header;
+    bool headerMatches = file.size() >= sizeof(FileHeader);
+    if (headerMatches)
+    {
+        std::memcpy(&header, file.data(), sizeof(FileHeader));
+        headerMatches = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+            && header.version == cacheVersion
+            && header.type == static_cast<uint32_t>(m_type)
+            && header.sourceHash == m_sourceHash
+            && header.format <= static_cast<uint32_t>(BlockFormat::BC5);
+    }
+
+    if (!headerMatches)
+    {
+        std::cout << "Ignoring outdated texture cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    auto dataOffset = sizeof(FileHeader) + header.numLevels * sizeof(LevelRecord);
+    if (header.numLevels == 0 || dataOffset > file.size())
+    {
+        std::cout << "Texture cache " << m_cacheFilename << " is corrupt, ignoring it" << std::endl;
+        return false;
+    }
+
+    image.format = static_cast<BlockFormat>(header.format);
+    image.grayscale = header.grayscale != 0;
+    image.levels.clear();
+
+    auto dataSize = file.size() - dataOffset;
+    for (uint32_t l = 0; l < header.numLevels; ++l)
+    {
+        LevelRecord record;
+        std::memcpy(&record, file.data() + sizeof(FileHeader) + l * sizeof(LevelRecord), sizeof(LevelRecord));
+
+        auto expectedSize = static_cast<uint64_t>((record.width + 3) / 4) * ((record.height + 3) / 4) * BlockCompression::blockSize(image.format);
+        if (record.offset > dataSize || record.size > dataSize - record.offset || record.size != expectedSize)
+        {
+            std::cout << "Texture cache " << m_cacheFilename << " is corrupt, ignoring it" << std::endl;
+            image.levels.clear();
+            return false;
+        }
+
+        CompressedImage::Level level;
+        level.width = static_cast<int>(record.width);
+        level.height = static_cast<int>(record.height);
+        level.offset = static_cast<size_t>(record.offset);
+        level.size = static_cast<size_t>(record.size);
+        image.levels.push_back(level);
+    }
+
+    image.data.assign(file.data() + dataOffset, file.data() + file.size());
+
+    return true;
+}
+
+bool TextureCache::store(const CompressedImage& image) const
+{
+    if (m_sourceHash == 0)
+        return false;
+
+    // write to a temporary file first so that a crash never leaves a half-written cache behind
+    auto temporaryFilename = m_cacheFilename + ".tmp";
+    std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+    if (!stream)
+    {
+        std::cout << "Could not write texture cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.type = static_cast<uint32_t>(m_type);
+    header.sourceHash = m_sourceHash;
+    header.format = static_cast<uint32_t>(image.format);
+    header.grayscale = image.grayscale ? 1 : 0;
+    header.numLevels = static_cast<uint32_t>(image.levels.size());
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (const auto& level : image.levels)
+    {
+        LevelRecord record;
+        record.width = static_cast<uint32_t>(level.width);
+        record.height = static_cast<uint32_t>(level.height);
+        record.offset = level.offset;
+        record.size = level.size;
+        stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    stream.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+
+    stream.close();
+    if (!stream)
+    {
+        std::remove(temporaryFilename.c_str());
+        std::cout << "Could not write texture cache " << m_cacheFilename << std::endl;
+        return false;
+    }
+
+    std::remove(m_cacheFilename.c_str());
+    if (std::rename(temporaryFilename.c_str(), m_cacheFilename.c_str()) != 0)
+    {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const std::string& TextureCache::cacheFilename() const
+{
+    return m_cacheFilename;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "BlockCompression.h"
+#include "Material.h"
+
+
+// On-disk cache of block compressed textures including their full mip chain.
+// There is one cache file per source image and texture type (which decides the block format), it is valid while its
+// header matches the source image contents, so warm starts skip image decoding and encoding altogether.
+// A changed source overwrites the file, one whose source is gone is removed when it is looked up.
+class TextureCache
+{
+public:
+    TextureCache(const std::string& sourceFilename, TextureType type);
+    ~TextureCache();
+
+    bool load(CompressedImage& image) const;
+    bool store(const CompressedImage& image) const;
+
+    const std::string& cacheFilename() const;
+
+protected:
+    uint64_t m_sourceHash;
+    TextureType m_type;
+    std::string m_cacheFilename;
+};
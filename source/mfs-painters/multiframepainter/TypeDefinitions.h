@@ -14,15 +14,7 @@ namespace globjects
     class Texture;
 }
 
-namespace gloperate
-{
-    class PolygonalDrawable;
-}
-
-using PolygonalDrawablePointer = std::unique_ptr<gloperate::PolygonalDrawable>;
-using PolygonalDrawables = std::vector<PolygonalDrawablePointer>;
 using IdMaterialMap = std::map<unsigned int, Material>;
-using IdDrawablesMap = std::map<unsigned int, PolygonalDrawables>;
 
 struct PresetInformation
 {
@@ -41,4 +33,7 @@ struct PresetInformation
     float focalDist;
     float focalPoint;
     float vertexScale;
+    // the fixed levels of detail of the RSM and ISM passes, 0 keeps the full meshes
+    unsigned int rsmLodLevel;
+    unsigned int ismLodLevel;
 };
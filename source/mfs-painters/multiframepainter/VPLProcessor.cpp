@@ -16,6 +16,7 @@
 #include <gloperate/painter/AbstractCameraCapability.h>
 #include <gloperate/painter/AbstractProjectionCapability.h>
 
+#include "MemoryRegistry.h"
 #include "RasterizationStage.h"
 
 
@@ -49,10 +50,14 @@ VPLProcessor::VPLProcessor()
     );
 
     vplBuffer = new globjects::Buffer();
+    vplBuffer->setName("VPLs");
     vplBuffer->setData(sizeof(vpl) * maxVPLCount, nullptr, GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("VPL Processor", vplBuffer, sizeof(vpl) * maxVPLCount);
 
     packedVplBuffer = new globjects::Buffer();
+    packedVplBuffer->setName("Packed VPLs");
     packedVplBuffer->setData(sizeof(packedVPL) * maxVPLCount, nullptr, GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("VPL Processor", packedVplBuffer, sizeof(packedVPL) * maxVPLCount);
 
 
     std::vector<int> v(maxVPLCount);
@@ -62,7 +67,9 @@ VPLProcessor::VPLProcessor()
     std::shuffle(v.begin(), v.end(), g);
 
     m_shuffledIndicesBuffer = new globjects::Buffer();
+    m_shuffledIndicesBuffer->setName("Shuffled VPL Indices");
     m_shuffledIndicesBuffer->setData(sizeof(int) * v.size(), v.data(), GL_STATIC_DRAW);
+    MemoryRegistry::registerBuffer("VPL Processor", m_shuffledIndicesBuffer, sizeof(int) * v.size());
 }
 
 VPLProcessor::~VPLProcessor()
@@ -0,0 +1,93 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+
+WorkerPool::WorkerPool()
+: m_stop(false)
+, m_generation(0)
+, m_busy(0)
+, m_body(nullptr)
+, m_count(0)
+, m_next(0)
+{
+    auto numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int t = 1; t < numThreads; ++t)
+        m_threads.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+WorkerPool& WorkerPool::shared()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+size_t WorkerPool::numThreads() const
+{
+    return m_threads.size() + 1;
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& body)
+{
+    if (m_threads.empty() || count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_body = &body;
+        m_count = count;
+        m_next = 0;
+        m_busy = static_cast<unsigned int>(m_threads.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runJob();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_busy == 0; });
+    m_body = nullptr;
+}
+
+void WorkerPool::work()
+{
+    unsigned int generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+            if (m_stop)
+                return;
+            generation = m_generation;
+        }
+
+        runJob();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0)
+            m_done.notify_one();
+    }
+}
+
+void WorkerPool::runJob()
+{
+    for (size_t i = m_next++; i < m_count; i = m_next++)
+        (*m_body)(i);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Threads that live as long as the pool and wait for work, for parallel loops that run every frame.
+// parallelFor starts its threads on every call, which costs more than short per frame work takes.
+// Only one run may be in progress at a time.
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // the pool shared by all per frame work, with one thread less than the hardware threads
+    static WorkerPool& shared();
+
+    size_t numThreads() const; // including the thread calling run
+
+    // calls body(i) for every i in [0, count) on the workers and the calling thread, returns when all calls are done
+    void run(size_t count, const std::function<void(size_t)>& body);
+
+protected:
+    void work();
+    void runJob();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_stop;
+    unsigned int m_generation; // counts runs, so waking workers can tell a new one from a spurious wakeup
+    unsigned int m_busy; // workers still working on the current run
+
+    // the current run
+    const std::function<void(size_t)>* m_body;
+    size_t m_count;
+    std::atomic<size_t> m_next;
+};
@@ -0,0 +1,71 @@
+#include "QtRawImageLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <gloperate/ext-includes-begin.h>
+#include <QImage>
+#include <QImageReader>
+#include <gloperate/ext-includes-end.h>
+
+
+QtRawImageLoader::QtRawImageLoader()
+{
+    for (const QByteArray & format : QImageReader::supportedImageFormats())
+    {
+        auto extension = QString(format).toStdString();
+        m_extensions.push_back("." + extension);
+        m_types.push_back(QString(format).toUpper().toStdString() + " image (*." + extension + ")");
+    }
+}
+
+QtRawImageLoader::~QtRawImageLoader()
+{
+}
+
+bool QtRawImageLoader::canLoad(const std::string & ext) const
+{
+    return std::find(m_extensions.begin(), m_extensions.end(), "." + ext) != m_extensions.end();
+}
+
+std::vector<std::string> QtRawImageLoader::loadingTypes() const
+{
+    return m_types;
+}
+
+std::string QtRawImageLoader::allLoadingTypes() const
+{
+    std::string allTypes;
+    for (const auto & extension : m_extensions)
+    {
+        if (!allTypes.empty())
+            allTypes.append(" ");
+        allTypes.append("*" + extension);
+    }
+    return allTypes;
+}
+
+RawImage * QtRawImageLoader::load(const std::string & filename, const reflectionzeug::Variant & /*options*/, std::function<void(int, int)> /*progress*/) const
+{
+    QImage image;
+    if (!image.load(QString::fromStdString(filename)))
+    {
+        std::cout << "Image could not be loaded: " << filename << std::endl;
+        return nullptr;
+    }
+
+    // same layout QtTextureLoader uploads: RGBA bytes, bottom row first
+    image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    auto rawImage = new RawImage;
+    rawImage->width = image.width();
+    rawImage->height = image.height();
+    rawImage->data.resize(static_cast<size_t>(image.width()) * image.height() * 4);
+
+    auto rowSize = static_cast<size_t>(image.width()) * 4;
+    for (int y = 0; y < image.height(); ++y)
+        std::memcpy(rawImage->data.data() + y * rowSize, image.constScanLine(y), rowSize);
+
+    return rawImage;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include <gloperate/resources/Loader.h>
+
+#include <multiframepainter/RawImage.h>
+
+
+// Decodes images with QImage into CPU memory only, so unlike QtTextureLoader it may be used from any thread.
+class QtRawImageLoader : public gloperate::Loader<RawImage>
+{
+public:
+    QtRawImageLoader();
+    virtual ~QtRawImageLoader();
+
+    virtual bool canLoad(const std::string & ext) const override;
+    virtual std::vector<std::string> loadingTypes() const override;
+    virtual std::string allLoadingTypes() const override;
+
+    virtual RawImage * load(const std::string & filename, const reflectionzeug::Variant & options, std::function<void(int, int)> progress) const override;
+
+
+protected:
+    std::vector<std::string> m_extensions;
+    std::vector<std::string> m_types;
+};
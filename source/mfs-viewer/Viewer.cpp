@@ -30,6 +30,7 @@
 #include "multiframepainter/PerfCounter.h"
 
 #include "QtViewerMapping.h"
+#include "QtRawImageLoader.h"
 
 using namespace widgetzeug;
 using namespace gloperate;
@@ -58,6 +59,7 @@ Viewer::Viewer(QWidget * parent, Qt::WindowFlags flags)
 
     // Add default texture loaders/storers
     m_resourceManager->addLoader(new gloperate_qt::QtTextureLoader());
+    m_resourceManager->addLoader(new QtRawImageLoader());
 
     // Setup UI
     setupMessageWidgets();
@@ -227,7 +229,7 @@ void Viewer::onTimer()
     auto mfPainter = dynamic_cast<MultiFramePainter*>(m_painter.get());
     if (mfPainter)
     {
-        auto str = mfPainter->getPerfCounterString();
+        auto str = mfPainter->getPerfCounterString() + "\n" + mfPainter->getMemoryString();
         m_infoLabel.setText(QString::fromStdString(str));
     }
 	((propertyguizeug::PropertyBrowser*)m_propertyDockWidget->widget())->expandAllGroups();
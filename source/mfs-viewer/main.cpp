@@ -14,6 +14,7 @@
 #include <gloperate-qt/viewer/QtTextureLoader.h>
 
 #include "Viewer.h"
+#include "QtRawImageLoader.h"
 
 using namespace gloperate;
 using namespace gloperate_qt;
@@ -25,6 +26,7 @@ int main(int argc, char * argv[])
 
     ResourceManager resourceManager;
     resourceManager.addLoader(new QtTextureLoader());
+    resourceManager.addLoader(new QtRawImageLoader());
 
     PluginManager pluginManager;
     pluginManager.addSearchPath(QCoreApplication::applicationDirPath().toStdString());